@@ -22,8 +22,8 @@
 
 namespace Cryo::Assembler {
 
-	Assembler::Assembler(const std::filesystem::path& path)
-		: m_FilePath(path)
+	Assembler::Assembler(const std::filesystem::path& path, CodeFormat format)
+		: m_Format(format), m_FilePath(path)
 	{
 		m_Tokens.reserve(200);
 		// We can assume the caller checked if the file exists and the extension matches
@@ -117,7 +117,8 @@ namespace Cryo::Assembler {
 		TokenType::F32,
 		TokenType::F64,
 
-		TokenType::StringLiteral
+		TokenType::StringLiteral,
+		TokenType::MemoryOrder
 	};
 
   // TODO: check if it hasn't ran out of tokens pretty much everywhere
@@ -182,6 +183,7 @@ namespace Cryo::Assembler {
         if (result.value() != 0)
         {
           func.ParametersSizes.emplace_back(result.value());
+          func.ParametersTypes.emplace_back(m_Tokens[current_token].tokenText);
         }
         func.Signature += "::" + std::string(m_Tokens[current_token].tokenText.data() + 1, m_Tokens[current_token].tokenText.size() - 1);
       }
@@ -207,6 +209,7 @@ namespace Cryo::Assembler {
         return std::nullopt;
       }
       func.ReturnSize = result.value();
+      func.ReturnType = m_Tokens[current_token].tokenText;
     }
     
 		func.Signature = "$" + std::string(m_Tokens[current_token].tokenText.data() + 1, m_Tokens[current_token].tokenText.size() - 1) + "::" + func.Signature;
@@ -219,14 +222,19 @@ namespace Cryo::Assembler {
 		uint32_t current_token;
 		for (current_token = func.FunctionStart; m_Tokens[current_token].type != TokenType::StartBody; current_token++);
     
+    // VariableStack keeps views of the names, they must outlive it
+    std::vector<std::string> parameter_names;
+    parameter_names.reserve(func.ParametersSizes.size());
+
     VariableStack variables;
     if (func.ReturnSize != 0)
     {
-      variables.push_variable("$return", func.ReturnSize);
+      variables.push_variable("$return", func.ReturnSize, func.ReturnType);
     }
     for (uint32_t i = 0; i < func.ParametersSizes.size(); i++)
     {
-      variables.push_variable("$param_" + std::to_string(i), func.ParametersSizes[i]);
+      parameter_names.emplace_back("$param_" + std::to_string(i));
+      variables.push_variable(parameter_names.back(), func.ParametersSizes[i], func.ParametersTypes[i]);
     }
 
 		for (current_token++; current_token < m_Tokens.size() && m_Tokens[current_token].type != TokenType::EndBody; current_token++)
@@ -243,6 +251,12 @@ namespace Cryo::Assembler {
 				if (errors.get_severity() == Error::level_critical) { return; }
 			}
 		}
+
+    func.FrameSize = variables.get_max_size();
+    if (m_Format == CodeFormat::Register)
+    {
+      func.Flags |= FUNCTION_REGISTER_FORMAT;
+    }
 	}
 
 	void Assembler::assemble_instruction(uint32_t instruction, Function& func, VariableStack& variables, ErrorQueue& errors)
@@ -277,6 +291,7 @@ namespace Cryo::Assembler {
       return;
     }
 
+    size_t instruction_start = func.Instructions.size();
     func.Instructions.emplace_back(opcode);
 
     // Deal with parameters
@@ -307,7 +322,7 @@ namespace Cryo::Assembler {
 
           func.Instructions.emplace_back(result.value());
           current_token++;
-          if (!variables.push_variable(m_Tokens[current_token].tokenText, result.value())) // Register variable
+          if (!variables.push_variable(m_Tokens[current_token].tokenText, result.value(), type)) // Register variable
           {
             PUSH_ERROR(errors, ERR_A_VARIABLE_NAME_ALREDY_IN_USE, current_token);
             return;
@@ -371,6 +386,63 @@ namespace Cryo::Assembler {
         }
         break;
 
+      case CryoOpcode::MOVU32:
+      case CryoOpcode::ADDU32:
+      case CryoOpcode::SUBU32:
+      case CryoOpcode::MULU32:
+        for (uint32_t i = 0; i < InstructionSet::get_params_size(opcode) / sizeof(uint32_t); i++, current_token++)
+        {
+          const VariableData* data = variables.get_variable(m_Tokens[current_token].tokenText);
+          if (!data)
+          {
+            PUSH_ERROR(errors, ERR_A_VARIBALE_DOES_NOT_EXIST, current_token);
+            return;
+          }
+          func.Instructions.emplace_back(data->Position);
+        }
+        break;
+
+      case CryoOpcode::ATOMIC_LOAD:
+      case CryoOpcode::ATOMIC_STORE:
+      case CryoOpcode::ATOMIC_ADD:
+      case CryoOpcode::ATOMIC_CAS:
+      case CryoOpcode::FENCE:
+        {
+          // Every operand is a @uint32 variable except the slot, which may also be a @void* pointing at the @uint32
+          uint32_t variable_count = InstructionSet::get_params_size(opcode) / sizeof(uint32_t) - 1;
+          uint32_t slot = opcode == CryoOpcode::ATOMIC_LOAD || opcode == CryoOpcode::ATOMIC_ADD ? 1 : 0;
+          uint32_t order = 0;
+          for (uint32_t i = 0; i < variable_count; i++, current_token++)
+          {
+            const VariableData* data = variables.get_variable(m_Tokens[current_token].tokenText);
+            if (!data)
+            {
+              PUSH_ERROR(errors, ERR_A_VARIBALE_DOES_NOT_EXIST, current_token);
+              return;
+            }
+            bool pointer = i == slot && data->Type == "@void*";
+            if (data->Type != "@uint32" && !pointer)
+            {
+              PUSH_ERROR(errors, ERR_A_INVALID_ATOMIC_OPERAND, current_token);
+              return;
+            }
+            if (pointer)
+            {
+              order |= ATOMIC_HEAP;
+            }
+            func.Instructions.emplace_back(data->Position);
+          }
+
+          CryoMemoryOrder memory_order = InstructionSet::get_memory_order(m_Tokens[current_token].tokenText).value();
+          if (!is_valid_memory_order(opcode, memory_order))
+          {
+            PUSH_ERROR(errors, ERR_A_INVALID_MEMORY_ORDER, current_token);
+            return;
+          }
+          func.Instructions.emplace_back(order | memory_order);
+        }
+        break;
+
       case CryoOpcode::CALL_from_assembly_signature:
         {
           uint32_t sig_index = 0;
@@ -401,6 +473,54 @@ namespace Cryo::Assembler {
       default:
         break;
     }
+
+    if (m_Format == CodeFormat::Register)
+    {
+      if (InstructionSet::is_stack_layout(opcode))
+      {
+        // The variables were still tracked above, they're slots of the frame reserved on CALL
+        func.Instructions.resize(instruction_start);
+      }
+      else if (opcode == CryoOpcode::CALL_from_assembly_signature || opcode == CryoOpcode::IMPL)
+      {
+        auto frame_offset = get_call_frame_offset(instruction + 1, variables, errors);
+        if (!frame_offset.has_value())
+        {
+          return;
+        }
+        func.Instructions[instruction_start] = opcode == CryoOpcode::IMPL ? CryoOpcode::IMPLR : CryoOpcode::CALLR_from_assembly_signature;
+        func.Instructions.emplace_back(frame_offset.value());
+      }
+    }
+  }
+
+  std::optional<uint32_t> Assembler::get_call_frame_offset(uint32_t signature_token, const VariableStack& variables, ErrorQueue& errors)
+  {
+    // Signatures are $return::name::param::param..., every type without its '@'
+    std::string_view signature = m_Tokens[signature_token].tokenText.substr(1);
+    uint32_t arguments_size = 0;
+    for (uint32_t part = 0; !signature.empty(); part++)
+    {
+      size_t end = signature.find("::");
+      std::string_view name = signature.substr(0, end);
+      signature = end == std::string_view::npos ? std::string_view() : signature.substr(end + 2);
+      if (part == 1) { continue; } // Function name
+
+      auto size = TypeList::get_size_from_type("@" + std::string(name));
+      if (!size.has_value())
+      {
+        PUSH_ERROR(errors, ERR_A_UNKNOWN_TYPE, signature_token);
+        return std::nullopt;
+      }
+      arguments_size += size.value();
+    }
+
+    if (arguments_size > variables.get_size())
+    {
+      PUSH_ERROR(errors, ERR_A_CALL_ARGUMENTS_NOT_ON_STACK, signature_token);
+      return std::nullopt;
+    }
+    return variables.get_size() - arguments_size;
   }
 
 #define WRITE_BINARY(stream, x) stream.write(reinterpret_cast<const char*>(&x), sizeof(x))
@@ -460,6 +580,12 @@ namespace Cryo::Assembler {
       // Return size
 		  WRITE_BINARY(file_stream, func.second.ReturnSize);
 
+      // Frame size
+      WRITE_BINARY(file_stream, func.second.FrameSize);
+
+      // Flags
+      WRITE_BINARY(file_stream, func.second.Flags);
+
       // Parameters Sizes
       for (uint32_t param_size : func.second.ParametersSizes)
       {
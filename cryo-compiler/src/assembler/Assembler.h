@@ -28,12 +28,19 @@ namespace Cryo::Assembler {
 
     uint32_t ReturnSize = 0;
     std::vector<uint32_t> ParametersSizes;
+    // Types of the return and of every parameter in ParametersSizes, the atomic instructions check their operands against them
+    std::string_view ReturnType;
+    std::vector<std::string_view> ParametersTypes;
+    // Largest the function's stack gets, return and parameters included, so the interpreter can reserve the frame up front
+    uint32_t FrameSize = 0;
+    // CryoFunctionFlags
+    uint32_t Flags = 0;
 	};
 
 	class Assembler
 	{
 	public:
-		Assembler(const std::filesystem::path& path);
+		Assembler(const std::filesystem::path& path, CodeFormat format = CodeFormat::Stack);
 
 		void assemble(ErrorQueue& errors);
 
@@ -49,9 +56,13 @@ namespace Cryo::Assembler {
 		
     void assemble_instruction(uint32_t instruction, Function& func, VariableStack& variables, ErrorQueue& errors);
 
+    // Offset of the callee's frame in the caller's, where the return and parameters of the signature are on top of the variables
+    std::optional<uint32_t> get_call_frame_offset(uint32_t signature_token, const VariableStack& variables, ErrorQueue& errors);
+
 		void serialize();
 
 		// Output
+		CodeFormat m_Format = CodeFormat::Stack;
 		std::filesystem::path m_OutputFile;
     std::set<std::string> m_StringLiterals;
 		std::unordered_map<std::string, Function> m_Functions;
@@ -26,6 +26,17 @@ namespace Cryo::Assembler {
     return s_InstructionParamsSize[opcode];
   }
 
+  std::optional<CryoMemoryOrder> InstructionSet::get_memory_order(std::string_view token)
+  {
+    auto ite = s_MemoryOrders.find(token);
+    if (ite == s_MemoryOrders.end())
+    {
+      return std::nullopt;
+    }
+
+    return ite->second;
+  }
+
   std::map<std::pair<std::string_view, std::vector<TokenType>>, CryoOpcode> InstructionSet::s_Instructions = 
   {
     { std::make_pair("STLS", std::vector<TokenType>{}), CryoOpcode::STLS },
@@ -37,6 +48,17 @@ namespace Cryo::Assembler {
 
     { std::make_pair("SETSTR", std::vector{ TokenType::ID, TokenType::StringLiteral }), CryoOpcode::SETSTR },
 
+    { std::make_pair("MOVU32", std::vector{ TokenType::ID, TokenType::ID }), CryoOpcode::MOVU32 },
+    { std::make_pair("ADDU32", std::vector{ TokenType::ID, TokenType::ID, TokenType::ID }), CryoOpcode::ADDU32 },
+    { std::make_pair("SUBU32", std::vector{ TokenType::ID, TokenType::ID, TokenType::ID }), CryoOpcode::SUBU32 },
+    { std::make_pair("MULU32", std::vector{ TokenType::ID, TokenType::ID, TokenType::ID }), CryoOpcode::MULU32 },
+
+    { std::make_pair("ATOMIC_LOAD",  std::vector{ TokenType::ID, TokenType::ID, TokenType::MemoryOrder }), CryoOpcode::ATOMIC_LOAD },
+    { std::make_pair("ATOMIC_STORE", std::vector{ TokenType::ID, TokenType::ID, TokenType::MemoryOrder }), CryoOpcode::ATOMIC_STORE },
+    { std::make_pair("ATOMIC_ADD",   std::vector{ TokenType::ID, TokenType::ID, TokenType::ID, TokenType::MemoryOrder }), CryoOpcode::ATOMIC_ADD },
+    { std::make_pair("ATOMIC_CAS",   std::vector{ TokenType::ID, TokenType::ID, TokenType::ID, TokenType::MemoryOrder }), CryoOpcode::ATOMIC_CAS },
+    { std::make_pair("FENCE",        std::vector{ TokenType::MemoryOrder }), CryoOpcode::FENCE },
+
     { std::make_pair("RETURN", std::vector<TokenType>{} ), CryoOpcode::RETURN },
     { std::make_pair("CALL", std::vector{ TokenType::ID }), CryoOpcode::CALL_from_assembly_signature },
     { std::make_pair("IMPL", std::vector{ TokenType::ID }), CryoOpcode::IMPL }
@@ -52,6 +74,17 @@ namespace Cryo::Assembler {
     "SETU32",
 
     "SETSTR",
+
+    "MOVU32",
+    "ADDU32",
+    "SUBU32",
+    "MULU32",
+
+    "ATOMIC_LOAD",
+    "ATOMIC_STORE",
+    "ATOMIC_ADD",
+    "ATOMIC_CAS",
+    "FENCE",
     
     "RETURN",
     "CALL",
@@ -66,9 +99,31 @@ namespace Cryo::Assembler {
     { POP,     4 },
     { SETU32,  8 },
     { SETSTR,  8 },
+    { MOVU32,  8 },
+    { ADDU32,  12 },
+    { SUBU32,  12 },
+    { MULU32,  12 },
+    { ATOMIC_LOAD,  12 },
+    { ATOMIC_STORE, 12 },
+    { ATOMIC_ADD,   16 },
+    { ATOMIC_CAS,   16 },
+    { FENCE,        4 },
     { RETURN,  0 },
+    { CALL_from_assembly_index, 4 },
     { CALL_from_assembly_signature, 4 },
-    { IMPL,    4 }
+    { IMPL,    4 },
+    { CALLR_from_assembly_index, 8 },
+    { CALLR_from_assembly_signature, 8 },
+    { IMPLR,   8 }
+  };
+
+  std::unordered_map<std::string_view, CryoMemoryOrder> InstructionSet::s_MemoryOrders =
+  {
+    { "relaxed", MEMORY_ORDER_RELAXED },
+    { "acquire", MEMORY_ORDER_ACQUIRE },
+    { "release", MEMORY_ORDER_RELEASE },
+    { "acq_rel", MEMORY_ORDER_ACQ_REL },
+    { "seq_cst", MEMORY_ORDER_SEQ_CST }
   };
 
 }
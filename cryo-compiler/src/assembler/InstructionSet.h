@@ -4,6 +4,7 @@
 #include "Token.h"
 
 #include <map>
+#include <optional>
 #include <unordered_set>
 #include <vector>
 #include <string_view>
@@ -20,10 +21,19 @@ namespace Cryo::Assembler {
 
     static uint32_t get_params_size(CryoOpcode opcode);
 
+    /// <returns> Returns the CryoMemoryOrder a MemoryOrder token names, nullopt if it's not one </returns>
+    static std::optional<CryoMemoryOrder> get_memory_order(std::string_view token);
+
+    /// <summary>
+    /// Stack layout instructions only exist in the stack format, the register format drops them
+    /// </summary>
+    static bool is_stack_layout(CryoOpcode opcode) { return opcode == STLS || opcode == STLE || opcode == PUSH || opcode == POP; }
+
   private:
     static std::map<std::pair<std::string_view, std::vector<TokenType>>, CryoOpcode> s_Instructions;
     static std::unordered_set<std::string_view> s_InstructionList;
     static std::unordered_map<CryoOpcode, uint32_t> s_InstructionParamsSize;
+    static std::unordered_map<std::string_view, CryoMemoryOrder> s_MemoryOrders;
   };
 
 }
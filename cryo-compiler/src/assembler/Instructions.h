@@ -21,14 +21,90 @@ namespace Cryo::Assembler {
     SETU32   = 0x0000005,
     SETSTR =   0x0000006,
 
+    /// Copy: 4 bytes opcode, 4 bytes uint for the destination and source variable indices
+    MOVU32 = 0x00000007,
+    /// Three address arithmetic: 4 bytes opcode, 4 bytes uint for the destination and both source variable indices
+    ADDU32 = 0x00000008,
+    SUBU32 = 0x00000009,
+    MULU32 = 0x0000000A,
+
+    /// Atomics on a @uint32 variable, or on the @uint32 a @void* variable points to. Their last 4 bytes uint is a CryoMemoryOrder,
+    /// with ATOMIC_HEAP set when the slot variable is a @void*
+    /// Load: 4 bytes opcode, 4 bytes uint for the destination and slot variable indices, 4 bytes order
+    ATOMIC_LOAD  = 0x0000000B,
+    /// Store: 4 bytes opcode, 4 bytes uint for the slot and source variable indices, 4 bytes order
+    ATOMIC_STORE = 0x0000000C,
+    /// Fetch add: 4 bytes opcode, 4 bytes uint for the destination, which gets the slot's previous value, slot and source variable indices, 4 bytes order
+    ATOMIC_ADD   = 0x0000000D,
+    /// Compare exchange: 4 bytes opcode, 4 bytes uint for the slot, expected and desired variable indices, 4 bytes order.
+    /// Expected gets the value the slot held, so it's unchanged only if the exchange happened
+    ATOMIC_CAS   = 0x0000000E,
+    /// Fence: 4 bytes opcode, 4 bytes order
+    FENCE        = 0x0000000F,
+
 		/// Return: 4 bytes opcode
 		RETURN = 0x01000000,
-		/// Call function in the same assembly as the caller function, 4 bytes opcode, 4 bytes uint for function index
+		/// Call function in the same assembly as the caller function, 4 bytes opcode, 4 bytes uint for the callee's index in the function table, emitted by the linker
 		CALL_from_assembly_index = 0x02000000,
 		/// Call function in the same assembly as the caller function, 4 bytes opcode, 4 bytes uint for string literal index for the signature
 		CALL_from_assembly_signature = 0x03000000,
 	  // Calls function implemented by the interpreter
-    IMPL = 0x04000000
+    IMPL = 0x04000000,
+
+    /// Register format CALL and IMPL, same operands as the stack format ones plus 4 bytes uint for the offset of the callee's frame in the caller's
+    CALLR_from_assembly_index = 0x05000000,
+    CALLR_from_assembly_signature = 0x06000000,
+    IMPLR = 0x07000000
+  };
+
+  /// <summary>
+  /// Flags stored in a function's declaration
+  /// </summary>
+  enum CryoFunctionFlags : uint32_t
+  {
+    /// Code has no stack layout instructions, variables are fixed frame slots and calls carry the callee's frame offset
+    FUNCTION_REGISTER_FORMAT = 0x00000001
+  };
+
+  /// <summary>
+  /// Memory order operand of the atomic instructions, the C++ orders without consume
+  /// </summary>
+  enum CryoMemoryOrder : uint32_t
+  {
+    MEMORY_ORDER_RELAXED = 0,
+    MEMORY_ORDER_ACQUIRE = 1,
+    MEMORY_ORDER_RELEASE = 2,
+    MEMORY_ORDER_ACQ_REL = 3,
+    MEMORY_ORDER_SEQ_CST = 4
+  };
+
+  /// <summary>
+  /// Set in an atomic instruction's order operand when its slot is a @void* pointing at the @uint32
+  /// </summary>
+  constexpr uint32_t ATOMIC_HEAP = 0x00000010;
+
+  /// <summary>
+  /// Loads can't release and stores can't acquire, like std::atomic
+  /// </summary>
+  constexpr bool is_valid_memory_order(CryoOpcode opcode, uint32_t order)
+  {
+    switch (opcode)
+    {
+    case ATOMIC_LOAD:  return order == MEMORY_ORDER_RELAXED || order == MEMORY_ORDER_ACQUIRE || order == MEMORY_ORDER_SEQ_CST;
+    case ATOMIC_STORE: return order == MEMORY_ORDER_RELAXED || order == MEMORY_ORDER_RELEASE || order == MEMORY_ORDER_SEQ_CST;
+    default:           return order <= MEMORY_ORDER_SEQ_CST;
+    }
+  }
+
+  /// <summary>
+  /// Code format the assembler produces
+  /// </summary>
+  enum class CodeFormat
+  {
+    /// Variables are pushed and popped at run time
+    Stack,
+    /// Variables are slots of a frame reserved whole on CALL
+    Register
   };
 
 }
@@ -35,7 +35,9 @@ namespace Cryo::Assembler {
 		F32,
 		F64, // 1.2, 1.3, 1.0...
 
-		StringLiteral // "foo", "bar"...
+		StringLiteral, // "foo", "bar"...
+
+		MemoryOrder // relaxed, acquire, release, acq_rel, seq_cst
 	};
 
 	struct Token
@@ -93,9 +93,12 @@ namespace Cryo::Assembler {
 						if (isdigit(token.tokenText[0])) { // TODO: Value like 10U32 5I32 3.32F32...
 							validate_value_token(token, errors);
 						}
-						else if (InstructionSet::is_instruction(token.tokenText)) { // Only option left is an instruction
+						else if (InstructionSet::is_instruction(token.tokenText)) {
 							token.type = TokenType::Instruction;
 						}
+						else if (InstructionSet::get_memory_order(token.tokenText).has_value()) { // Only option left is a memory order
+							token.type = TokenType::MemoryOrder;
+						}
 						else {
 							errors.push_error(ERR_A_COULD_NOT_DETERMINE_TOKEN_TYPE, m_FilePath, m_Buffer, m_BufferSize, token.tokenText);
 						}
@@ -3,15 +3,16 @@
 
 namespace Cryo::Assembler {
 
-  bool VariableStack::push_variable(std::string_view name, uint32_t size)
+  bool VariableStack::push_variable(std::string_view name, uint32_t size, std::string_view type)
   {
     if (m_Variables.contains(name))
     {
       return false; 
     }
 
-    m_Variables.insert(std::pair(name, VariableData { name, size, m_StackCounter })); 
+    m_Variables.insert(std::pair(name, VariableData { name, size, m_StackCounter, type })); 
     m_StackCounter += size;
+    m_MaxStackCounter = std::max(m_MaxStackCounter, m_StackCounter);
     m_Stack.push(name);
 
     if (!m_StackLayers.empty())
@@ -24,7 +25,7 @@ namespace Cryo::Assembler {
   
   bool VariableStack::pop_variable()
   {
-    if (m_Variables.empty())
+    if (m_Variables.empty() || (!m_StackLayers.empty() && m_StackLayers.top() == 0))
     {
       return false;
     }
@@ -37,10 +38,6 @@ namespace Cryo::Assembler {
 
     if (!m_StackLayers.empty())
     {
-      if (m_StackLayers.top() == 0)
-      {
-        return false;
-      }
       m_StackLayers.top() -= 1;
     }
 
@@ -59,6 +56,11 @@ namespace Cryo::Assembler {
       return false;
     }
 
+    // The interpreter pops every variable left in the layer, so their space is reused by what comes after
+    for (uint32_t count = m_StackLayers.top(); count > 0; count--)
+    {
+      pop_variable();
+    }
     m_StackLayers.pop();
     return true;
   }
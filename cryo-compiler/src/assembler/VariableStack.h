@@ -14,12 +14,14 @@ namespace Cryo::Assembler {
     std::string_view Name;
     uint32_t Size = 0;
     uint32_t Position = 0;
+    /// Type the variable was declared with, like "@uint32"
+    std::string_view Type;
   };
 
   class VariableStack
   {
   public:
-    bool push_variable(std::string_view name, uint32_t size);
+    bool push_variable(std::string_view name, uint32_t size, std::string_view type);
     bool pop_variable();
 
     void start_stack_layer();
@@ -29,12 +31,19 @@ namespace Cryo::Assembler {
 
     const VariableData* get_variable(std::string_view name);
 
+    /// <summary>
+    /// Largest size the stack reached, which is the size of the function's frame
+    /// </summary>
+    uint32_t get_max_size() const { return m_MaxStackCounter; }
+    uint32_t get_size() const { return m_StackCounter; }
+
   private:
     std::unordered_map<std::string_view, VariableData> m_Variables;
     std::stack<std::string_view> m_Stack;
     // Stack with the count of variables in each layer
     std::stack<uint32_t> m_StackLayers;
     uint32_t m_StackCounter = 0;
+    uint32_t m_MaxStackCounter = 0;
   };
 
 }
@@ -31,13 +31,17 @@ namespace Cryo {
     { ERR_A_THERE_ARE_NO_STACK_LAYERS_TO_BE_CLOSED,                   { "There are no StackLayers to be closed!",                    Error::level_error } },
     { ERR_A_UNKNOWN_TYPE,                                             { "Unknown type used!",                                        Error::level_error } },
     { ERR_A_STRING_LITERAL_MISSING_END,                               { "String literal missing end!",                               Error::level_error } },
+    { ERR_A_CALL_ARGUMENTS_NOT_ON_STACK,                              { "Stack doesn't hold the callee's return and parameters!",    Error::level_error } },
+    { ERR_A_INVALID_MEMORY_ORDER,                                     { "Memory order not allowed for this instruction!",            Error::level_error } },
+    { ERR_A_INVALID_ATOMIC_OPERAND,                                   { "Atomic slots must be @uint32 or @void*, other operands @uint32!", Error::level_error } },
 
     // Linker Errors
     { ERR_L_UNABLE_TO_OPEN_FILE,                                      { "Failed to open file!",                                      Error::level_critical } },
     { ERR_L_UNABLE_TO_VALIDATE_HEADER,                                { "Failed to validate header!",                                Error::level_error } },
     { ERR_L_UNEXPECTED_FILE_END,                                      { "Unexpected file end!",                                      Error::level_error } },
     { ERR_L_UNRESOLVED_EXTERNAL_REFRENCE,                             { "Unresolved external reference!",                            Error::level_error } },
-    { ERR_L_SYMBOL_REDEFINITION,                                      { "Symbol has multiple definitions!",                          Error::level_error } }
+    { ERR_L_SYMBOL_REDEFINITION,                                      { "Symbol has multiple definitions!",                          Error::level_error } },
+    { ERR_L_SIGNATURE_HASH_FAILED,                                    { "Failed to build the signature hash!",                       Error::level_error } }
   };
 
 	Error::Error(std::string_view error_code, const std::filesystem::path& file_path, const char* file_buffer, uint32_t buffer_size, std::string_view token,
@@ -118,6 +118,9 @@ namespace Cryo {
 #define ERR_A_THERE_ARE_NO_STACK_LAYERS_TO_BE_CLOSED               "EA-0x1011"
 #define ERR_A_UNKNOWN_TYPE                                         "EA-0x1012"
 #define ERR_A_STRING_LITERAL_MISSING_END                           "EA-0x1013"
+#define ERR_A_CALL_ARGUMENTS_NOT_ON_STACK                          "EA-0x1014"
+#define ERR_A_INVALID_MEMORY_ORDER                                 "EA-0x1015"
+#define ERR_A_INVALID_ATOMIC_OPERAND                               "EA-0x1016"
 
 // Linker Errors
 #define ERR_L_UNABLE_TO_OPEN_FILE                                  "EL-0x1000"
@@ -125,3 +128,4 @@ namespace Cryo {
 #define ERR_L_UNEXPECTED_FILE_END                                  "EL-0x1002"
 #define ERR_L_UNRESOLVED_EXTERNAL_REFRENCE                         "EL-0x1003"
 #define ERR_L_SYMBOL_REDEFINITION                                  "EL-0x1004"
+#define ERR_L_SIGNATURE_HASH_FAILED                                "EL-0x1005"
@@ -88,11 +88,11 @@ namespace Cryo {
     return 0;
   }
 
-  ErrorQueue assemble_file(const std::filesystem::path& file)
+  ErrorQueue assemble_file(const std::filesystem::path& file, Assembler::CodeFormat format)
   {
     ErrorQueue errors;
 
-    Assembler::Assembler assembler = Assembler::Assembler(file);
+    Assembler::Assembler assembler = Assembler::Assembler(file, format);
     assembler.assemble(errors);
 
     return errors;
@@ -117,6 +117,25 @@ namespace Cryo {
       std::filesystem::create_directories(wks_dir / "bin/int");
     }
 
+    Assembler::CodeFormat format = Assembler::CodeFormat::Stack;
+    bool external_calls = false;
+    std::vector<std::filesystem::path> libraries;
+    for (int i = 2; i < m_Argc; i++)
+    {
+      if (std::string_view(m_Argv[i]) == "--register")
+      {
+        format = Assembler::CodeFormat::Register;
+      }
+      else if (std::string_view(m_Argv[i]) == "--external")
+      {
+        external_calls = true;
+      }
+      else if (std::string_view(m_Argv[i]) == "--import" && i + 1 < m_Argc)
+      {
+        libraries.emplace_back(m_Argv[++i]);
+      }
+    }
+
     spdlog::info("Building...");
 
     Assembler::TypeList::clear_custom_types();
@@ -144,7 +163,7 @@ namespace Cryo {
       {
         std::filesystem::path file = files.front();
         spdlog::info("Assembling {0}", file.string());
-        thread = std::async(&assemble_file, file);
+        thread = std::async(&assemble_file, file, format);
         files.pop();
       }
       else 
@@ -176,7 +195,16 @@ namespace Cryo {
     spdlog::info("Linking...");
     // TODO: Linker
 
-    Linker::Linker linker;
+    Linker::Linker linker(external_calls);
+    for (auto& library : libraries)
+    {
+      auto library_errors = linker.link_dependencies(wks_dir / "bin", library);
+      library_errors.log();
+      if (library_errors.get_severity() > Error::level_warning)
+      {
+        return -1;
+      }
+    }
     auto link_errors = linker.link_project(wks_dir / "bin/int", wks_dir / "bin");
 
     link_errors.log();
@@ -216,7 +244,9 @@ namespace Cryo {
   std::unordered_map<std::string_view, std::string_view> s_ActionExplanations = 
   {
     { "new",    "new {folder} | Creates a new workspace at {folder} with a start project named {folder}!" },
-    { "build",  "build {configuration} | Compiles workspace at the current folder, default configuration is Debug!" },
+    { "build",  "build {configuration} [--register] [--external] [--import {library.crye}...] | Compiles workspace at the current folder, default configuration is Debug! --register emits register format code,"
+                " --external leaves calls to functions the workspace doesn't define for the interpreter to resolve against the other assemblies it loads,"
+                " --import links calls to the functions of a library image as imports, the interpreter loads the library the first time one runs" },
     { "clean",  "clean | Cleans compilation remaints!" },
     { "run",    "run {args...} | build and run the 'startup project' in the current workspace with {args...} as command line arguments!"},
     { "quit",   "" }
@@ -2,6 +2,7 @@
 #include "assembler/Instructions.h"
 #include "cryopch.h"
 #include "Linker.h"
+#include "CryoImage.h"
 
 #include "common/Error.h"
 
@@ -48,6 +49,90 @@ namespace Cryo::Linker {
     return errors;
   }
 
+  ErrorQueue Linker::link_dependencies(const std::filesystem::path& dest, const std::filesystem::path& src)
+  {
+    ErrorQueue errors;
+
+    std::ifstream file_stream(src, std::ios::binary | std::ios::in);
+    std::vector<uint8_t> image(file_stream ? std::filesystem::file_size(src) : 0);
+    if (!file_stream || !file_stream.read((char*)image.data(), image.size()))
+    {
+      errors.push_error(ERR_L_UNABLE_TO_OPEN_FILE, src);
+      return errors;
+    }
+
+    CryoImageHeader header;
+    if (image.size() < sizeof(header))
+    {
+      errors.push_error(ERR_L_UNEXPECTED_FILE_END, src);
+      return errors;
+    }
+    std::memcpy(&header, image.data(), sizeof(header));
+    if (std::memcmp(header.Magic, CRYO_IMAGE_MAGIC_V2, sizeof(header.Magic)) != 0 || header.Version != CRYO_IMAGE_VERSION || header.SectionCount != SECTION_COUNT)
+    {
+      errors.push_error(ERR_L_UNABLE_TO_VALIDATE_HEADER, src, nullptr, 0, std::string_view(), "Libraries must be linked by this version of cryoc!");
+      return errors;
+    }
+    for (const CryoImageSection& section : header.Sections)
+    {
+      if (uint64_t(section.Offset) + section.Size > image.size())
+      {
+        errors.push_error(ERR_L_UNEXPECTED_FILE_END, src);
+        return errors;
+      }
+    }
+
+    auto section_data = [&](CryoImageSectionId id) { return image.data() + header.Sections[id].Offset; };
+    const CryoImageSection& strings_section = header.Sections[SECTION_STRING_TABLE];
+    const CryoImageSection& data_section = header.Sections[SECTION_STRING_DATA];
+    const CryoImageSection& functions_section = header.Sections[SECTION_FUNCTIONS];
+    const CryoImageSection& parameters_section = header.Sections[SECTION_PARAMETERS];
+    if (uint64_t(strings_section.Count) * sizeof(CryoImageString) > strings_section.Size || uint64_t(functions_section.Count) * sizeof(CryoImageFunction) > functions_section.Size
+      || uint64_t(parameters_section.Count) * sizeof(uint32_t) > parameters_section.Size)
+    {
+      errors.push_error(ERR_L_UNEXPECTED_FILE_END, src);
+      return errors;
+    }
+
+    // Stored relative to where the image goes, so the image and its libraries can be moved together
+    std::string library = std::filesystem::absolute(src).lexically_relative(std::filesystem::absolute(dest)).generic_string();
+    m_StringLiterals.insert(library);
+
+    for (uint32_t i = 0; i < functions_section.Count; i++)
+    {
+      CryoImageFunction record;
+      std::memcpy(&record, section_data(SECTION_FUNCTIONS) + i * sizeof(record), sizeof(record));
+      CryoImageString signature;
+      if (record.Signature >= strings_section.Count || uint64_t(record.ParameterStart) + record.ParameterCount > parameters_section.Count)
+      {
+        errors.push_error(ERR_L_UNEXPECTED_FILE_END, src);
+        return errors;
+      }
+      std::memcpy(&signature, section_data(SECTION_STRING_TABLE) + record.Signature * sizeof(signature), sizeof(signature));
+      if (uint64_t(signature.Offset) + signature.Length > data_section.Size)
+      {
+        errors.push_error(ERR_L_UNEXPECTED_FILE_END, src);
+        return errors;
+      }
+
+      ImportedFunction func;
+      func.Library = library;
+      func.ReturnSize = record.ReturnSize;
+      func.ParameterSizes.resize(record.ParameterCount);
+      std::memcpy(func.ParameterSizes.data(), section_data(SECTION_PARAMETERS) + record.ParameterStart * sizeof(uint32_t), record.ParameterCount * sizeof(uint32_t));
+
+      std::string name((const char*)section_data(SECTION_STRING_DATA) + signature.Offset, signature.Length);
+      if (m_Importable.contains(name))
+      {
+        errors.push_error(ERR_L_SYMBOL_REDEFINITION, src, nullptr, 0, std::string_view(), std::format("Function [{}] is defined by more than one library!", name));
+        continue;
+      }
+      m_Importable.insert(std::pair(std::move(name), std::move(func)));
+    }
+
+    return errors;
+  }
+
   void Linker::parse_file(const std::filesystem::path& file_path, ErrorQueue& errors)
   {
     std::ifstream file_stream(file_path, std::ios::binary | std::ios::in);
@@ -116,46 +201,39 @@ namespace Cryo::Linker {
     
     // Functions
     {
-      bool last_was_end = false;
-      uint32_t funcs_size = 0;
-      for (const uint32_t* ptr = file_as_u32; ptr < file_buffer.data() + file_buffer.size(); ptr++) // Look for 2 block_end in a row
+      // func { uint32_t signature_id, uint32_t instruction_start, uint32_t instruction_count, uint32_t return_size, uint32_t frame_size, uint32_t flags, uint32_t param_sizes[?], block_end },
+      // the list ends with an extra block_end
+      const uint32_t* file_end = file_buffer.data() + file_buffer.size();
+      for (const uint32_t* record = file_as_u32; record < file_end && *record != block_end;)
       {
-        if (*ptr == block_end)
-        {
-          if (last_was_end)
-          {
-            break;
-          }
-          last_was_end = true;
-        }
-        else
+        if (record + 6 >= file_end)
         {
-          last_was_end = false;
-          funcs_size++;
+          errors.push_error(ERR_L_UNEXPECTED_FILE_END, file_path);
+          return;
         }
-      }
 
-      for (uint32_t i = 0; i < funcs_size; i++)
-      {
         Assembler::Function func;
-        func.Signature = string_literals[file_as_u32[i]]; // String index is the first thing in the func declaration
+        func.Signature = string_literals[record[0]];
         
-        func.Instructions.resize(file_as_u32[i + 2]); // Instruction count is the third
-        std::memcpy(func.Instructions.data(), file_buffer.data() + file_as_u32[i + 1], func.Instructions.size() * sizeof(uint32_t)); // First instruction is the second
+        func.Instructions.resize(record[2]);
+        std::memcpy(func.Instructions.data(), file_buffer.data() + record[1], func.Instructions.size() * sizeof(uint32_t));
 
-        func.ReturnSize = file_as_u32[i + 3]; // ReturnSize is the fourth
-        for (i += 4; file_as_u32[i] != block_end; i++) // Array of return sizes
+        func.ReturnSize = record[3];
+        func.FrameSize = record[4];
+        func.Flags = record[5];
+        for (record += 6; record < file_end && *record != block_end; record++) // Array of parameter sizes
         {
-          func.ParametersSizes.emplace_back(file_as_u32[i]);
+          func.ParametersSizes.emplace_back(*record);
         }
-
-        functions.insert(std::pair(func.Signature, func));
+        record++; // Skip the record's block_end
 
         if (m_FunctionSignatures.contains(func.Signature))
         {
           errors.push_error(ERR_L_SYMBOL_REDEFINITION, file_path, nullptr, 0, std::string_view(), std::format("Function [{}] has multiple definitions!", func.Signature)); 
         }
         m_FunctionSignatures.insert(func.Signature);
+
+        functions.insert(std::pair(func.Signature, func));
       }
     }
 
@@ -194,6 +272,15 @@ namespace Cryo::Linker {
       }
     }
 
+    for (auto& assembly : m_Functions)
+    {
+      for (auto& func : assembly.second)
+      {
+        m_FunctionTableIndex.insert(std::pair(func.second.Signature, m_FunctionTable.size()));
+        m_FunctionTable.emplace_back(FunctionTableEntry{ &assembly.first, &func.second });
+      }
+    }
+
     for (auto& assembly : m_Functions)
     {
       for (auto& func : assembly.second)
@@ -219,21 +306,47 @@ namespace Cryo::Linker {
           break;
 
         case Assembler::CALL_from_assembly_signature:
+        case Assembler::CALLR_from_assembly_signature:
           {
-            i++;
-            if (!m_FunctionSignatures.contains(m_OldStringLists[file].at(func.Instructions[i])))
+            const std::string& signature = m_OldStringLists[file].at(func.Instructions[i + 1]);
+            auto ite = m_FunctionTableIndex.find(signature);
+            auto imported = ite == m_FunctionTableIndex.end() ? m_Importable.find(signature) : m_Importable.end();
+            if (imported != m_Importable.end())
+            {
+              m_Imports.insert(std::pair(signature, &imported->second));
+            }
+            if (ite == m_FunctionTableIndex.end() && (m_ExternalCalls || imported != m_Importable.end()))
+            {
+              // Stays a call by signature, into the string literals of the output
+              i++;
+              func.Instructions[i] = m_OldStrIndexToNewStrIndex[file].at(func.Instructions[i]);
+              i += func.Instructions[i - 1] == Assembler::CALLR_from_assembly_signature ? 1 : 0; // Frame offset
+              break;
+            }
+            if (ite == m_FunctionTableIndex.end())
             {
               error.push_error(ERR_L_UNRESOLVED_EXTERNAL_REFRENCE, file, nullptr, 0, std::string_view(),
-                  "Failed to find function: " + m_OldStringLists[file].at(func.Instructions[i]));
+                  "Failed to find function: " + signature);
               return;
             }
-            func.Instructions[i] = m_OldStrIndexToNewStrIndex[file].at(func.Instructions[i]);
+
+            // The callee is in this image, call it by its function table index so the interpreter doesn't look up the signature
+            bool register_format = func.Instructions[i] == Assembler::CALLR_from_assembly_signature;
+            func.Instructions[i] = register_format ? Assembler::CALLR_from_assembly_index : Assembler::CALL_from_assembly_index;
+            i++;
+            func.Instructions[i] = ite->second;
+            i += register_format ? 1 : 0; // Frame offset
           }
           break;
 
         case Assembler::IMPL:
-          i++;
-          func.Instructions[i] = m_OldStrIndexToNewStrIndex[file].at(func.Instructions[i]);
+        case Assembler::IMPLR:
+          {
+            bool register_format = func.Instructions[i] == Assembler::IMPLR;
+            i++;
+            func.Instructions[i] = m_OldStrIndexToNewStrIndex[file].at(func.Instructions[i]);
+            i += register_format ? 1 : 0; // Frame offset
+          }
           break;
 
         default:
@@ -247,69 +360,175 @@ namespace Cryo::Linker {
 
   void Linker::serialize(const std::filesystem::path& output, ErrorQueue& errors)
   {
-    std::ofstream file_stream(output);
-    
-    constexpr uint32_t block_end = std::numeric_limits<uint32_t>::max();
-
-    constexpr const char* header_string = "CRYOEXE";
+    // Sections are built in memory first, their offsets go in the header that precedes them
+    CryoImageHeader header;
+    std::memcpy(header.Magic, CRYO_IMAGE_MAGIC_V2, sizeof(header.Magic));
+
+    // Index order of the strings is m_StringLiterals' iteration order, like remap_ids assumed
+    std::vector<CryoImageString> string_table;
+    std::string string_data;
+    std::unordered_map<std::string_view, uint32_t> string_index;
+    string_table.reserve(m_StringLiterals.size());
+    for (auto& str : m_StringLiterals)
+    {
+      string_index.insert(std::pair(std::string_view(str), string_table.size()));
+      string_table.emplace_back(CryoImageString{ (uint32_t)string_data.size(), (uint32_t)str.size() });
+      string_data += str;
+      string_data += '\0';
+    }
+    uint32_t string_data_size = string_data.size();
+    string_data.resize((string_data.size() + sizeof(uint32_t) - 1) / sizeof(uint32_t) * sizeof(uint32_t), '\0');
 
-    file_stream.write(header_string, 8);
+    std::vector<uint32_t> seeds;
+    std::vector<uint32_t> slots;
+    if (!build_signature_hash(seeds, slots))
+    {
+      errors.push_error(ERR_L_SIGNATURE_HASH_FAILED, output);
+      return;
+    }
+    std::vector<uint32_t> signature_index = seeds;
+    signature_index.insert(signature_index.end(), slots.begin(), slots.end());
 
-    uint32_t strings_size = 0;
-    for (auto& str : m_StringLiterals)
+    std::vector<CryoImageFunction> functions(m_FunctionTable.size());
+    std::vector<uint32_t> parameters;
+    size_t code_words = 0;
+    for (uint32_t i = 0; i < m_FunctionTable.size(); i++)
     {
-      file_stream << str << '\0';
-      strings_size += str.size() + 1;
+      const auto& entry = m_FunctionTable[i];
+      const Assembler::Function& func = *entry.Function;
+
+      CryoImageFunction& record = functions[i];
+      record.Signature = m_OldStrIndexToNewStrIndex.at(*entry.File).at(m_OldIndex[*entry.File].at(func.Signature));
+      record.InstructionCount = func.Instructions.size();
+      record.ReturnSize = func.ReturnSize;
+      record.FrameSize = func.FrameSize;
+      record.Flags = func.Flags;
+      record.ParameterStart = parameters.size();
+      record.ParameterCount = func.ParametersSizes.size();
+      parameters.insert(parameters.end(), func.ParametersSizes.begin(), func.ParametersSizes.end());
+      code_words += func.Instructions.size() + 1;
     }
-    for (uint32_t spacing = sizeof(uint32_t) - (strings_size % sizeof(uint32_t)); spacing > 0; spacing--)
+
+    // Signatures of imports are string literals of the calls to them, library paths were added by link_dependencies
+    std::vector<CryoImageImport> imports;
+    imports.reserve(m_Imports.size());
+    for (auto& [signature, func] : m_Imports)
     {
-      file_stream << '\0';
+      imports.emplace_back(CryoImageImport{ string_index.at(signature), string_index.at(func->Library), func->ReturnSize,
+        (uint32_t)parameters.size(), (uint32_t)func->ParameterSizes.size() });
+      parameters.insert(parameters.end(), func->ParameterSizes.begin(), func->ParameterSizes.end());
     }
 
-    WRITE_BINARY(file_stream, block_end);
-    
-    std::unordered_map<std::string, std::streamoff> function_indexes;
-    for (auto assembly : m_Functions)
+    auto place = [offset = (uint32_t)sizeof(CryoImageHeader)](CryoImageSection& section, size_t size, size_t count) mutable {
+      section = CryoImageSection{ offset, (uint32_t)size, (uint32_t)count };
+      offset += size;
+    };
+    place(header.Sections[SECTION_STRING_TABLE], string_table.size() * sizeof(CryoImageString), string_table.size());
+    place(header.Sections[SECTION_STRING_DATA], string_data.size(), string_data_size);
+    place(header.Sections[SECTION_SIGNATURE_INDEX], signature_index.size() * sizeof(uint32_t), seeds.size());
+    place(header.Sections[SECTION_FUNCTIONS], functions.size() * sizeof(CryoImageFunction), functions.size());
+    place(header.Sections[SECTION_PARAMETERS], parameters.size() * sizeof(uint32_t), parameters.size());
+    place(header.Sections[SECTION_IMPORTS], imports.size() * sizeof(CryoImageImport), imports.size());
+    place(header.Sections[SECTION_CODE], code_words * sizeof(uint32_t), functions.size());
+
+    uint32_t code_start = header.Sections[SECTION_CODE].Offset / sizeof(uint32_t);
+    for (uint32_t i = 0; i < m_FunctionTable.size(); i++)
     {
-      for (auto func : assembly.second)
-      {
-        uint32_t signature_index = m_OldStrIndexToNewStrIndex.at(assembly.first).at(m_OldIndex[assembly.first].at(func.second.Signature));
-        WRITE_BINARY(file_stream, signature_index);
+      functions[i].CodeStart = code_start;
+      code_start += functions[i].InstructionCount + 1; // Block end after the code
+    }
 
-        function_indexes.insert(std::pair(func.second.Signature, file_stream.tellp()));
-        constexpr uint32_t placeholder = 0;
-        WRITE_BINARY(file_stream, placeholder);
+    std::ofstream file_stream(output, std::ios::binary | std::ios::out | std::ios::trunc);
+    if (!file_stream)
+    {
+      errors.push_error(ERR_L_UNABLE_TO_OPEN_FILE, output);
+      return;
+    }
 
-        uint32_t size = func.second.Instructions.size();
-        WRITE_BINARY(file_stream, size);
+    WRITE_BINARY(file_stream, header);
+    file_stream.write(reinterpret_cast<const char*>(string_table.data()), string_table.size() * sizeof(CryoImageString));
+    file_stream.write(string_data.data(), string_data.size());
+    file_stream.write(reinterpret_cast<const char*>(signature_index.data()), signature_index.size() * sizeof(uint32_t));
+    file_stream.write(reinterpret_cast<const char*>(functions.data()), functions.size() * sizeof(CryoImageFunction));
+    file_stream.write(reinterpret_cast<const char*>(parameters.data()), parameters.size() * sizeof(uint32_t));
+    file_stream.write(reinterpret_cast<const char*>(imports.data()), imports.size() * sizeof(CryoImageImport));
+    for (auto& entry : m_FunctionTable)
+    {
+      const Assembler::Function& func = *entry.Function;
+      file_stream.write(reinterpret_cast<const char*>(func.Instructions.data()), func.Instructions.size() * sizeof(uint32_t));
+      WRITE_BINARY(file_stream, CRYO_BLOCK_END);
+    }
+  }
 
-        WRITE_BINARY(file_stream, func.second.ReturnSize);
+  bool Linker::build_signature_hash(std::vector<uint32_t>& seeds, std::vector<uint32_t>& slots) const
+  {
+    uint32_t function_count = m_FunctionTable.size();
+    slots.assign(function_count, CRYO_BLOCK_END);
+    if (function_count == 0)
+    {
+      seeds.clear();
+      return true;
+    }
 
-        for (auto param : func.second.ParametersSizes)
-        {
-          WRITE_BINARY(file_stream, param);
-        }
+    // Around 4 signatures per bucket keeps the seed search short and the seed table a quarter of the slot table
+    uint32_t bucket_count = (function_count + 3) / 4;
+    seeds.assign(bucket_count, 0);
 
-        WRITE_BINARY(file_stream, block_end);
-      }
+    std::vector<uint64_t> hashes(function_count);
+    std::vector<std::vector<uint32_t>> buckets(bucket_count);
+    for (uint32_t i = 0; i < function_count; i++)
+    {
+      hashes[i] = hash_signature(m_FunctionTable[i].Function->Signature);
+      buckets[hash_signature_bucket(hashes[i], bucket_count)].emplace_back(i);
     }
-    WRITE_BINARY(file_stream, block_end);
 
-    for (auto& assembly : m_Functions)
+    // Largest buckets first, while most slots are still free
+    std::vector<uint32_t> order(bucket_count);
+    for (uint32_t i = 0; i < bucket_count; i++) { order[i] = i; }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+
+    constexpr uint32_t max_seed = 1 << 20;
+    std::vector<uint32_t> bucket_slots;
+    for (uint32_t bucket : order)
     {
-      for (auto& func : assembly.second)
+      if (buckets[bucket].empty())
       {
-        std::streamoff pos = file_stream.tellp();
-        file_stream.seekp(function_indexes[func.second.Signature]);
+        break;
+      }
 
-        uint32_t func_index = pos / sizeof(uint32_t);
-        WRITE_BINARY(file_stream, func_index);
+      bool placed = false;
+      for (uint32_t seed = 0; seed < max_seed && !placed; seed++)
+      {
+        bucket_slots.clear();
+        placed = true;
+        for (uint32_t function : buckets[bucket])
+        {
+          uint32_t slot = hash_signature_slot(hashes[function], seed, function_count);
+          if (slots[slot] != CRYO_BLOCK_END || std::find(bucket_slots.begin(), bucket_slots.end(), slot) != bucket_slots.end())
+          {
+            placed = false;
+            break;
+          }
+          bucket_slots.emplace_back(slot);
+        }
+
+        if (placed)
+        {
+          seeds[bucket] = seed;
+          for (uint32_t i = 0; i < bucket_slots.size(); i++)
+          {
+            slots[bucket_slots[i]] = buckets[bucket][i];
+          }
+        }
+      }
 
-        file_stream.seekp(pos);
-        file_stream.write(reinterpret_cast<const char*>(func.second.Instructions.data()), func.second.Instructions.size() * sizeof(uint32_t));
-        WRITE_BINARY(file_stream, block_end);
+      if (!placed)
+      {
+        return false;
       }
     }
+
+    return true;
   }
 
 }
@@ -6,6 +6,7 @@
 #include <filesystem>
 #include <unordered_set>
 #include <unordered_map>
+#include <map>
 #include <string>
 
 namespace Cryo::Linker {
@@ -13,7 +14,22 @@ namespace Cryo::Linker {
   class Linker
   {
   public:
+    /// <summary>
+    /// external_calls leaves calls to functions the project doesn't define as calls by signature, resolved by the interpreter
+    /// against the other assemblies it's given, instead of failing with ERR_L_UNRESOLVED_EXTERNAL_REFRENCE
+    /// </summary>
+    Linker(bool external_calls = false)
+      : m_ExternalCalls(external_calls)
+    {
+    }
+
     ErrorQueue link_project(const std::filesystem::path& prj_int_dir, const std::filesystem::path& prj_bin_dir);
+    /// <summary>
+    /// Makes the functions of the library image src importable, calls to them are emitted as calls by signature with an import table entry
+    /// and the interpreter loads src the first time one of them runs. Must be called before link_project
+    /// </summary>
+    /// <param name="dest"> Folder the image is written to, the library's path is stored relative to it </param>
+    /// <param name="src"> Library .crye, a v3 image </param>
     ErrorQueue link_dependencies(const std::filesystem::path& dest, const std::filesystem::path& src);
 
   private:
@@ -21,6 +37,15 @@ namespace Cryo::Linker {
     void remap_ids(ErrorQueue& errors);
     void remap_func(Assembler::Function& func, const std::filesystem::path& file, ErrorQueue& errors);
     void serialize(const std::filesystem::path& output, ErrorQueue& errors);
+    /// <summary>
+    /// Builds the minimal perfect hash of SECTION_SIGNATURE_INDEX over the signatures in m_FunctionTable
+    /// </summary>
+    /// <param name="seeds"> Filled with a seed per bucket </param>
+    /// <param name="slots"> Filled with the function table index of every slot </param>
+    /// <returns> Returns false if some bucket has no seed that fits, which takes two signatures with the same 64 bit hash </returns>
+    bool build_signature_hash(std::vector<uint32_t>& seeds, std::vector<uint32_t>& slots) const;
+
+    bool m_ExternalCalls = false;
 
     std::unordered_set<std::string> m_StringLiterals;
     std::unordered_map<std::filesystem::path, std::unordered_map<std::string, uint32_t>> m_OldIndex;
@@ -29,6 +54,25 @@ namespace Cryo::Linker {
 
     std::unordered_map<std::filesystem::path, std::unordered_map<std::string, Assembler::Function>> m_Functions;
     std::unordered_set<std::string> m_FunctionSignatures;
+
+    // Order of the functions in the output's function table, calls inside the image are emitted as indexes into it
+    struct FunctionTableEntry
+    {
+      const std::filesystem::path* File = nullptr;
+      Assembler::Function* Function = nullptr;
+    };
+    std::vector<FunctionTableEntry> m_FunctionTable;
+    std::unordered_map<std::string, uint32_t> m_FunctionTableIndex;
+
+    struct ImportedFunction
+    {
+      std::string Library;
+      uint32_t ReturnSize = 0;
+      std::vector<uint32_t> ParameterSizes;
+    };
+    // Every function of the libraries given to link_dependencies by signature, and the ones the project calls, ordered so images are reproducible
+    std::unordered_map<std::string, ImportedFunction> m_Importable;
+    std::map<std::string, const ImportedFunction*> m_Imports;
   };
 
 }
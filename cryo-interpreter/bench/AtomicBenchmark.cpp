@@ -0,0 +1,144 @@
+#include "cryopch.h"
+#include "Benchmark.h"
+
+#include "core/CryoContext.h"
+#include "core/CryoProgram.h"
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace Cryo::Bench {
+
+  static constexpr uint32_t s_AddsPerCall = 64;
+  static constexpr uint32_t s_CallsPerThread = 4096;
+  static constexpr uint32_t s_CasPerCall = 16;
+
+  // cell_add(index) adds 1 to shared_cell(index) s_AddsPerCall times, cas_increment(index) tries to add 1 to it once with a CAS and returns 1
+  // if it did: desired - expected is 1 only when expected was left unchanged. cell_read(index) loads the cell. frame_count() does the
+  // same adds and CAS increments on a @uint32 in its own frame and returns it
+  static std::filesystem::path build_atomics()
+  {
+    BenchAssembly assembly;
+    uint32_t cell = assembly.add_string("$void*::shared_cell::uint32");
+
+    // The cell's pointer at 8, returned by shared_cell
+    const std::vector<uint32_t> get_cell = { PUSH, 8, PUSH, 4, MOVU32, 16, 4, IMPL, cell, POP, 1 };
+
+    std::vector<uint32_t> add = get_cell;
+    add.insert(add.end(), { PUSH, 4, PUSH, 4, SETU32, 16, 1 });
+    for (uint32_t i = 0; i < s_AddsPerCall; i++)
+    {
+      add.insert(add.end(), { ATOMIC_ADD, 20, 8, 16, MEMORY_ORDER_RELAXED | ATOMIC_HEAP });
+    }
+    add.insert(add.end(), { SETU32, 0, s_AddsPerCall, POP, 3, RETURN });
+    assembly.add_function("$uint32::cell_add::uint32", add, 4, { 4 });
+
+    std::vector<uint32_t> cas = get_cell;
+    cas.insert(cas.end(), { PUSH, 4, PUSH, 4, PUSH, 4, SETU32, 24, 1,
+        ATOMIC_LOAD, 16, 8, MEMORY_ORDER_RELAXED | ATOMIC_HEAP,
+        ADDU32, 20, 16, 24,
+        ATOMIC_CAS, 8, 16, 20, MEMORY_ORDER_SEQ_CST | ATOMIC_HEAP,
+        SUBU32, 0, 20, 16, POP, 4, RETURN });
+    assembly.add_function("$uint32::cas_increment::uint32", cas, 4, { 4 });
+
+    std::vector<uint32_t> read = get_cell;
+    read.insert(read.end(), { ATOMIC_LOAD, 0, 8, MEMORY_ORDER_SEQ_CST | ATOMIC_HEAP, POP, 1, RETURN });
+    assembly.add_function("$uint32::cell_read::uint32", read, 4, { 4 });
+
+    // counter at 4, one at 8, old at 12, expected at 16, desired at 20
+    std::vector<uint32_t> frame = { PUSH, 4, PUSH, 4, PUSH, 4, PUSH, 4, PUSH, 4, SETU32, 4, 0, SETU32, 8, 1 };
+    for (uint32_t i = 0; i < s_AddsPerCall; i++)
+    {
+      frame.insert(frame.end(), { ATOMIC_ADD, 12, 4, 8, MEMORY_ORDER_RELAXED });
+    }
+    for (uint32_t i = 0; i < s_CasPerCall; i++)
+    {
+      frame.insert(frame.end(), { ATOMIC_LOAD, 16, 4, MEMORY_ORDER_ACQUIRE, ADDU32, 20, 16, 8, ATOMIC_CAS, 4, 16, 20, MEMORY_ORDER_ACQ_REL });
+    }
+    frame.insert(frame.end(), { FENCE, MEMORY_ORDER_SEQ_CST, ATOMIC_LOAD, 0, 4, MEMORY_ORDER_SEQ_CST, POP, 5, RETURN });
+    assembly.add_function("$uint32::frame_count::void", frame, 4);
+
+    return assembly.write("cryo_bench_atomics");
+  }
+
+  CRYO_BENCHMARK(atomics)
+  {
+    auto program = CryoProgram::load({ build_atomics() });
+    auto cell_add = program ? program->get_function<uint32_t(uint32_t)>("cell_add") : CryoFunctionHandle<uint32_t(uint32_t)>();
+    auto cas_increment = program ? program->get_function<uint32_t(uint32_t)>("cas_increment") : CryoFunctionHandle<uint32_t(uint32_t)>();
+    auto cell_read = program ? program->get_function<uint32_t(uint32_t)>("cell_read") : CryoFunctionHandle<uint32_t(uint32_t)>();
+    auto frame_count = program ? program->get_function<uint32_t()>("frame_count") : CryoFunctionHandle<uint32_t()>();
+    if (!cell_add.is_valid() || !cas_increment.is_valid() || !cell_read.is_valid() || !frame_count.is_valid())
+    {
+      std::cout << "Failed to build the benchmark assembly!" << std::endl;
+      return;
+    }
+
+    // Every run counts on a cell of its own, so each one can check it ends at exactly what its threads added
+    uint32_t next_cell = 0;
+    CryoContext reader(program);
+    for (uint32_t threads : { 1u, 4u })
+    {
+      bool correct = true;
+      double ns = measure_ns([&]() {
+        uint32_t index = next_cell++;
+        std::vector<uint32_t> frame_counts(threads);
+        {
+          std::vector<std::jthread> workers;
+          for (uint32_t t = 0; t < threads; t++)
+          {
+            workers.emplace_back([&, t]() {
+              CryoContext context(program);
+              for (uint32_t i = 0; i < s_CallsPerThread; i++)
+              {
+                context.call(cell_add, index);
+              }
+              frame_counts[t] = context.call(frame_count).value_or(0);
+            });
+          }
+        }
+        correct &= reader.call(cell_read, index) == threads * s_CallsPerThread * s_AddsPerCall;
+        for (uint32_t count : frame_counts)
+        {
+          correct &= count == s_AddsPerCall + s_CasPerCall;
+        }
+      }, 1, 3);
+      std::printf("ATOMIC_ADD %u threads on a shared_cell %8.2f ns/add%s\n", threads, ns / (threads * s_CallsPerThread * s_AddsPerCall),
+          correct ? "" : " (wrong count!)");
+    }
+
+    // Contended CAS loops, a thread retries until s_CallsPerThread of its increments went through
+    for (uint32_t threads : { 1u, 4u })
+    {
+      bool correct = true;
+      uint64_t attempts = 0;
+      double ns = measure_ns([&]() {
+        uint32_t index = next_cell++;
+        std::vector<uint64_t> thread_attempts(threads);
+        {
+          std::vector<std::jthread> workers;
+          for (uint32_t t = 0; t < threads; t++)
+          {
+            workers.emplace_back([&, t]() {
+              CryoContext context(program);
+              for (uint32_t done = 0; done < s_CallsPerThread; thread_attempts[t]++)
+              {
+                done += context.call(cas_increment, index).value_or(0);
+              }
+            });
+          }
+        }
+        correct &= reader.call(cell_read, index) == threads * s_CallsPerThread;
+        attempts = 0;
+        for (uint64_t thread_attempt : thread_attempts)
+        {
+          attempts += thread_attempt;
+        }
+      }, 1, 3);
+      std::printf("ATOMIC_CAS %u threads on a shared_cell %8.2f ns/increment, %.2f attempts/increment%s\n", threads,
+          ns / (threads * s_CallsPerThread), double(attempts) / (threads * s_CallsPerThread), correct ? "" : " (wrong count!)");
+    }
+  }
+
+}
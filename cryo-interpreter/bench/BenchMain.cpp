@@ -0,0 +1,33 @@
+#include "cryopch.h"
+#include "Benchmark.h"
+
+#include "core/CryoEventLoop.h"
+
+#include <cstring>
+
+// Usage: cryo-bench [-e] [benchmark names...], runs every benchmark when no name is given. -e runs the event loop on epoll like cryo -e
+int main(int argc, const char* argv[])
+{
+  int first = 1;
+  if (argc > 1 && std::strcmp(argv[1], "-e") == 0)
+  {
+    Cryo::CryoEventLoop::set_preferred_backend(Cryo::IoBackend::Epoll);
+    first = 2;
+  }
+
+  for (auto& bench : Cryo::Bench::get_benchmarks())
+  {
+    bool selected = argc <= first;
+    for (int i = first; i < argc; i++)
+    {
+      selected |= std::strcmp(argv[i], bench.Name) == 0;
+    }
+    if (!selected)
+    {
+      continue;
+    }
+
+    std::cout << "=== " << bench.Name << " ===" << std::endl;
+    bench.Function();
+  }
+}
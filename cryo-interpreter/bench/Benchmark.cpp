@@ -0,0 +1,233 @@
+#include "cryopch.h"
+#include "Benchmark.h"
+
+#include "core/CryoAssembly.h"
+#include "core/CryoImage.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace Cryo::Bench {
+
+#define WRITE_BINARY(stream, x) stream.write(reinterpret_cast<const char*>(&x), sizeof(x))
+
+  uint32_t BenchAssembly::add_string(std::string_view str)
+  {
+    auto ite = std::find(m_Strings.begin(), m_Strings.end(), str);
+    if (ite != m_Strings.end())
+    {
+      return ite - m_Strings.begin();
+    }
+
+    m_Strings.emplace_back(str);
+    return m_Strings.size() - 1;
+  }
+
+  void BenchAssembly::add_function(std::string_view signature, std::vector<uint32_t> code, uint32_t return_size, std::vector<uint32_t> parameter_sizes,
+      uint32_t frame_size)
+  {
+    Function func;
+    func.Signature = add_string(signature);
+    func.Code = std::move(code);
+    func.ReturnSize = return_size;
+    func.ParameterSizes = std::move(parameter_sizes);
+    func.FrameSize = frame_size;
+    m_Functions.emplace_back(std::move(func));
+  }
+
+  void BenchAssembly::add_register_function(std::string_view signature, std::vector<uint32_t> code, uint32_t frame_size, uint32_t return_size,
+      std::vector<uint32_t> parameter_sizes)
+  {
+    add_function(signature, std::move(code), return_size, std::move(parameter_sizes), frame_size);
+    m_Functions.back().Flags = FUNCTION_REGISTER_FORMAT;
+  }
+
+  std::filesystem::path BenchAssembly::write(std::string_view name) const
+  {
+    for (auto& func : m_Functions)
+    {
+      if (func.Flags != 0)
+      {
+        throw std::logic_error("Fatal Error: v1 images can't hold register format functions!");
+      }
+    }
+
+    // Baseline v1 layout: header, string literals, function declarations and then the code
+    std::vector<uint32_t> image;
+    std::string strings = std::string("CRYOEXE", 8);
+    for (auto& str : m_Strings)
+    {
+      strings += str;
+      strings += '\0';
+    }
+    strings.append(sizeof(uint32_t) - (strings.size() % sizeof(uint32_t)), '\0');
+    image.resize(strings.size() / sizeof(uint32_t));
+    std::memcpy(image.data(), strings.data(), strings.size());
+    image.emplace_back(CRYO_BLOCK_END);
+
+    std::vector<size_t> start_slots;
+    for (auto& func : m_Functions)
+    {
+      image.emplace_back(func.Signature);
+      start_slots.emplace_back(image.size());
+      image.emplace_back(0);
+      image.emplace_back(func.Code.size());
+      image.emplace_back(func.ReturnSize);
+      image.insert(image.end(), func.ParameterSizes.begin(), func.ParameterSizes.end());
+      image.emplace_back(CRYO_BLOCK_END);
+    }
+    image.emplace_back(CRYO_BLOCK_END);
+
+    for (size_t i = 0; i < m_Functions.size(); i++)
+    {
+      image[start_slots[i]] = image.size();
+      image.insert(image.end(), m_Functions[i].Code.begin(), m_Functions[i].Code.end());
+      image.emplace_back(CRYO_BLOCK_END);
+    }
+
+    std::filesystem::path path = std::filesystem::temp_directory_path() / (std::string(name) + ".crye");
+    std::ofstream file_stream(path, std::ios::out | std::ios::binary);
+    file_stream.write(reinterpret_cast<const char*>(image.data()), image.size() * sizeof(uint32_t));
+    return path;
+  }
+
+  std::filesystem::path BenchAssembly::write_v2(std::string_view name) const
+  {
+    CryoImageHeader header;
+    std::memcpy(header.Magic, CRYO_IMAGE_MAGIC_V2, sizeof(header.Magic));
+
+    std::vector<CryoImageString> string_table;
+    std::string string_data;
+    for (auto& str : m_Strings)
+    {
+      string_table.emplace_back(CryoImageString{ (uint32_t)string_data.size(), (uint32_t)str.size() });
+      string_data += str;
+      string_data += '\0';
+    }
+    uint32_t string_data_size = string_data.size();
+    string_data.resize((string_data.size() + sizeof(uint32_t) - 1) / sizeof(uint32_t) * sizeof(uint32_t), '\0');
+
+    // A single bucket, benchmark images have few enough functions to find a seed that gives every signature a slot of its own
+    uint32_t function_count = m_Functions.size();
+    std::vector<uint32_t> signature_index(1 + function_count, 0);
+    for (uint32_t seed = 0; function_count != 0; seed++)
+    {
+      std::fill(signature_index.begin() + 1, signature_index.end(), CRYO_BLOCK_END);
+      bool placed = true;
+      for (uint32_t i = 0; i < function_count && placed; i++)
+      {
+        uint32_t slot = hash_signature_slot(hash_signature(m_Strings[m_Functions[i].Signature]), seed, function_count);
+        placed = signature_index[1 + slot] == CRYO_BLOCK_END;
+        signature_index[1 + slot] = i;
+      }
+      if (placed)
+      {
+        signature_index[0] = seed;
+        break;
+      }
+    }
+
+    std::vector<CryoImageFunction> functions;
+    std::vector<uint32_t> parameters;
+    size_t code_words = 0;
+    for (auto& func : m_Functions)
+    {
+      functions.emplace_back(CryoImageFunction{ func.Signature, 0, (uint32_t)func.Code.size(), func.ReturnSize, func.FrameSize, func.Flags,
+        (uint32_t)parameters.size(), (uint32_t)func.ParameterSizes.size() });
+      parameters.insert(parameters.end(), func.ParameterSizes.begin(), func.ParameterSizes.end());
+      code_words += func.Code.size() + 1;
+    }
+
+    auto place = [offset = (uint32_t)sizeof(CryoImageHeader)](CryoImageSection& section, size_t size, size_t count) mutable {
+      section = CryoImageSection{ offset, (uint32_t)size, (uint32_t)count };
+      offset += size;
+    };
+    place(header.Sections[SECTION_STRING_TABLE], string_table.size() * sizeof(CryoImageString), string_table.size());
+    place(header.Sections[SECTION_STRING_DATA], string_data.size(), string_data_size);
+    place(header.Sections[SECTION_SIGNATURE_INDEX], function_count != 0 ? signature_index.size() * sizeof(uint32_t) : 0, function_count != 0 ? 1 : 0);
+    place(header.Sections[SECTION_FUNCTIONS], functions.size() * sizeof(CryoImageFunction), functions.size());
+    place(header.Sections[SECTION_PARAMETERS], parameters.size() * sizeof(uint32_t), parameters.size());
+    place(header.Sections[SECTION_IMPORTS], 0, 0);
+    place(header.Sections[SECTION_CODE], code_words * sizeof(uint32_t), functions.size());
+
+    uint32_t code_start = header.Sections[SECTION_CODE].Offset / sizeof(uint32_t);
+    for (auto& record : functions)
+    {
+      record.CodeStart = code_start;
+      code_start += record.InstructionCount + 1;
+    }
+
+    std::filesystem::path path = std::filesystem::temp_directory_path() / (std::string(name) + ".crye");
+    std::ofstream file_stream(path, std::ios::out | std::ios::binary);
+    WRITE_BINARY(file_stream, header);
+    file_stream.write(reinterpret_cast<const char*>(string_table.data()), string_table.size() * sizeof(CryoImageString));
+    file_stream.write(string_data.data(), string_data.size());
+    if (function_count != 0)
+    {
+      file_stream.write(reinterpret_cast<const char*>(signature_index.data()), signature_index.size() * sizeof(uint32_t));
+    }
+    file_stream.write(reinterpret_cast<const char*>(functions.data()), functions.size() * sizeof(CryoImageFunction));
+    file_stream.write(reinterpret_cast<const char*>(parameters.data()), parameters.size() * sizeof(uint32_t));
+    for (auto& func : m_Functions)
+    {
+      file_stream.write(reinterpret_cast<const char*>(func.Code.data()), func.Code.size() * sizeof(uint32_t));
+      WRITE_BINARY(file_stream, CRYO_BLOCK_END);
+    }
+    return path;
+  }
+
+  double measure_ns(const std::function<void()>& func, uint32_t iterations, uint32_t repetitions)
+  {
+    func(); // Warm up
+
+    double best = std::numeric_limits<double>::max();
+    for (uint32_t r = 0; r < repetitions; r++)
+    {
+      auto start = std::chrono::steady_clock::now();
+      for (uint32_t i = 0; i < iterations; i++)
+      {
+        func();
+      }
+      auto end = std::chrono::steady_clock::now();
+      best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count() / iterations);
+    }
+    return best;
+  }
+
+  uint64_t count_dispatches(const CryoFunction* func)
+  {
+    uint64_t count = 0;
+    uint32_t covered = 0; // Slots left in the current superinstruction
+    for (const CryoInstruction* pc = func->Code; pc->Opcode != OP_END; pc++)
+    {
+      if (covered == 0)
+      {
+        count++;
+        covered = get_instruction_slots(pc->Opcode);
+      }
+      covered--;
+
+      // Only the first slot of a superinstruction is rewritten, a fused CALL keeps its opcode in the second slot
+      if (pc->Opcode == OP_CALL)
+      {
+        count += count_dispatches(pc->Function);
+      }
+    }
+    return count;
+  }
+
+  BenchmarkRegistrar::BenchmarkRegistrar(const char* name, void (*func)())
+  {
+    get_benchmarks().emplace_back(BenchmarkEntry{ name, func });
+  }
+
+  std::vector<BenchmarkEntry>& get_benchmarks()
+  {
+    static std::vector<BenchmarkEntry> s_Benchmarks;
+    return s_Benchmarks;
+  }
+
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "core/CryoInstructions.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Cryo::Bench {
+
+  /// <summary>
+  /// Builds small .crye images in memory so benchmarks don't depend on the compiler
+  /// </summary>
+  class BenchAssembly
+  {
+  public:
+    /// <summary>
+    /// Adds a string literal, strings are deduplicated
+    /// </summary>
+    /// <returns> Index of the string literal </returns>
+    uint32_t add_string(std::string_view str);
+
+    /// <summary>
+    /// Adds a function, v1 images don't record frame sizes so CryoVerifier measures them on load
+    /// </summary>
+    /// <param name="frame_size"> Largest size the function's stack reaches, return and parameters included. Only v2 images record it </param>
+    void add_function(std::string_view signature, std::vector<uint32_t> code, uint32_t return_size = 0, std::vector<uint32_t> parameter_sizes = {},
+        uint32_t frame_size = 0);
+
+    /// <summary>
+    /// Adds a register format function, only v2 images can hold one
+    /// </summary>
+    void add_register_function(std::string_view signature, std::vector<uint32_t> code, uint32_t frame_size, uint32_t return_size = 0,
+        std::vector<uint32_t> parameter_sizes = {});
+
+    /// <summary>
+    /// Serializes the image into the temporary directory in the baseline v1 layout
+    /// </summary>
+    /// <returns> Path of the written .crye </returns>
+    std::filesystem::path write(std::string_view name) const;
+
+    /// <summary>
+    /// Serializes the image into the temporary directory in the v2 layout the linker writes
+    /// </summary>
+    /// <returns> Path of the written .crye </returns>
+    std::filesystem::path write_v2(std::string_view name) const;
+
+  private:
+    struct Function
+    {
+      uint32_t Signature = 0;
+      std::vector<uint32_t> Code;
+      uint32_t ReturnSize = 0;
+      std::vector<uint32_t> ParameterSizes;
+      uint32_t FrameSize = 0;
+      uint32_t Flags = 0;
+    };
+
+    std::vector<std::string> m_Strings;
+    std::vector<Function> m_Functions;
+  };
+
+  /// <summary>
+  /// Runs func repeatedly and returns the best time of a single run in nanoseconds
+  /// </summary>
+  double measure_ns(const std::function<void()>& func, uint32_t iterations, uint32_t repetitions = 5);
+
+  /// <summary>
+  /// Counts the decoded instructions a call to func dispatches, callees included. Exact since Cryo code has no branches
+  /// </summary>
+  uint64_t count_dispatches(const CryoFunction* func);
+
+  struct BenchmarkEntry
+  {
+    const char* Name;
+    void (*Function)();
+  };
+
+  /// <summary>
+  /// Registers a benchmark to be run by cryo-bench, used through static initialization
+  /// </summary>
+  struct BenchmarkRegistrar
+  {
+    BenchmarkRegistrar(const char* name, void (*func)());
+  };
+
+  std::vector<BenchmarkEntry>& get_benchmarks();
+
+}
+
+#define CRYO_BENCHMARK(name) \
+  static void bench_##name(); \
+  static ::Cryo::Bench::BenchmarkRegistrar s_Registrar_##name(#name, &bench_##name); \
+  static void bench_##name()
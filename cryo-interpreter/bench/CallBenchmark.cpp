@@ -0,0 +1,52 @@
+#include "cryopch.h"
+#include "Benchmark.h"
+
+#include "core/CryoAssembly.h"
+#include "core/CryoThread.h"
+
+#include <cstdio>
+#include <string>
+
+namespace Cryo::Bench {
+
+  // main calls link_0, which calls link_1 and so on until link_{depth - 1}, every call passes a @uint32
+  static std::filesystem::path build_call_chain(uint32_t depth)
+  {
+    BenchAssembly assembly;
+    std::vector<uint32_t> links;
+    for (uint32_t i = 0; i < depth; i++)
+    {
+      links.emplace_back(assembly.add_string("$void::link_" + std::to_string(i) + "::uint32"));
+    }
+
+    for (uint32_t i = 0; i + 1 < depth; i++)
+    {
+      // link_i(uint32): PUSH 4; SETU32 4, i; CALL link_{i + 1}; POP 1; RETURN
+      assembly.add_function("$void::link_" + std::to_string(i) + "::uint32",
+          { PUSH, 4, SETU32, 4, i, CALL_from_assembly_signature, links[i + 1], POP, 1, RETURN }, 0, { 4 });
+    }
+    assembly.add_function("$void::link_" + std::to_string(depth - 1) + "::uint32", { RETURN }, 0, { 4 });
+
+    assembly.add_function("$void::main::void", { PUSH, 4, SETU32, 0, 0, CALL_from_assembly_signature, links[0], POP, 1, RETURN });
+    return assembly.write("cryo_bench_call_depth_" + std::to_string(depth));
+  }
+
+  CRYO_BENCHMARK(call_depth)
+  {
+    CryoThread thread;
+    for (uint32_t depth : { 1u, 16u, 256u, 4096u })
+    {
+      CryoAssembly assembly(build_call_chain(depth));
+      if (!assembly.is_valid())
+      {
+        std::cout << "Failed to build the benchmark assembly!" << std::endl;
+        return;
+      }
+      const CryoFunction* entry = assembly.get_function_by_signature("$void::main::void");
+
+      double ns = measure_ns([&]() { thread.execute(entry); }, 4096 / depth * 16);
+      std::printf("depth %-6u %10.1f ns/run %8.2f ns/call\n", depth, ns, ns / (depth + 1));
+    }
+  }
+
+}
@@ -0,0 +1,94 @@
+#include "cryopch.h"
+#include "Benchmark.h"
+
+#include "core/CryoChannel.h"
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace Cryo::Bench {
+
+  static constexpr uint32_t s_Messages = 1 << 20;
+  static constexpr uint32_t s_Capacity = 1024;
+
+  // Producers split 0..s_Messages between them and send it in batches of batch values, consumers receive until the channel is closed
+  static bool run_topology(ChannelKind kind, uint32_t producers, uint32_t consumers, uint32_t batch)
+  {
+    CryoChannel channel(s_Capacity, kind);
+    std::vector<uint64_t> sums(consumers);
+    {
+      std::vector<std::jthread> receivers;
+      for (uint32_t c = 0; c < consumers; c++)
+      {
+        receivers.emplace_back([&, c]() {
+          std::vector<uint32_t> values(batch);
+          while (size_t received = channel.receive(values))
+          {
+            for (size_t i = 0; i < received; i++)
+            {
+              sums[c] += values[i];
+            }
+          }
+        });
+      }
+
+      {
+        std::vector<std::jthread> senders;
+        for (uint32_t p = 0; p < producers; p++)
+        {
+          senders.emplace_back([&, p]() {
+            std::vector<uint32_t> values(batch);
+            for (uint32_t first = p * batch; first < s_Messages; first += producers * batch)
+            {
+              for (uint32_t i = 0; i < batch; i++)
+              {
+                values[i] = first + i;
+              }
+              channel.send(values);
+            }
+          });
+        }
+      }
+      channel.close();
+    }
+
+    uint64_t sum = 0;
+    for (uint64_t consumer_sum : sums)
+    {
+      sum += consumer_sum;
+    }
+    return sum == uint64_t(s_Messages) * (s_Messages - 1) / 2;
+  }
+
+  CRYO_BENCHMARK(channels)
+  {
+    struct Topology
+    {
+      const char* Name;
+      ChannelKind Kind;
+      uint32_t Producers;
+      uint32_t Consumers;
+    };
+
+    const Topology topologies[] =
+    {
+      { "1-to-1 spsc", ChannelKind::SingleProducer, 1, 1 },
+      { "1-to-1 mpmc", ChannelKind::MultiProducer, 1, 1 },
+      { "4-to-1 mpmc", ChannelKind::MultiProducer, 4, 1 },
+      { "4-to-4 mpmc", ChannelKind::MultiProducer, 4, 4 },
+    };
+
+    for (const Topology& topology : topologies)
+    {
+      for (uint32_t batch : { 1u, 64u })
+      {
+        bool correct = true;
+        double ns = measure_ns([&]() { correct &= run_topology(topology.Kind, topology.Producers, topology.Consumers, batch); }, 1, 3);
+        std::printf("%s batch %-3u %8.1f ns/message %8.2f M messages/s%s\n", topology.Name, batch, ns / s_Messages, s_Messages / ns * 1e3,
+            correct ? "" : " (wrong sum!)");
+      }
+    }
+  }
+
+}
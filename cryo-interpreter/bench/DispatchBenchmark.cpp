@@ -0,0 +1,107 @@
+#include "cryopch.h"
+#include "Benchmark.h"
+
+#include "core/CryoAssembly.h"
+#include "core/CryoThread.h"
+
+#include <cstdio>
+
+namespace Cryo::Bench {
+
+  // Call heavy workload: main calls mid 64 times, every mid calls leaf 8 times
+  static constexpr uint32_t s_MidCalls = 64;
+  static constexpr uint32_t s_LeafCalls = 8;
+
+  static std::filesystem::path build_call_workload(uint64_t& instruction_count)
+  {
+    BenchAssembly assembly;
+    uint32_t leaf = assembly.add_string("$void::leaf::uint32");
+    uint32_t mid = assembly.add_string("$void::mid::void");
+
+    // leaf(uint32): STLS; PUSH 4; SETU32 4, 1; STLE; RETURN
+    assembly.add_function("$void::leaf::uint32", { STLS, PUSH, 4, SETU32, 4, 1, STLE, RETURN }, 0, { 4 });
+
+    std::vector<uint32_t> mid_code;
+    for (uint32_t i = 0; i < s_LeafCalls; i++)
+    {
+      mid_code.insert(mid_code.end(), { PUSH, 4, SETU32, 0, i, CALL_from_assembly_signature, leaf, POP, 1 });
+    }
+    mid_code.emplace_back(RETURN);
+    assembly.add_function("$void::mid::void", mid_code);
+
+    std::vector<uint32_t> main_code;
+    for (uint32_t i = 0; i < s_MidCalls; i++)
+    {
+      main_code.insert(main_code.end(), { CALL_from_assembly_signature, mid });
+    }
+    main_code.emplace_back(RETURN);
+    assembly.add_function("$void::main::void", main_code);
+
+    instruction_count = (s_MidCalls + 1) + s_MidCalls * (s_LeafCalls * 4 + 1) + s_MidCalls * s_LeafCalls * 5;
+    return assembly.write("cryo_bench_dispatch");
+  }
+
+  CRYO_BENCHMARK(dispatch)
+  {
+    uint64_t instruction_count = 0;
+    CryoAssembly assembly(build_call_workload(instruction_count));
+    if (!assembly.is_valid())
+    {
+      std::cout << "Failed to build the benchmark assembly!" << std::endl;
+      return;
+    }
+    const CryoFunction* entry = assembly.get_function_by_signature("$void::main::void");
+
+    CryoThread thread;
+    auto run = [&](DispatchMode mode, const char* name) {
+      thread.set_dispatch_mode(mode);
+      double ns = measure_ns([&]() { thread.execute(entry); }, 200);
+      std::printf("%-10s %10.1f us/run %8.2f ns/instruction %8.1f M instructions/s\n",
+          name, ns / 1000.0, ns / instruction_count, instruction_count / ns * 1000.0);
+      return ns;
+    };
+
+    std::printf("%llu source instructions per run, verified assemblies run without the stack layout ones\n", (unsigned long long)instruction_count);
+    double switch_ns = run(DispatchMode::Switch, "switch");
+    if (CryoThread::has_threaded_dispatch())
+    {
+      double threaded_ns = run(DispatchMode::Threaded, "threaded");
+      std::printf("threaded speedup: %.2fx\n", switch_ns / threaded_ns);
+    }
+    else
+    {
+      std::printf("threaded dispatch is not available with this compiler\n");
+    }
+  }
+
+  CRYO_BENCHMARK(superinstructions)
+  {
+    uint64_t instruction_count = 0;
+    auto path = build_call_workload(instruction_count);
+
+    CryoThread thread;
+    auto run = [&](bool superinstructions, DispatchMode mode, const char* name) {
+      CryoAssembly assembly(path, { .Superinstructions = superinstructions });
+      if (!assembly.is_valid())
+      {
+        std::cout << "Failed to build the benchmark assembly!" << std::endl;
+        return;
+      }
+      const CryoFunction* entry = assembly.get_function_by_signature("$void::main::void");
+
+      thread.set_dispatch_mode(mode);
+      uint64_t dispatches = count_dispatches(entry);
+      double ns = measure_ns([&]() { thread.execute(entry); }, 200);
+      std::printf("%-20s %8llu dispatches/run %10.1f us/run %8.2f ns/dispatch\n", name, (unsigned long long)dispatches, ns / 1000.0, ns / dispatches);
+    };
+
+    run(false, DispatchMode::Switch, "switch");
+    run(true, DispatchMode::Switch, "switch, fused");
+    if (CryoThread::has_threaded_dispatch())
+    {
+      run(false, DispatchMode::Threaded, "threaded");
+      run(true, DispatchMode::Threaded, "threaded, fused");
+    }
+  }
+
+}
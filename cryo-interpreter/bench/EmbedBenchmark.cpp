@@ -0,0 +1,48 @@
+#include "cryopch.h"
+#include "Benchmark.h"
+
+#include "core/CryoContext.h"
+#include "core/CryoProgram.h"
+
+#include <cstdio>
+
+namespace Cryo::Bench {
+
+  // add(uint32, uint32): ADDU32 0, 4, 8; RETURN
+  static std::filesystem::path build_add()
+  {
+    BenchAssembly assembly;
+    assembly.add_function("$uint32::add::uint32::uint32", { ADDU32, 0, 4, 8, RETURN }, 4, { 4, 4 });
+    assembly.add_function("$void::main::void", { RETURN });
+    return assembly.write("cryo_bench_embed_add");
+  }
+
+  CRYO_BENCHMARK(embed)
+  {
+    auto program = CryoProgram::load({ build_add() });
+    if (!program)
+    {
+      std::cout << "Failed to build the benchmark assembly!" << std::endl;
+      return;
+    }
+    auto add = program->get_function<uint32_t(uint32_t, uint32_t)>("add");
+    if (!add.is_valid())
+    {
+      std::cout << "Failed to bind add!" << std::endl;
+      return;
+    }
+
+    CryoContext context(program);
+    uint32_t sum = 0;
+    double call_ns = measure_ns([&]() { sum += context.call(add, sum, 1).value_or(0); }, 1 << 16);
+    std::printf("typed call      %10.1f ns/call\n", call_ns);
+
+    double reset_ns = measure_ns([&]() { context.reset(); }, 1 << 16);
+    std::printf("context reset   %10.1f ns/reset\n", reset_ns);
+
+    // A context per job, the stack is reserved address space so this is mostly the mmap and munmap
+    double create_ns = measure_ns([&]() { CryoContext job(program); sum += job.call(add, sum, 1).value_or(0); }, 1 << 10);
+    std::printf("context per job %10.1f ns/job\n", create_ns);
+  }
+
+}
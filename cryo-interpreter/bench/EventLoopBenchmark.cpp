@@ -0,0 +1,243 @@
+#include "cryopch.h"
+#include "Benchmark.h"
+
+#include "core/CryoContext.h"
+#include "core/CryoEventLoop.h"
+#include "core/CryoProgram.h"
+#include "core/CryoThread.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#if CRYO_ASYNC_IO
+  #include <fcntl.h>
+  #include <netinet/in.h>
+  #include <sys/socket.h>
+  #include <unistd.h>
+#endif
+
+namespace Cryo::Bench {
+
+  static constexpr uint32_t s_SleepMilliseconds = 10;
+
+  // fan(uint32) spawns nap(i) as a fiber for every i below fibers and awaits all of them. nap sleeps s_SleepMilliseconds through io_sleep,
+  // so a run takes about one sleep however many fibers there are as long as their sleeps overlap
+  static std::filesystem::path build_sleep_fan_out(uint32_t fibers)
+  {
+    BenchAssembly assembly;
+    uint32_t spawn = assembly.add_string("$uint32::fiber_spawn::void*::uint32");
+    uint32_t await = assembly.add_string("$uint32::fiber_await::uint32");
+    uint32_t sleep = assembly.add_string("$void::io_sleep::uint32");
+    uint32_t nap = assembly.add_string("$uint32::nap::uint32");
+
+    assembly.add_function("$uint32::nap::uint32", { PUSH, 4, SETU32, 8, s_SleepMilliseconds, IMPL, sleep, POP, 1, MOVU32, 0, 4, RETURN }, 4, { 4 });
+
+    std::vector<uint32_t> code;
+    for (uint32_t i = 0; i < fibers; i++)
+    {
+      uint32_t handle = 8 + 4 * i;
+      code.insert(code.end(), { PUSH, 4, PUSH, 8, PUSH, 4, SETSTR, handle + 4, nap, SETU32, handle + 12, i, IMPL, spawn, POP, 2 });
+    }
+    uint32_t result = 8 + 4 * fibers;
+    for (uint32_t i = 0; i < fibers; i++)
+    {
+      code.insert(code.end(), { PUSH, 4, PUSH, 4, MOVU32, result + 4, 8 + 4 * i, IMPL, await, POP, 2 });
+    }
+    code.insert(code.end(), { SETU32, 0, fibers, RETURN });
+    assembly.add_function("$uint32::fan::uint32", code, 4, { 4 });
+
+    return assembly.write("cryo_bench_sleep_" + std::to_string(fibers));
+  }
+
+  CRYO_BENCHMARK(event_loop)
+  {
+    for (uint32_t fibers : { 1u, 256u, 4096u })
+    {
+      auto program = CryoProgram::load({ build_sleep_fan_out(fibers) });
+      auto fan = program ? program->get_function<uint32_t(uint32_t)>("fan") : CryoFunctionHandle<uint32_t(uint32_t)>();
+      if (!fan.is_valid())
+      {
+        std::cout << "Failed to build the benchmark assembly!" << std::endl;
+        return;
+      }
+
+      CryoContext context(program);
+      bool correct = true;
+      double ns = measure_ns([&]() { correct &= context.call(fan, 0) == fibers; }, 4, 3);
+      std::printf("%-5u sleeping fibers %10.2f ms/run (%ums sleeps, %s)%s\n", fibers, ns / 1e6, s_SleepMilliseconds,
+          CryoEventLoop::get().get_backend_name(), correct ? "" : " (wrong result!)");
+    }
+  }
+
+#if CRYO_ASYNC_IO
+  static constexpr uint32_t s_TransferSize = 1024 * 1024;
+  static constexpr uint32_t s_RoundTrips = 1000;
+
+  // Runs an operation the way an IMPL on a thread that isn't a fiber does, blocking until the loop completes it
+  static IoCall perform(CryoThread& thread, IoOperation operation, int fd, const char* buffer = nullptr, uint32_t size = 0, uint64_t nanoseconds = 0)
+  {
+    return CryoEventLoop::get().perform(thread, operation, fd, const_cast<char*>(buffer), size, nanoseconds);
+  }
+
+  // Writes all of data, the loop may complete a write with fewer bytes than asked
+  static bool write_all(CryoThread& thread, int fd, std::string_view data)
+  {
+    while (!data.empty())
+    {
+      IoCall call = perform(thread, IoOperation::Write, fd, data.data(), (uint32_t)data.size());
+      if (call.Result <= 0)
+      {
+        return false;
+      }
+      data.remove_prefix((size_t)call.Result);
+    }
+    return true;
+  }
+
+  // Reads until the end of the file or until size bytes came in, checking every byte is fill
+  static uint64_t read_all(CryoThread& thread, int fd, uint64_t size, char fill)
+  {
+    uint64_t total = 0;
+    while (total < size)
+    {
+      IoCall call = perform(thread, IoOperation::Read, fd, nullptr, 64 * 1024);
+      bool valid = call.Result > 0 && std::all_of(call.Buffer, call.Buffer + call.Result, [&](char c) { return c == fill; });
+      delete[] call.Buffer;
+      if (!valid)
+      {
+        break;
+      }
+      total += (uint64_t)call.Result;
+    }
+    return total;
+  }
+
+  static const char* describe(int64_t result)
+  {
+    return result < 0 ? std::strerror((int)-result) : "no error";
+  }
+
+  // Reads, writes and accepts on a regular file, a pipe and loopback sockets through the loop, run it with -e for the epoll backend
+  CRYO_BENCHMARK(event_loop_io)
+  {
+    const char* backend = CryoEventLoop::get().get_backend_name();
+    CryoThread thread;
+    const std::string data(s_TransferSize, 'c');
+
+    // Regular files are never polled, epoll runs them on the loop thread right away
+    std::string path = (std::filesystem::temp_directory_path() / "cryo_bench_io_file").string();
+    bool file_correct = true;
+    double file_ns = measure_ns([&]()
+    {
+      int fd = CryoEventLoop::open_file(path.c_str(), 1);
+      for (size_t offset = 0; offset < data.size(); offset += 4096)
+      {
+        file_correct &= write_all(thread, fd, std::string_view(data).substr(offset, 4096));
+      }
+      CryoEventLoop::close_fd(fd);
+
+      fd = CryoEventLoop::open_file(path.c_str(), 0);
+      file_correct &= read_all(thread, fd, UINT64_MAX, 'c') == s_TransferSize;
+      CryoEventLoop::close_fd(fd);
+    }, 4, 3);
+    std::printf("file   1 MB written in 4 KB, read in 64 KB %10.2f ms (%s)%s\n", file_ns / 1e6, backend, file_correct ? "" : " (wrong data!)");
+
+    // A read asking for more than the loop allocates for is cut to s_MaxReadSize instead of overflowing its buffer
+    int fd = CryoEventLoop::open_file(path.c_str(), 0);
+    IoCall huge = perform(thread, IoOperation::Read, fd, nullptr, UINT32_MAX);
+    delete[] huge.Buffer;
+    CryoEventLoop::close_fd(fd);
+    std::filesystem::remove(path);
+    std::printf("file   read of UINT32_MAX bytes returned %lld%s\n", (long long)huge.Result, huge.Result == s_TransferSize ? "" : " (wrong size!)");
+
+    // The writer fills the pipe and waits on the loop while a sleep on the same loop must still end on time, the reader then drains it
+    int pipe_fds[2];
+    if (pipe2(pipe_fds, O_CLOEXEC) < 0)
+    {
+      std::cout << "Failed to create a pipe!" << std::endl;
+      return;
+    }
+    bool pipe_written = false;
+    auto start = std::chrono::steady_clock::now();
+    std::thread writer([&]()
+    {
+      CryoThread writer_thread;
+      pipe_written = write_all(writer_thread, pipe_fds[1], data);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    auto sleep_start = std::chrono::steady_clock::now();
+    perform(thread, IoOperation::Sleep, -1, nullptr, 0, 1000000);
+    double sleep_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sleep_start).count();
+    uint64_t piped = read_all(thread, pipe_fds[0], s_TransferSize, 'c');
+    writer.join();
+    double pipe_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::printf("pipe   1 MB through a 64 KB pipe %10.2f ms, 1 ms sleep while it was full took %.2f ms (%s)%s\n", pipe_ms, sleep_ms, backend,
+        pipe_written && piped == s_TransferSize ? "" : " (wrong data!)");
+
+    // A reader that's gone fails the write with EPIPE, the loop thread must not be killed by SIGPIPE
+    CryoEventLoop::close_fd(pipe_fds[0]);
+    IoCall broken_pipe = perform(thread, IoOperation::Write, pipe_fds[1], "x", 1);
+    CryoEventLoop::close_fd(pipe_fds[1]);
+    std::printf("pipe   write without a reader: %s%s\n", describe(broken_pipe.Result), broken_pipe.Result == -EPIPE ? "" : " (expected EPIPE!)");
+
+    int listener = CryoEventLoop::listen_loopback(0);
+    sockaddr_in address = {};
+    socklen_t length = sizeof(address);
+    if (listener < 0 || getsockname(listener, (sockaddr*)&address, &length) < 0)
+    {
+      std::cout << "Failed to listen on the loopback!" << std::endl;
+      return;
+    }
+
+    int client = -1;
+    std::thread connector([&]() { client = CryoEventLoop::connect_loopback(ntohs(address.sin_port)); });
+    IoCall accepted = perform(thread, IoOperation::Accept, listener);
+    connector.join();
+    CryoEventLoop::close_fd(listener);
+    if (accepted.Result < 0 || client < 0)
+    {
+      std::printf("socket accept failed: %s\n", describe(accepted.Result));
+      return;
+    }
+    int server = (int)accepted.Result;
+
+    // Both ends run on threads waiting on the loop, each round trip is two writes and two reads
+    bool socket_correct = true;
+    std::thread echo([&]()
+    {
+      CryoThread echo_thread;
+      for (uint32_t i = 0; i < s_RoundTrips; i++)
+      {
+        socket_correct &= read_all(echo_thread, server, 4, 'p') == 4 && write_all(echo_thread, server, "qqqq");
+      }
+    });
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < s_RoundTrips; i++)
+    {
+      socket_correct &= write_all(thread, client, "pppp") && read_all(thread, client, 4, 'q') == 4;
+    }
+    double round_trip_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / s_RoundTrips;
+    echo.join();
+    std::printf("socket accept, then %u round trips %10.1f us/round trip (%s)%s\n", s_RoundTrips, round_trip_ns / 1e3, backend,
+        socket_correct ? "" : " (wrong data!)");
+
+    // The peer is gone, the first write may still be accepted before its reset arrives
+    CryoEventLoop::close_fd(client);
+    IoCall reset = {};
+    for (uint32_t i = 0; i < 8 && reset.Result >= 0; i++)
+    {
+      reset = perform(thread, IoOperation::Write, server, "x", 1);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CryoEventLoop::close_fd(server);
+    std::printf("socket write to a closed peer: %s%s\n", describe(reset.Result),
+        reset.Result == -EPIPE || reset.Result == -ECONNRESET ? "" : " (expected EPIPE or ECONNRESET!)");
+  }
+#endif
+
+}
@@ -0,0 +1,132 @@
+#include "cryopch.h"
+#include "Benchmark.h"
+
+#include "core/CryoContext.h"
+#include "core/CryoProgram.h"
+
+#include <cstdio>
+#include <string>
+#include <tuple>
+
+#ifndef _WIN32
+  #include <sys/resource.h>
+#endif
+
+namespace Cryo::Bench {
+
+  // fan(uint32) spawns work(i) as a fiber for every i below fibers, then awaits all of them and returns the sum of their returns.
+  // work(n) yields once and returns n + n, so every fiber is suspended and resumed at least once
+  static std::filesystem::path build_fan_out(uint32_t fibers)
+  {
+    BenchAssembly assembly;
+    uint32_t spawn = assembly.add_string("$uint32::fiber_spawn::void*::uint32");
+    uint32_t await = assembly.add_string("$uint32::fiber_await::uint32");
+    uint32_t yield = assembly.add_string("$void::fiber_yield::void");
+    uint32_t work = assembly.add_string("$uint32::work::uint32");
+
+    assembly.add_function("$uint32::work::uint32", { IMPL, yield, ADDU32, 0, 4, 4, RETURN }, 4, { 4 });
+
+    // Frame: return, parameter, one handle per fiber, then the frame of the IMPL being called
+    std::vector<uint32_t> code = { SETU32, 0, 0 };
+    for (uint32_t i = 0; i < fibers; i++)
+    {
+      uint32_t handle = 8 + 4 * i;
+      code.insert(code.end(), { PUSH, 4, PUSH, 8, PUSH, 4, SETSTR, handle + 4, work, SETU32, handle + 12, i, IMPL, spawn, POP, 2 });
+    }
+    uint32_t result = 8 + 4 * fibers;
+    for (uint32_t i = 0; i < fibers; i++)
+    {
+      code.insert(code.end(), { PUSH, 4, PUSH, 4, MOVU32, result + 4, 8 + 4 * i, IMPL, await, ADDU32, 0, 0, result, POP, 2 });
+    }
+    code.emplace_back(RETURN);
+    assembly.add_function("$uint32::fan::uint32", code, 4, { 4 });
+
+    return assembly.write("cryo_bench_fibers_" + std::to_string(fibers));
+  }
+
+  // churn(uint32) spawns work(i) and awaits it right away for every i below fibers, so a single execution goes through all of them
+  // with one alive at a time. Detached fibers are spawned the same way and released as they end without being awaited
+  static std::filesystem::path build_churn(uint32_t fibers)
+  {
+    BenchAssembly assembly;
+    uint32_t spawn = assembly.add_string("$uint32::fiber_spawn::void*::uint32");
+    uint32_t await = assembly.add_string("$uint32::fiber_await::uint32");
+    uint32_t detach = assembly.add_string("$void::fiber_detach::uint32");
+    uint32_t yield = assembly.add_string("$void::fiber_yield::void");
+    uint32_t work = assembly.add_string("$uint32::work::uint32");
+
+    assembly.add_function("$uint32::work::uint32", { IMPL, yield, ADDU32, 0, 4, 4, RETURN }, 4, { 4 });
+
+    // Frame: return, parameter, the handle, then the frame of the IMPL being called
+    std::vector<uint32_t> churn = { SETU32, 0, 0, PUSH, 4 };
+    std::vector<uint32_t> detached = { SETU32, 0, 0, PUSH, 4 };
+    for (uint32_t i = 0; i < fibers; i++)
+    {
+      const std::initializer_list<uint32_t> spawn_code = { PUSH, 4, PUSH, 8, PUSH, 4, SETSTR, 16, work, SETU32, 24, i, IMPL, spawn, MOVU32, 8, 12, POP, 3 };
+      churn.insert(churn.end(), spawn_code);
+      churn.insert(churn.end(), { PUSH, 4, PUSH, 4, MOVU32, 16, 8, IMPL, await, ADDU32, 0, 0, 12, POP, 2 });
+      detached.insert(detached.end(), spawn_code);
+      detached.insert(detached.end(), { PUSH, 4, MOVU32, 12, 8, IMPL, detach, POP, 1, IMPL, yield });
+    }
+    churn.insert(churn.end(), { POP, 1, RETURN });
+    detached.insert(detached.end(), { POP, 1, RETURN });
+    assembly.add_function("$uint32::churn::uint32", churn, 4, { 4 });
+    assembly.add_function("$uint32::detached::uint32", detached, 4, { 4 });
+
+    return assembly.write("cryo_bench_fiber_churn");
+  }
+
+  static long get_peak_rss_kb()
+  {
+#ifndef _WIN32
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+#else
+    return 0;
+#endif
+  }
+
+  CRYO_BENCHMARK(fibers)
+  {
+    // Awaited and detached fibers are released as the execution goes, so its memory stays flat however many it spawns. Runs first,
+    // before the fan outs raise the peak
+    constexpr uint32_t s_ChurnFibers = 65536;
+    auto churn_program = CryoProgram::load({ build_churn(s_ChurnFibers) });
+    auto churn = churn_program ? churn_program->get_function<uint32_t(uint32_t)>("churn") : CryoFunctionHandle<uint32_t(uint32_t)>();
+    auto detached = churn_program ? churn_program->get_function<uint32_t(uint32_t)>("detached") : CryoFunctionHandle<uint32_t(uint32_t)>();
+    if (!churn.is_valid() || !detached.is_valid())
+    {
+      std::cout << "Failed to build the benchmark assembly!" << std::endl;
+      return;
+    }
+
+    CryoContext churn_context(churn_program);
+    for (auto [name, function, expected] : { std::tuple(" awaited", churn, s_ChurnFibers * (s_ChurnFibers - 1)), std::tuple("detached", detached, 0u) })
+    {
+      long rss = get_peak_rss_kb();
+      bool correct = true;
+      double ns = measure_ns([&]() { correct &= churn_context.call(function, 0) == expected; }, 1, 1);
+      std::printf("%u %s fibers in one execution %8.1f ns/fiber, peak RSS grew %ld KB%s\n", s_ChurnFibers, name, ns / s_ChurnFibers,
+          get_peak_rss_kb() - rss, correct ? "" : " (wrong result!)");
+    }
+
+    for (uint32_t fibers : { 16u, 1024u, 16384u })
+    {
+      auto program = CryoProgram::load({ build_fan_out(fibers) });
+      auto fan = program ? program->get_function<uint32_t(uint32_t)>("fan") : CryoFunctionHandle<uint32_t(uint32_t)>();
+      if (!fan.is_valid())
+      {
+        std::cout << "Failed to build the benchmark assembly!" << std::endl;
+        return;
+      }
+
+      CryoContext context(program);
+      uint32_t expected = fibers * (fibers - 1);
+      bool correct = true;
+      double ns = measure_ns([&]() { correct &= context.call(fan, 0) == expected; }, fibers >= 16384 ? 1 : 16, 3);
+      std::printf("%-6u fibers %12.1f ns/run %8.1f ns/fiber%s\n", fibers, ns, ns / fibers, correct ? "" : " (wrong result!)");
+    }
+  }
+
+}
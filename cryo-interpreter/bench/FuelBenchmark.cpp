@@ -0,0 +1,75 @@
+#include "cryopch.h"
+#include "Benchmark.h"
+
+#include "core/CryoAssembly.h"
+#include "core/CryoThread.h"
+
+#include <cstdio>
+#include <string>
+
+namespace Cryo::Bench {
+
+  static constexpr uint32_t s_Depth = 256;
+
+  // Same chain as call_depth: main calls link_0, which calls link_1 and so on, every call is a fuel safepoint
+  static std::filesystem::path build_fuel_chain()
+  {
+    BenchAssembly assembly;
+    std::vector<uint32_t> links;
+    for (uint32_t i = 0; i < s_Depth; i++)
+    {
+      links.emplace_back(assembly.add_string("$void::link_" + std::to_string(i) + "::uint32"));
+    }
+
+    for (uint32_t i = 0; i + 1 < s_Depth; i++)
+    {
+      assembly.add_function("$void::link_" + std::to_string(i) + "::uint32",
+          { PUSH, 4, SETU32, 4, i, CALL_from_assembly_signature, links[i + 1], POP, 1, RETURN }, 0, { 4 });
+    }
+    assembly.add_function("$void::link_" + std::to_string(s_Depth - 1) + "::uint32", { RETURN }, 0, { 4 });
+
+    assembly.add_function("$void::main::void", { PUSH, 4, SETU32, 0, 0, CALL_from_assembly_signature, links[0], POP, 1, RETURN });
+    return assembly.write("cryo_bench_fuel");
+  }
+
+  CRYO_BENCHMARK(fuel)
+  {
+    CryoAssembly assembly(build_fuel_chain());
+    if (!assembly.is_valid())
+    {
+      std::cout << "Failed to build the benchmark assembly!" << std::endl;
+      return;
+    }
+    const CryoFunction* entry = assembly.get_function_by_signature("$void::main::void");
+
+    struct Limits
+    {
+      const char* Name;
+      uint64_t Slice;
+      uint64_t Budget;
+    };
+
+    // Slices yield the native thread, which costs a syscall, so the small one shows the price of preempting often
+    const Limits limits[] =
+    {
+      { "unlimited", 0, 0 },
+      { "budget", 0, UINT32_MAX },
+      { "slice 65536", 65536, 0 },
+      { "slice 256", 256, 0 },
+    };
+
+    CryoThread thread;
+    for (const Limits& limit : limits)
+    {
+      thread.set_fuel(limit.Slice, limit.Budget);
+      double ns = measure_ns([&]() { thread.execute(entry); }, 256);
+      std::printf("%-12s %10.1f ns/run %8.2f ns/call %8llu fuel/run\n", limit.Name, ns, ns / (s_Depth + 1), (unsigned long long)thread.get_fuel_used());
+    }
+
+    // A budget smaller than the chain stops it part way, at the first call past it
+    thread.set_fuel(0, 64);
+    bool returned = thread.execute(entry);
+    std::printf("budget 64    %s after %llu fuel\n", !returned && thread.exceeded_budget() ? "stopped" : "NOT STOPPED", (unsigned long long)thread.get_fuel_used());
+  }
+
+}
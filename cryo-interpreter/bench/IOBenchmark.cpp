@@ -0,0 +1,73 @@
+#include "cryopch.h"
+#include "Benchmark.h"
+
+#include "core/CryoAssembly.h"
+#include "core/CryoIO.h"
+#include "core/CryoThread.h"
+
+#include <cstdio>
+
+#ifndef _WIN32
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+namespace Cryo::Bench {
+
+  static constexpr uint32_t s_Lines = 1024;
+
+  // main prints "cryo bench output line" s_Lines times through println_str
+  static std::filesystem::path build_println_workload()
+  {
+    BenchAssembly assembly;
+    uint32_t println = assembly.add_string("$void::println_str::void*");
+    uint32_t line = assembly.add_string("cryo bench output line");
+
+    std::vector<uint32_t> main_code;
+    for (uint32_t i = 0; i < s_Lines; i++)
+    {
+      main_code.insert(main_code.end(), { PUSH, 8, SETSTR, 0, line, IMPL, println, POP, 1 });
+    }
+    main_code.emplace_back(RETURN);
+    assembly.add_function("$void::main::void", main_code);
+
+    return assembly.write("cryo_bench_println");
+  }
+
+  CRYO_BENCHMARK(println)
+  {
+#ifdef _WIN32
+    std::printf("needs stdout redirection, only available on POSIX\n");
+#else
+    CryoAssembly assembly(build_println_workload());
+    if (!assembly.is_valid())
+    {
+      std::cout << "Failed to build the benchmark assembly!" << std::endl;
+      return;
+    }
+    const CryoFunction* entry = assembly.get_function_by_signature("$void::main::void");
+
+    // The program's output goes to /dev/null while measuring, the cost left is the buffering and the syscalls
+    std::fflush(stdout);
+    int saved_stdout = dup(1);
+    int null_fd = open("/dev/null", O_WRONLY);
+
+    CryoThread thread;
+    double results[2];
+    for (BufferMode mode : { BufferMode::Line, BufferMode::Full })
+    {
+      dup2(null_fd, 1);
+      CryoIO::set_buffer_mode(mode);
+      results[(int)mode] = measure_ns([&]() { thread.execute(entry); CryoIO::flush(); }, 100);
+      dup2(saved_stdout, 1);
+    }
+    CryoIO::set_buffer_mode(BufferMode::Line);
+    close(null_fd);
+    close(saved_stdout);
+
+    std::printf("line buffered  %10.1f us/run %8.2f ns/line\n", results[0] / 1000.0, results[0] / s_Lines);
+    std::printf("fully buffered %10.1f us/run %8.2f ns/line\n", results[1] / 1000.0, results[1] / s_Lines);
+#endif
+  }
+
+}
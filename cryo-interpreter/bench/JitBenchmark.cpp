@@ -0,0 +1,66 @@
+#include "cryopch.h"
+#include "Benchmark.h"
+
+#include "core/CryoAssembly.h"
+#include "core/CryoThread.h"
+
+#include <cstdio>
+
+namespace Cryo::Bench {
+
+  // main calls poly(i) s_PolyCalls times, poly(x) returns x * x * 3 + x * 5 - 7 and is the only function the JIT compiles
+  static constexpr uint32_t s_PolyCalls = 256;
+
+  static std::filesystem::path build_poly_workload()
+  {
+    BenchAssembly assembly;
+    uint32_t poly = assembly.add_string("$uint32::poly::uint32");
+
+    // Variables of poly: $return at 0, $x at 4, $t at 8, $u at 12 and $c at 16
+    assembly.add_function("$uint32::poly::uint32", {
+        STLS, PUSH, 4, PUSH, 4, PUSH, 4,
+        MULU32, 8, 4, 4, SETU32, 16, 3, MULU32, 8, 8, 16,
+        SETU32, 16, 5, MULU32, 12, 4, 16, ADDU32, 8, 8, 12,
+        SETU32, 16, 7, SUBU32, 0, 8, 16, STLE, RETURN }, 4, { 4 });
+
+    // main keeps $acc at 0 and pushes every call's $return and $x on top of it
+    std::vector<uint32_t> main_code = { PUSH, 4, SETU32, 0, 0 };
+    for (uint32_t i = 0; i < s_PolyCalls; i++)
+    {
+      main_code.insert(main_code.end(), { PUSH, 4, PUSH, 4, SETU32, 8, i, CALL_from_assembly_signature, poly, ADDU32, 0, 0, 4, POP, 2 });
+    }
+    main_code.insert(main_code.end(), { POP, 1, RETURN });
+    assembly.add_function("$void::main::void", main_code);
+
+    return assembly.write("cryo_bench_jit");
+  }
+
+  CRYO_BENCHMARK(jit)
+  {
+    if (!CryoThread::has_jit())
+    {
+      std::printf("the JIT is not available on this platform\n");
+      return;
+    }
+
+    auto path = build_poly_workload();
+    auto run = [&](uint32_t threshold, const char* name) {
+      CryoAssembly assembly(path);
+      if (!assembly.is_valid())
+      {
+        std::cout << "Failed to build the benchmark assembly!" << std::endl;
+        return;
+      }
+      const CryoFunction* entry = assembly.get_function_by_signature("$void::main::void");
+
+      CryoThread thread;
+      thread.set_jit_threshold(threshold);
+      double ns = measure_ns([&]() { thread.execute(entry); }, 1000);
+      std::printf("%-12s %10.1f us/run %8.2f ns/call\n", name, ns / 1000.0, ns / s_PolyCalls);
+    };
+
+    run(0, "interpreted");
+    run(1, "jit");
+  }
+
+}
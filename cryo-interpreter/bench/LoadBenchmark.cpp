@@ -0,0 +1,66 @@
+#include "cryopch.h"
+#include "Benchmark.h"
+
+#include "core/CryoAssembly.h"
+
+#include <cstdio>
+#include <string>
+
+namespace Cryo::Bench {
+
+  // s_Functions functions named fn_0 to fn_{s_Functions - 1}, each sets its $return s_SetsPerFunction times
+  static constexpr uint32_t s_Functions = 4096;
+  static constexpr uint32_t s_SetsPerFunction = 32;
+
+  static std::filesystem::path build_large_assembly()
+  {
+    BenchAssembly assembly;
+    std::vector<uint32_t> code;
+    for (uint32_t i = 0; i < s_SetsPerFunction; i++)
+    {
+      code.insert(code.end(), { SETU32, 0, i });
+    }
+    code.emplace_back(RETURN);
+
+    for (uint32_t i = 0; i < s_Functions; i++)
+    {
+      assembly.add_function("$uint32::fn_" + std::to_string(i) + "::void", code, 4);
+    }
+    assembly.add_function("$void::main::void", { RETURN });
+
+    return assembly.write("cryo_bench_load");
+  }
+
+  CRYO_BENCHMARK(load)
+  {
+    auto path = build_large_assembly();
+    std::printf("%ju KB image, %u functions\n", (uintmax_t)std::filesystem::file_size(path) / 1024, s_Functions + 1);
+
+    double ns = measure_ns([&]() {
+      CryoAssembly assembly(path);
+      if (!assembly.is_valid())
+      {
+        std::cout << "Failed to build the benchmark assembly!" << std::endl;
+      }
+    }, 20);
+    std::printf("load           %10.1f us/load\n", ns / 1000.0);
+
+    CryoAssembly assembly(path);
+    std::vector<std::string> signatures;
+    for (uint32_t i = 0; i < s_Functions; i += 7)
+    {
+      signatures.emplace_back("$uint32::fn_" + std::to_string(i) + "::void");
+    }
+    ns = measure_ns([&]() {
+      for (const auto& signature : signatures)
+      {
+        if (!assembly.get_function_by_signature(signature))
+        {
+          std::cout << "Missing function " << signature << std::endl;
+        }
+      }
+    }, 100);
+    std::printf("lookup         %10.1f ns/lookup\n", ns / signatures.size());
+  }
+
+}
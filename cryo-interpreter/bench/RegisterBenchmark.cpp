@@ -0,0 +1,82 @@
+#include "cryopch.h"
+#include "Benchmark.h"
+
+#include "core/CryoAssembly.h"
+#include "core/CryoThread.h"
+
+#include <cstdio>
+
+namespace Cryo::Bench {
+
+  // main adds up step(i, 3) for every i below s_StepCalls, step(a, b) returns a * b + a
+  static constexpr uint32_t s_StepCalls = 4096;
+
+  // Variables of step: $return at 0, $a at 4, $b at 8 and $t at 12. main keeps $acc at 0 and builds every call's frame on top of it
+  static std::filesystem::path build_stack_format()
+  {
+    BenchAssembly assembly;
+    uint32_t step = assembly.add_string("$uint32::step::uint32::uint32");
+
+    // step: STLS; PUSH 4; MULU32 12, 4, 8; ADDU32 0, 12, 4; STLE; RETURN
+    assembly.add_function("$uint32::step::uint32::uint32", { STLS, PUSH, 4, MULU32, 12, 4, 8, ADDU32, 0, 12, 4, STLE, RETURN }, 4, { 4, 4 }, 16);
+
+    std::vector<uint32_t> main_code = { PUSH, 4, SETU32, 0, 0 };
+    for (uint32_t i = 0; i < s_StepCalls; i++)
+    {
+      main_code.insert(main_code.end(), { PUSH, 4, PUSH, 4, PUSH, 4, SETU32, 8, i, SETU32, 12, 3, CALL_from_assembly_signature, step, ADDU32, 0, 0, 4, POP, 3 });
+    }
+    main_code.insert(main_code.end(), { POP, 1, RETURN });
+    assembly.add_function("$void::main::void", main_code, 0, {}, 16);
+
+    return assembly.write_v2("cryo_bench_stack_format");
+  }
+
+  static std::filesystem::path build_register_format()
+  {
+    BenchAssembly assembly;
+    uint32_t step = assembly.add_string("$uint32::step::uint32::uint32");
+
+    // step: MULU32 12, 4, 8; ADDU32 0, 12, 4; RETURN
+    assembly.add_register_function("$uint32::step::uint32::uint32", { MULU32, 12, 4, 8, ADDU32, 0, 12, 4, RETURN }, 16, 4, { 4, 4 });
+
+    std::vector<uint32_t> main_code = { SETU32, 0, 0 };
+    for (uint32_t i = 0; i < s_StepCalls; i++)
+    {
+      main_code.insert(main_code.end(), { SETU32, 8, i, SETU32, 12, 3, CALLR_from_assembly_signature, step, 4, ADDU32, 0, 0, 4 });
+    }
+    main_code.emplace_back(RETURN);
+    assembly.add_register_function("$void::main::void", main_code, 16);
+
+    return assembly.write_v2("cryo_bench_register_format");
+  }
+
+  CRYO_BENCHMARK(register_format)
+  {
+    auto stack_path = build_stack_format();
+    auto register_path = build_register_format();
+
+    // Verified stack code is compacted on load to the static frame stream register code decodes to, so the two only differ before it runs
+    CryoThread thread;
+    auto run = [&](const std::filesystem::path& path, bool verify, const char* name) {
+      double load_ns = measure_ns([&]() { CryoAssembly assembly(path, { .Verify = verify }); }, 20);
+      CryoAssembly assembly(path, { .Verify = verify });
+      if (!assembly.is_valid())
+      {
+        std::cout << "Failed to build the benchmark assembly!" << std::endl;
+        return;
+      }
+      const CryoFunction* entry = assembly.get_function_by_signature("$void::main::void");
+
+      uint64_t dispatches = count_dispatches(entry);
+      double ns = measure_ns([&]() { thread.execute(entry); }, 50);
+      std::printf("%-16s %4ju KB image %8.1f us/load %8llu dispatches/run %8.1f us/run %6.2f ns/dispatch %6.1f M steps/s\n",
+          name, (uintmax_t)std::filesystem::file_size(path) / 1024, load_ns / 1000.0, (unsigned long long)dispatches, ns / 1000.0,
+          ns / dispatches, s_StepCalls / ns * 1000.0);
+    };
+
+    run(stack_path, false, "stack, checked");
+    run(stack_path, true, "stack, verified");
+    run(register_path, true, "register");
+  }
+
+}
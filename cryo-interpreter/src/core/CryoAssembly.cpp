@@ -1,12 +1,26 @@
 #include "cryopch.h"
 #include "CryoAssembly.h"
 
+#include "CryoImage.h"
+#include "CryoJit.h"
+#include "CryoSymbolTable.h"
+#include "CryoThread.h"
+#include "CryoVerifier.h"
+
+#include <cstring>
 #include <ostream>
 
+#ifndef _WIN32
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
 namespace Cryo {
 
-	CryoAssembly::CryoAssembly(const std::filesystem::path& path)
-		: m_AssemblyPath(path)
+	CryoAssembly::CryoAssembly(const std::filesystem::path& path, const CryoLoadOptions& options)
+		: m_AssemblyPath(path), m_Options(options)
 	{
 		uint16_t failed = false;
 		failed |= (!std::filesystem::exists(m_AssemblyPath)) << 0;
@@ -32,41 +46,455 @@ namespace Cryo {
 			return;
 		}
 
-		size_t file_size = std::filesystem::file_size(m_AssemblyPath);
+		size_t file_size = 0;
+		if (!map_file(file_size))
+		{
+			return;
+		}
 		if (file_size < 12) // 12 bytes is the current minimum for a valid assembly
 		{
 			std::cout << "CryoAssembly at [" << m_AssemblyPath.string() << "] does not meet the minimun size of 12 bytes!" << std::endl;
+			release_buffer();
 			return;
 		}
 
-		m_AssemblyBuffer = (uint32_t*)std::malloc(file_size);
-		if (m_AssemblyBuffer == nullptr)
+		// Validate file header, the v2 magic differs in its last byte so v1 only readers reject v2 images
+		size_t resident_end = 0;
+		if (std::memcmp(m_AssemblyBuffer, CRYO_IMAGE_MAGIC_V1, 8) == 0)
 		{
-			std::cout << "Failed to alllocate a buffer of size [" << file_size << "] for the CryoAssembly at [" << m_AssemblyPath.string() << "]!";
+			if (!read_v1_tables(file_size, resident_end))
+			{
+				release_buffer();
+				return;
+			}
+		}
+		else if (std::memcmp(m_AssemblyBuffer, CRYO_IMAGE_MAGIC_V2, 8) == 0)
+		{
+			if (!read_v2_tables(file_size, resident_end))
+			{
+				release_buffer();
+				return;
+			}
+		}
+		else
+		{
+			std::cout << "Failed to validate header for CryoAssembly at [" << m_AssemblyPath.string() << "]!";
+			release_buffer();
 			return;
 		}
-		
-		// Read file into the buffer
-		std::ifstream fin(m_AssemblyPath, std::ios::in | std::ios::binary);
-		fin.read((char*)m_AssemblyBuffer, file_size);
 
-		// Validate file header
-		const char* header_string = (const char*)m_AssemblyBuffer;
-		constexpr const char* expected_string = "CRYOEXE";
-		for (int i = 0; i < 8; i++)
+		if (!decode_functions())
+		{
+			release_buffer();
+			return;
+		}
+		// Only the decoded copy runs, the raw function table and code are never read again
+		advise_decoded(resident_end);
+
+		if (options.ExternalCalls)
+		{
+			return; // Verified and finished by CryoState once it's linked with the other assemblies
+		}
+		finish_load(verify());
+	}
+
+	uint32_t CryoAssembly::define_symbols(CryoSymbolTable& symbols)
+	{
+		uint32_t redefined = 0;
+		for (auto& func : m_Functions)
+		{
+			func.FunctionSignature = symbols.intern(func.FunctionSignature);
+			if (!symbols.define(func.FunctionSignature, &func))
+			{
+				std::cout << "Warning: function [" << func.FunctionSignature << "] in CryoAssembly at [" << m_AssemblyPath.string()
+					<< "] is already defined by another assembly, calls from other assemblies use the first definition!" << std::endl;
+				redefined++;
+			}
+		}
+		return redefined;
+	}
+
+	bool CryoAssembly::link(CryoSymbolTable& symbols)
+	{
+		for (const ExternalCall& call : m_ExternalCalls)
 		{
-			if (header_string[i] != expected_string[i])
+			const CryoFunction* callee = symbols.find(call.Signature);
+			if (!callee)
 			{
-				std::cout << "Failed to validate header for CryoAssembly at [" << m_AssemblyPath.string() << "]!";
-				return;
+				std::cout << "CryoAssembly at [" << m_AssemblyPath.string() << "] calls [" << call.Signature << "], which no loaded assembly defines!" << std::endl;
+				return false;
 			}
+			m_Code[call.Instruction].Function = callee;
 		}
+		m_ExternalCalls.clear();
+		return true;
+	}
 
+	bool CryoAssembly::verify()
+	{
+		if (!m_Options.Verify)
+		{
+			return false;
+		}
+
+		bool verified = true;
+		m_CallOffsets.assign(m_Functions.size(), {});
+		for (size_t i = 0; i < m_Functions.size(); i++)
+		{
+			auto& func = m_Functions[i];
+			auto error = CryoVerifier::verify_function(func, m_CallOffsets[i], m_InferFrameSizes ? &func.FrameSize : nullptr);
+			if (error.has_value())
+			{
+				std::cout << "Warning: function [" << func.FunctionSignature << "] in CryoAssembly at [" << m_AssemblyPath.string() << "] failed verification: "
+					<< error.value() << ", running with runtime checks!" << std::endl;
+				verified = false;
+			}
+		}
+		return verified;
+	}
+
+	bool CryoAssembly::finish_load(bool verified)
+	{
+		// Assemblies that fail verification still run, but with every runtime check enabled.
+		// Register format code has no stack layout instructions for those checks to work with, so it must pass
+		m_Verified = verified;
+		bool has_register_format = false;
+		for (const auto& func : m_Functions) { has_register_format |= func.RegisterFormat; }
+		if (!m_Verified && has_register_format)
+		{
+			std::cout << "CryoAssembly at [" << m_AssemblyPath.string() << "] has register format code and can't run verified!" << std::endl;
+			release_buffer();
+			return false;
+		}
+
+		if (m_Verified)
+		{
+			compact_functions(m_CallOffsets);
+			if (m_Options.Superinstructions && CryoThread::has_threaded_dispatch())
+			{
+				fuse_superinstructions();
+			}
+		}
+		m_CallOffsets.clear();
+		m_CallOffsets.shrink_to_fit();
+
+		// Counted on the final code, verified functions lost their stack layout instructions and fused pairs still take two slots
+		for (auto& func : m_Functions)
+		{
+			func.FuelCost = 0;
+			while (func.Code[func.FuelCost].Opcode != OP_END) { func.FuelCost++; }
+		}
+		return true;
+	}
+
+	void CryoAssembly::compact_functions(const std::vector<std::vector<uint32_t>>& call_offsets)
+	{
+		// Compacts in place, the write position never passes the read position and functions are laid out in order
+		CryoInstruction* out = m_Code.data();
+		for (size_t i = 0; i < m_Functions.size(); i++)
+		{
+			auto& func = m_Functions[i];
+			const CryoInstruction* in = func.Code;
+			func.Code = out;
+
+			size_t call = 0;
+			for (; in->Opcode != OP_END; in++)
+			{
+				switch (in->Opcode)
+				{
+				case OP_STLS:
+				case OP_STLE:
+				case OP_PUSH:
+				case OP_POP:
+					break; // The frame already has room for every variable
+
+				case OP_CALL:
+				case OP_IMPL:
+				case OP_CALL_IMPORT:
+					*out = *in;
+					out->Operand = call_offsets[i][call++];
+					out++;
+					break;
+
+				default:
+					*out++ = *in;
+					break;
+				}
+			}
+			*out++ = *in; // OP_END
+		}
+
+		m_Code.resize(out - m_Code.data());
+	}
+
+	namespace {
+
+		struct Superinstruction
+		{
+			CryoDecodedOpcode First;
+			CryoDecodedOpcode Second;
+			CryoDecodedOpcode Fused;
+		};
+
+		// Frequent pairs in verified code, tools/ngrams.txt has the cryo-ngrams counts over the test builds and benchmarks.
+		// No sequence may start with a CALL, RETURN continues right after it, which would be inside the superinstruction
+		constexpr Superinstruction s_Superinstructions[] =
+		{
+			{ OP_SETU32, OP_SETU32, OP_SETU32_SETU32 },
+			{ OP_SETU32, OP_CALL,   OP_SETU32_CALL   },
+			{ OP_SETSTR, OP_IMPL,   OP_SETSTR_IMPL   },
+		};
+
+	}
+
+	void CryoAssembly::fuse_superinstructions()
+	{
+		for (auto& func : m_Functions)
+		{
+			CryoInstruction* code = m_Code.data() + (func.Code - m_Code.data());
+			for (uint32_t i = 0; code[i].Opcode != OP_END && code[i + 1].Opcode != OP_END; i++)
+			{
+				for (auto& superinstruction : s_Superinstructions)
+				{
+					if (code[i].Opcode == superinstruction.First && code[i + 1].Opcode == superinstruction.Second)
+					{
+						code[i].Opcode = superinstruction.Fused;
+						i++; // The second instruction can't start another superinstruction
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	bool CryoAssembly::decode_functions()
+	{
+		// Every raw instruction decodes into at most one CryoInstruction, reserve it all so the Code pointers stay valid
+		size_t code_size = 0;
+		for (auto& func : m_Functions) { code_size += func.InstrutionCount + 1; }
+		m_Code.reserve(code_size);
+
+		for (auto& func : m_Functions)
+		{
+			func.Code = m_Code.data() + m_Code.size();
+
+			const uint32_t* raw = func.FunctionStart;
+			const uint32_t* raw_end = func.FunctionStart + func.InstrutionCount;
+			while (raw < raw_end)
+			{
+				CryoInstruction instruction;
+				uint32_t opcode = raw[0];
+				uint32_t operands = 0;
+
+				bool stack_format_only = opcode == STLS || opcode == STLE || opcode == PUSH || opcode == POP
+					|| opcode == CALL_from_assembly_index || opcode == CALL_from_assembly_signature || opcode == IMPL;
+				bool register_format_only = opcode == CALLR_from_assembly_index || opcode == CALLR_from_assembly_signature || opcode == IMPLR;
+				if (func.RegisterFormat ? stack_format_only : register_format_only)
+				{
+					std::cout << "Function [" << func.FunctionSignature << "] in CryoAssembly at [" << m_AssemblyPath.string() << "] uses an instruction of the other code format: [" << std::hex << opcode << std::dec << "]!" << std::endl;
+					return false;
+				}
+
+				switch (opcode)
+				{
+				case STLS:   instruction.Opcode = OP_STLS; break;
+				case STLE:   instruction.Opcode = OP_STLE; break;
+				case RETURN: instruction.Opcode = OP_RETURN; break;
+
+				case PUSH:
+				case POP:
+					instruction.Opcode = opcode == PUSH ? OP_PUSH : OP_POP;
+					instruction.Operand = raw[1];
+					operands = 1;
+					break;
+
+				case SETU32:
+					instruction.Opcode = OP_SETU32;
+					instruction.Operand = raw[1];
+					instruction.Value = raw[2];
+					operands = 2;
+					break;
+
+				case SETSTR:
+					{
+						std::optional<std::string_view> str = get_string_literal(raw[2]);
+						if (!str.has_value())
+						{
+							std::cout << "Function [" << func.FunctionSignature << "] in CryoAssembly at [" << m_AssemblyPath.string() << "] uses an invalid string literal!" << std::endl;
+							return false;
+						}
+						instruction.Opcode = OP_SETSTR;
+						instruction.Operand = raw[1];
+						instruction.String = str->data(); // String literals are null terminated in the buffer
+						operands = 2;
+						break;
+					}
+
+				case MOVU32:
+					instruction.Opcode = OP_MOVU32;
+					instruction.Operand = raw[1];
+					instruction.Slots[0] = raw[2];
+					operands = 2;
+					break;
+
+				case ADDU32:
+				case SUBU32:
+				case MULU32:
+					instruction.Opcode = opcode == ADDU32 ? OP_ADDU32 : (opcode == SUBU32 ? OP_SUBU32 : OP_MULU32);
+					instruction.Operand = raw[1];
+					instruction.Slots[0] = raw[2];
+					instruction.Slots[1] = raw[3];
+					operands = 3;
+					break;
+
+				case ATOMIC_LOAD:
+				case ATOMIC_STORE:
+				case ATOMIC_ADD:
+				case ATOMIC_CAS:
+				case FENCE:
+					{
+						// The slot is the second variable of loads and adds and the first of the others
+						operands = opcode == ATOMIC_LOAD || opcode == ATOMIC_STORE ? 3 : (opcode == FENCE ? 1 : 4);
+						if (raw + operands >= raw_end)
+						{
+							break; // Reported below
+						}
+						uint32_t order = raw[operands];
+						uint32_t slot = opcode == FENCE ? 0 : (opcode == ATOMIC_LOAD || opcode == ATOMIC_ADD ? raw[2] : raw[1]);
+						if (!is_valid_memory_order(opcode, order & ~ATOMIC_HEAP) || (opcode == FENCE && (order & ATOMIC_HEAP)) || slot > ATOMIC_OFFSET_MASK)
+						{
+							std::cout << "Function [" << func.FunctionSignature << "] in CryoAssembly at [" << m_AssemblyPath.string() << "] has an atomic instruction with an invalid memory order or slot!" << std::endl;
+							return false;
+						}
+
+						switch (opcode)
+						{
+						case ATOMIC_LOAD:
+							instruction.Opcode = OP_ATOMIC_LOAD;
+							instruction.Slots[0] = raw[1];
+							break;
+						case ATOMIC_STORE:
+							instruction.Opcode = OP_ATOMIC_STORE;
+							instruction.Slots[0] = raw[2];
+							break;
+						case ATOMIC_ADD:
+							instruction.Opcode = OP_ATOMIC_ADD;
+							instruction.Slots[0] = raw[1];
+							instruction.Slots[1] = raw[3];
+							break;
+						case ATOMIC_CAS:
+							instruction.Opcode = OP_ATOMIC_CAS;
+							instruction.Slots[0] = raw[2];
+							instruction.Slots[1] = raw[3];
+							break;
+						default:
+							instruction.Opcode = OP_FENCE;
+							break;
+						}
+						instruction.Operand = pack_atomic_operand(slot, order);
+						break;
+					}
+
+				case CALL_from_assembly_index:
+				case CALL_from_assembly_signature:
+				case CALLR_from_assembly_index:
+				case CALLR_from_assembly_signature:
+					{
+						const CryoFunction* callee = nullptr;
+						const CryoImport* imported = nullptr;
+						if (opcode == CALL_from_assembly_index || opcode == CALLR_from_assembly_index)
+						{
+							callee = get_function_by_index(raw[1]);
+						}
+						else if (std::optional<std::string_view> signature = get_string_literal(raw[1]))
+						{
+							callee = get_function_by_signature(signature.value());
+							imported = callee ? nullptr : get_import(signature.value());
+						}
+
+						instruction.Opcode = OP_CALL;
+						instruction.Function = callee;
+						if (imported)
+						{
+							// Bound on its first call, CryoVerifier checks it against the import's declaration
+							instruction.Opcode = OP_CALL_IMPORT;
+							instruction.Import = imported;
+						}
+						else if (!callee && m_Options.ExternalCalls && opcode != CALL_from_assembly_index && opcode != CALLR_from_assembly_index)
+						{
+							// Resolved by link once every assembly of the CryoState is loaded, the signature is valid or get_string_literal would have failed
+							m_ExternalCalls.push_back({ (uint32_t)m_Code.size(), get_string_literal(raw[1]).value() });
+						}
+						else if (!callee)
+						{
+							std::cout << "Function [" << func.FunctionSignature << "] in CryoAssembly at [" << m_AssemblyPath.string() << "] calls a non existent function!" << std::endl;
+							return false;
+						}
+						operands = 1;
+						if (func.RegisterFormat)
+						{
+							instruction.Operand = raw[2]; // Frame offset
+							operands = 2;
+						}
+						break;
+					}
+
+				case IMPL:
+				case IMPLR:
+					{
+						std::optional<std::string_view> signature = get_string_literal(raw[1]);
+						const ImplFunction* impl = signature.has_value() ? CryoThread::find_impl_function(signature.value()) : nullptr;
+						if (!impl)
+						{
+							std::cout << "Function [" << func.FunctionSignature << "] in CryoAssembly at [" << m_AssemblyPath.string() << "] calls a non existent IMPL function!" << std::endl;
+							return false;
+						}
+						instruction.Opcode = OP_IMPL;
+						instruction.Impl = impl;
+						operands = 1;
+						if (func.RegisterFormat)
+						{
+							instruction.Operand = raw[2]; // Frame offset
+							operands = 2;
+						}
+						break;
+					}
+
+				default:
+					std::cout << "Function [" << func.FunctionSignature << "] in CryoAssembly at [" << m_AssemblyPath.string() << "] contains an unknown instruction: [" << std::hex << opcode << std::dec << "]!" << std::endl;
+					return false;
+				}
+
+				if (raw + operands >= raw_end)
+				{
+					std::cout << "Function [" << func.FunctionSignature << "] in CryoAssembly at [" << m_AssemblyPath.string() << "] ends in the middle of an instruction!" << std::endl;
+					return false;
+				}
+
+				m_Code.emplace_back(instruction);
+				raw += 1 + operands;
+			}
+
+			m_Code.emplace_back(CryoInstruction()); // OP_END
+		}
+
+		return true;
+	}
+
+	bool CryoAssembly::read_v1_tables(size_t file_size, size_t& resident_end)
+	{
 		constexpr uint32_t block_end = std::numeric_limits<uint32_t>::max();
 
+		// v1 images are only found by scanning for block ends, every scan stops at the end of the file
+		const uint32_t* file_end = m_AssemblyBuffer + file_size / sizeof(uint32_t);
+		auto truncated = [&]() {
+			std::cout << "CryoAssembly at [" << m_AssemblyPath.string() << "] is not a valid v1 image: its tables run past the end of the file!" << std::endl;
+			return false;
+		};
+
 		// Read string literals
 		uint32_t strings_size = 0;
-		for (uint32_t i = 1; m_AssemblyBuffer[i] != block_end; i++) { strings_size++; }
+		for (uint32_t i = 1; m_AssemblyBuffer + i < file_end && m_AssemblyBuffer[i] != block_end; i++) { strings_size++; }
 		strings_size *= sizeof(uint32_t);
 
 		const char* string_literals = reinterpret_cast<const char*>(m_AssemblyBuffer) + 8; // Right after the header
@@ -92,43 +520,306 @@ namespace Cryo {
 		}
 
 		uint32_t* function_ptr = m_AssemblyBuffer + 1 + (strings_size / sizeof(uint32_t)); // Jump ahead of the header and string literals
-		while (function_ptr[0] != block_end || function_ptr[1] != block_end)
+		resident_end = (uint8_t*)function_ptr - (uint8_t*)m_AssemblyBuffer;
+		advise_sections(resident_end);
+		m_InferFrameSizes = true;
+		while (true)
 		{
+			if (function_ptr + 2 > file_end)
+			{
+				return truncated();
+			}
+			if (function_ptr[0] == block_end && function_ptr[1] == block_end)
+			{
+				break;
+			}
       function_ptr += 1;
-			// func { uint32_t signature_id, uint32_t instruction_start, uint32_t instruction_count, uint32_t return_size, uint32_t param_sizes[?] }
+			// func { uint32_t signature_id, uint32_t instruction_start, uint32_t instruction_count, uint32_t return_size, uint32_t param_sizes[?] },
+			// the layout the first linker wrote. v1 records have no frame size or flags, so v1 code is always stack format
+			const uint32_t* record_end = function_ptr + 4;
+			while (record_end < file_end && *record_end != block_end) { record_end++; }
+			if (record_end >= file_end)
+			{
+				return truncated();
+			}
+
 			CryoFunction func = {};
-			uint32_t t = function_ptr[1];
 			func.FunctionStart = m_AssemblyBuffer + function_ptr[1];
 			func.InstrutionCount = function_ptr[2];
+			// The interpreter relies on the block end after the code instead of checking the instruction count on every step
+			if (uint64_t(function_ptr[1]) + func.InstrutionCount >= file_size / sizeof(uint32_t) || func.FunctionStart[func.InstrutionCount] != block_end)
+			{
+				std::cout << "CryoAssembly at [" << m_AssemblyPath.string() << "] has a function without a block end after its code!" << std::endl;
+				return false;
+			}
+			if (function_ptr[0] >= m_StringLiterals.size())
+			{
+				std::cout << "CryoAssembly at [" << m_AssemblyPath.string() << "] has a function with an invalid signature!" << std::endl;
+				return false;
+			}
 			func.FunctionSignature = m_StringLiterals[function_ptr[0]];
 			
       func.ReturnTypeSize = function_ptr[3];
       func.ParameterSizes.reserve(5);
       uint32_t param_count = 0;
-      for (int i = 4; function_ptr[i] != block_end; i++)
+      for (const uint32_t* param = function_ptr + 4; param < record_end; param++)
       {
         param_count++;
-        func.ParameterSizes.emplace_back(function_ptr[i]);
+        func.ParameterSizes.emplace_back(*param);
       }
 
       func.OwnerAssembly = this;
 
 			m_Functions.emplace_back(func);
 
-			m_FunctionFromLocation.insert(std::pair(func.FunctionStart - m_AssemblyBuffer, m_Functions.size() - 1));
 			m_FunctionFromSignature.insert(std::pair(func.FunctionSignature, m_Functions.size() - 1));
 		
       function_ptr += 4 + param_count; // Minimun size + parameters
     }
+
+		return true;
 	}
 
-	CryoAssembly::~CryoAssembly()
+	bool CryoAssembly::read_v2_tables(size_t file_size, size_t& resident_end)
+	{
+		auto fail = [&](const char* reason) {
+			std::cout << "CryoAssembly at [" << m_AssemblyPath.string() << "] is not a valid v2 image: " << reason << "!" << std::endl;
+			return false;
+		};
+
+		if (file_size < sizeof(CryoImageHeader))
+		{
+			return fail("header past the end of the file");
+		}
+		m_Image = (const CryoImageHeader*)m_AssemblyBuffer;
+		if (m_Image->Version != CRYO_IMAGE_VERSION || m_Image->SectionCount != SECTION_COUNT)
+		{
+			return fail("unsupported version");
+		}
+
+		// Every section must fit in the file, hold Count entries of its element size and be word aligned
+		constexpr uint32_t element_sizes[SECTION_COUNT] = { sizeof(CryoImageString), 1, sizeof(uint32_t), sizeof(CryoImageFunction), sizeof(uint32_t), sizeof(CryoImageImport), sizeof(uint32_t) };
+		for (uint32_t i = 0; i < SECTION_COUNT; i++)
+		{
+			const CryoImageSection& section = m_Image->Sections[i];
+			bool counted = i != SECTION_STRING_DATA && i != SECTION_CODE && i != SECTION_SIGNATURE_INDEX;
+			if (uint64_t(section.Offset) + section.Size > file_size || section.Offset % sizeof(uint32_t) != 0
+				|| (counted && uint64_t(section.Count) * element_sizes[i] != section.Size))
+			{
+				return fail("section out of bounds");
+			}
+		}
+		// A seed per bucket, then a function index per function
+		const CryoImageSection& index_section = m_Image->Sections[SECTION_SIGNATURE_INDEX];
+		uint32_t function_count = m_Image->Sections[SECTION_FUNCTIONS].Count;
+		if ((uint64_t(index_section.Count) + function_count) * sizeof(uint32_t) != index_section.Size || (function_count != 0 && index_section.Count == 0))
+		{
+			return fail("signature hash doesn't match the function table");
+		}
+
+		const uint8_t* image = (const uint8_t*)m_AssemblyBuffer;
+		m_StringTable = (const CryoImageString*)(image + m_Image->Sections[SECTION_STRING_TABLE].Offset);
+		m_StringData = (const char*)(image + m_Image->Sections[SECTION_STRING_DATA].Offset);
+		m_SignatureIndex = (const uint32_t*)(image + index_section.Offset);
+
+		// Strings and the signature index are used in place, the function table and code are only read to decode them
+		resident_end = std::max({ m_Image->Sections[SECTION_STRING_TABLE].Offset + m_Image->Sections[SECTION_STRING_TABLE].Size,
+			m_Image->Sections[SECTION_STRING_DATA].Offset + m_Image->Sections[SECTION_STRING_DATA].Size, index_section.Offset + index_section.Size });
+		advise_sections(resident_end);
+
+		const CryoImageSection& functions_section = m_Image->Sections[SECTION_FUNCTIONS];
+		const CryoImageSection& parameters_section = m_Image->Sections[SECTION_PARAMETERS];
+		const CryoImageFunction* records = (const CryoImageFunction*)(image + functions_section.Offset);
+		const uint32_t* parameters = (const uint32_t*)(image + parameters_section.Offset);
+
+		m_Functions.reserve(functions_section.Count);
+		for (uint32_t i = 0; i < functions_section.Count; i++)
+		{
+			const CryoImageFunction& record = records[i];
+
+			CryoFunction func = {};
+			func.FunctionStart = m_AssemblyBuffer + record.CodeStart;
+			func.InstrutionCount = record.InstructionCount;
+			// The interpreter relies on the block end after the code instead of checking the instruction count on every step
+			if (uint64_t(record.CodeStart) + record.InstructionCount >= file_size / sizeof(uint32_t) || func.FunctionStart[func.InstrutionCount] != CRYO_BLOCK_END)
+			{
+				return fail("function without a block end after its code");
+			}
+			std::optional<std::string_view> signature = get_string_literal(record.Signature);
+			if (!signature.has_value() || uint64_t(record.ParameterStart) + record.ParameterCount > parameters_section.Count)
+			{
+				return fail("function with an invalid signature or parameters");
+			}
+			if ((record.Flags & ~FUNCTION_REGISTER_FORMAT) != 0)
+			{
+				return fail("function with unknown flags, rebuild it");
+			}
+			func.FunctionSignature = signature.value();
+
+			func.ReturnTypeSize = record.ReturnSize;
+			func.FrameSize = record.FrameSize;
+			func.RegisterFormat = (record.Flags & FUNCTION_REGISTER_FORMAT) != 0;
+			func.ParameterSizes.assign(parameters + record.ParameterStart, parameters + record.ParameterStart + record.ParameterCount);
+			func.OwnerAssembly = this;
+
+			m_Functions.emplace_back(std::move(func));
+		}
+
+		// Imports are copied out like the function table, their strings stay in place
+		const CryoImageSection& imports_section = m_Image->Sections[SECTION_IMPORTS];
+		const CryoImageImport* import_records = (const CryoImageImport*)(image + imports_section.Offset);
+		m_Imports.reserve(imports_section.Count);
+		for (uint32_t i = 0; i < imports_section.Count; i++)
+		{
+			const CryoImageImport& record = import_records[i];
+			std::optional<std::string_view> signature = get_string_literal(record.Signature);
+			std::optional<std::string_view> library = get_string_literal(record.Library);
+			if (!signature.has_value() || !library.has_value() || uint64_t(record.ParameterStart) + record.ParameterCount > parameters_section.Count)
+			{
+				return fail("import with an invalid signature, library or parameters");
+			}
+
+			CryoImport imported;
+			imported.Declaration.FunctionSignature = signature.value();
+			imported.Declaration.ReturnTypeSize = record.ReturnSize;
+			imported.Declaration.ParameterSizes.assign(parameters + record.ParameterStart, parameters + record.ParameterStart + record.ParameterCount);
+			imported.Library = library.value();
+
+			m_ImportFromSignature.insert(std::pair(imported.Declaration.FunctionSignature, i));
+			m_Imports.emplace_back(std::move(imported));
+		}
+
+		// Lookups trust the hash's slots, so check them once here
+		const uint32_t* slots = m_SignatureIndex + index_section.Count;
+		for (uint32_t i = 0; i < function_count; i++)
+		{
+			if (slots[i] >= function_count)
+			{
+				return fail("signature hash slot out of bounds");
+			}
+		}
+
+		return true;
+	}
+
+	bool CryoAssembly::map_file(size_t& file_size)
 	{
+		// Zero padded, decoding reads every operand of an instruction before checking it fits in the function
+		constexpr size_t padding = 3 * sizeof(uint32_t);
+
+#ifdef _WIN32
+		file_size = std::filesystem::file_size(m_AssemblyPath);
+		m_AssemblyBuffer = (uint32_t*)std::calloc(file_size + padding, 1);
+		if (m_AssemblyBuffer == nullptr)
+		{
+			std::cout << "Failed to alllocate a buffer of size [" << file_size << "] for the CryoAssembly at [" << m_AssemblyPath.string() << "]!";
+			return false;
+		}
+
+		std::ifstream fin(m_AssemblyPath, std::ios::in | std::ios::binary);
+		fin.read((char*)m_AssemblyBuffer, file_size);
+		return true;
+#else
+		int fd = open(m_AssemblyPath.c_str(), O_RDONLY | O_CLOEXEC);
+		struct stat file_stat;
+		if (fd < 0 || fstat(fd, &file_stat) != 0)
+		{
+			std::cout << "Failed to open the CryoAssembly at [" << m_AssemblyPath.string() << "]!" << std::endl;
+			if (fd >= 0) { close(fd); }
+			return false;
+		}
+		file_size = file_stat.st_size;
+
+		// The file is mapped over the start of an anonymous reservation, so the padding reads zeros even when the file ends on a page boundary.
+		// Both mappings are read only and private, every process running the assembly shares the file's pages through the page cache
+		size_t page_size = sysconf(_SC_PAGESIZE);
+		m_MappingSize = ((file_size + padding + page_size - 1) / page_size) * page_size;
+		void* reservation = mmap(nullptr, m_MappingSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (reservation == MAP_FAILED
+			|| (file_size != 0 && mmap(reservation, file_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED))
+		{
+			std::cout << "Failed to map the CryoAssembly at [" << m_AssemblyPath.string() << "]!" << std::endl;
+			if (reservation != MAP_FAILED) { munmap(reservation, m_MappingSize); }
+			close(fd);
+			return false;
+		}
+		close(fd); // The mapping keeps the file alive
+
+		m_AssemblyBuffer = (uint32_t*)reservation;
+		return true;
+#endif
+	}
+
+	void CryoAssembly::advise_sections(size_t resident_end)
+	{
+#ifndef _WIN32
+		// String literals (and the v2 signature index) are used in place for the assembly's whole life, the function table and code are read once, front to back, by the decoder
+		size_t page_size = sysconf(_SC_PAGESIZE);
+		size_t resident_pages = ((resident_end + page_size - 1) / page_size) * page_size;
+		madvise(m_AssemblyBuffer, resident_pages, MADV_WILLNEED);
+		if (resident_pages < m_MappingSize)
+		{
+			madvise((uint8_t*)m_AssemblyBuffer + resident_pages, m_MappingSize - resident_pages, MADV_SEQUENTIAL);
+		}
+#endif
+	}
+
+	void CryoAssembly::advise_decoded(size_t resident_end)
+	{
+#ifndef _WIN32
+		// Pages shared with the sections used in place stay, anything after them is dropped. It's a private read only mapping, so a later read
+		// (like a FunctionStart lookup) just faults the page back in from the page cache
+		size_t page_size = sysconf(_SC_PAGESIZE);
+		size_t resident_pages = ((resident_end + page_size - 1) / page_size) * page_size;
+		if (resident_pages < m_MappingSize)
+		{
+			madvise((uint8_t*)m_AssemblyBuffer + resident_pages, m_MappingSize - resident_pages, MADV_DONTNEED);
+		}
+#endif
+	}
+
+	void CryoAssembly::release_buffer()
+	{
+		if (m_AssemblyBuffer == nullptr)
+		{
+			return;
+		}
+
+#ifdef _WIN32
 		free(m_AssemblyBuffer);
+#else
+		munmap(m_AssemblyBuffer, m_MappingSize);
+#endif
+		m_AssemblyBuffer = nullptr;
+		m_MappingSize = 0;
+	}
+
+	CryoAssembly::~CryoAssembly()
+	{
+		for (const CryoFunction& func : m_Functions)
+		{
+			CryoJit::release(&func);
+		}
+		release_buffer();
 	}
 
-	const CryoFunction* CryoAssembly::get_function_by_signature(const std::string& signature) const
+	const CryoFunction* CryoAssembly::get_function_by_signature(std::string_view signature) const
 	{
+		if (m_Image)
+		{
+			if (m_Functions.empty())
+			{
+				return nullptr;
+			}
+
+			// Every signature has a slot of its own, a signature that isn't in the image lands on some other function's slot
+			uint32_t bucket_count = m_Image->Sections[SECTION_SIGNATURE_INDEX].Count;
+			uint64_t hash = hash_signature(signature);
+			uint32_t seed = m_SignatureIndex[hash_signature_bucket(hash, bucket_count)];
+			const CryoFunction& func = m_Functions[m_SignatureIndex[bucket_count + hash_signature_slot(hash, seed, m_Functions.size())]];
+			return func.FunctionSignature == signature ? &func : nullptr;
+		}
+
 		auto ite = m_FunctionFromSignature.find(signature);
 		if (ite == m_FunctionFromSignature.end())
 		{
@@ -137,18 +828,43 @@ namespace Cryo {
 		return &m_Functions[ite->second];
 	}
 
+	const CryoImport* CryoAssembly::get_import(std::string_view signature) const
+	{
+		auto ite = m_ImportFromSignature.find(signature);
+		if (ite == m_ImportFromSignature.end())
+		{
+			return nullptr;
+		}
+		return &m_Imports[ite->second];
+	}
+
 	const CryoFunction* CryoAssembly::get_function_by_index(uint32_t index) const
 	{
-		auto ite = m_FunctionFromLocation.find(index);
-		if (ite == m_FunctionFromLocation.end())
+		if (index >= m_Functions.size())
 		{
 			return nullptr;
 		}
-		return &m_Functions[ite->second];
+		return &m_Functions[index];
 	}
 
 	std::optional<std::string_view> CryoAssembly::get_string_literal(uint32_t index) const
 	{
+		if (m_Image)
+		{
+			// Checked on access instead of at load time, so loading doesn't touch every string
+			const CryoImageSection& data = m_Image->Sections[SECTION_STRING_DATA];
+			if (index >= m_Image->Sections[SECTION_STRING_TABLE].Count)
+			{
+				return std::nullopt;
+			}
+			const CryoImageString& str = m_StringTable[index];
+			if (uint64_t(str.Offset) + str.Length >= data.Size || m_StringData[str.Offset + str.Length] != '\0')
+			{
+				return std::nullopt;
+			}
+			return std::string_view(m_StringData + str.Offset, str.Length);
+		}
+
 		if (index >= m_StringLiterals.size())
 		{
 			return std::nullopt;
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "CryoImage.h"
+#include "CryoInstructions.h"
+
 #include <string>
 #include <filesystem>
 #include <vector>
@@ -9,23 +12,72 @@
 namespace Cryo {
 
 	class CryoAssembly;
+	class CryoLibraries;
+	class CryoSymbolTable;
+
+	/// <summary>
+	/// Native code CryoJit compiled for a function, takes the function's frame base
+	/// </summary>
+	using NativeFunction = void (*)(uint8_t* frame);
 
 	struct CryoFunction
 	{
 		uint32_t* FunctionStart = nullptr;
 		uint32_t InstrutionCount = 0;
+		/// Pre-decoded code, ends with an OP_END
+		const CryoInstruction* Code = nullptr;
 		std::string_view FunctionSignature;
 
     uint32_t ReturnTypeSize = 0;
     std::vector<uint32_t> ParameterSizes;
+    /// Bytes the function's frame needs, return and parameters included, reserved with a single bump on CALL for verified assemblies
+    uint32_t FrameSize = 0;
+    /// Instructions a call runs, the whole function since Cryo code has no branches. Charged against the calling thread's fuel on CALL
+    uint32_t FuelCost = 0;
+    /// Register format code runs on static frames only, so its assembly must pass verification
+    bool RegisterFormat = false;
 
 		const CryoAssembly* OwnerAssembly = nullptr;
+
+		// CryoJit state, only touched through std::atomic_ref since every thread running the assembly shares it
+
+		/// Calls made through verified CALLs, the one that reaches the JIT threshold compiles the function. Counting stops there
+		mutable uint32_t CallCount = 0;
+		/// Set once CryoJit compiled the function, CALL runs it instead of interpreting the function's code
+		mutable NativeFunction NativeCode = nullptr;
+	};
+
+	/// <summary>
+	/// Function an assembly imports from a library, CryoLibraries loads the library and binds it the first time a call to it runs
+	/// </summary>
+	struct CryoImport
+	{
+		/// Signature, return and parameter sizes the importing assembly was linked against, what CryoVerifier checks calls against
+		CryoFunction Declaration;
+		/// Path of the library, relative to the importing assembly's folder
+		std::string_view Library;
+		/// Set by CryoLibraries once bound, read without the lock through CryoLibraries::get_bound
+		mutable const CryoFunction* Bound = nullptr;
+	};
+
+	struct CryoLoadOptions
+	{
+		/// When false the assembly skips CryoVerifier and always runs with runtime checks, it fails to load if it has register format code
+		bool Verify = true;
+		/// Fuse common instruction sequences of verified assemblies into superinstructions. Ignored when the threaded dispatch loop
+		/// isn't built in, the switch loop ran no faster with them
+		bool Superinstructions = true;
+		/// Leave calls to signatures the assembly doesn't define unresolved instead of failing to load. The assembly can't run until
+		/// link and finish_load are called, CryoState does it once every assembly it loads is mapped and decoded
+		bool ExternalCalls = false;
+		/// Loads the libraries of the assembly's imports, without one calling an import is a fatal error
+		CryoLibraries* Libraries = nullptr;
 	};
 
 	class CryoAssembly
 	{
 	public:
-		CryoAssembly(const std::filesystem::path& path);
+		CryoAssembly(const std::filesystem::path& path, const CryoLoadOptions& options = {});
 		~CryoAssembly();
 
 		/// <summary>
@@ -34,27 +86,140 @@ namespace Cryo {
 		/// <returns> Returns true if valid, false if not </returns>
 		bool is_valid() const { return m_AssemblyBuffer != nullptr; }
 
+		/// <summary>
+		/// Verified assemblies passed CryoVerifier when loaded and run without runtime checks
+		/// </summary>
+		bool is_verified() const { return m_Verified; }
+
 		const std::filesystem::path& get_path() const { return m_AssemblyPath; }
+		CryoLibraries* get_libraries() const { return m_Options.Libraries; }
 
 		/// <summary>
-		/// Used to retrieve a CryoFunction by it's signature
+		/// Used to retrieve a CryoFunction by its signature, doesn't allocate
 		/// </summary>
 		/// <param name="signature"> Function signature </param>w
 		/// <returns> Returns a pointer to the function if it finds it, nullptr if it doesn't </returns>
-		const CryoFunction* get_function_by_signature(const std::string& signature) const;
+		const CryoFunction* get_function_by_signature(std::string_view signature) const;
+		/// <summary>
+		/// Used to retrieve a CryoFunction by its index in the function table, which is what CALL_from_assembly_index refers to
+		/// </summary>
+		/// <returns> Returns a pointer to the function if the index is valid, nullptr if it isn't </returns>
 		const CryoFunction* get_function_by_index(uint32_t index) const;
 
 		std::optional<std::string_view> get_string_literal(uint32_t index) const;
 
+		/// <summary>
+		/// Used to retrieve an entry of the import table by the imported function's signature
+		/// </summary>
+		/// <returns> Returns a pointer to the import if it finds it, nullptr if it doesn't </returns>
+		const CryoImport* get_import(std::string_view signature) const;
+
+		// Loading in stages, only for assemblies loaded with CryoLoadOptions::ExternalCalls
+
+		/// <summary>
+		/// Interns the signature of every function and defines it in symbols, the first assembly to define a signature keeps it
+		/// </summary>
+		/// <returns> Returns the number of functions already defined by another assembly </returns>
+		uint32_t define_symbols(CryoSymbolTable& symbols);
+		/// <summary>
+		/// Resolves every call to a function of another assembly through symbols, once, by patching the decoded CALL
+		/// </summary>
+		/// <returns> Returns false if a signature isn't defined by any assembly </returns>
+		bool link(CryoSymbolTable& symbols);
+		/// <summary>
+		/// Runs CryoVerifier over every function, callees in other assemblies must be linked
+		/// </summary>
+		/// <returns> Returns true if every function passed </returns>
+		bool verify();
+		/// <summary>
+		/// Readies the code to run, compacted for static frames if verified is true. Every assembly a thread can reach must be finished the same way,
+		/// CryoThread picks the mode of the whole execution from the entry point's assembly
+		/// </summary>
+		/// <param name="verified"> Only true if verify passed for this assembly and every other one it's linked with </param>
+		/// <returns> Returns false and leaves the assembly invalid if it has register format code and can't run verified </returns>
+		bool finish_load(bool verified);
+
 	private:
+		/// <summary>
+		/// Maps the assembly file read only into m_AssemblyBuffer, followed by at least 3 zeroed words
+		/// </summary>
+		/// <param name="file_size"> Set to the size of the file </param>
+		/// <returns> Returns false if the file couldn't be mapped </returns>
+		bool map_file(size_t& file_size);
+		/// <summary>
+		/// Finds the string literals and reads the function table of a v1 image by scanning for its block ends
+		/// </summary>
+		/// <param name="resident_end"> Set to the byte offset where the sections used in place end </param>
+		bool read_v1_tables(size_t file_size, size_t& resident_end);
+		/// <summary>
+		/// Checks the section table of a v2 image and reads its function table, strings and the signature index are used in place
+		/// </summary>
+		/// <param name="resident_end"> Set to the byte offset where the sections used in place end </param>
+		bool read_v2_tables(size_t file_size, size_t& resident_end);
+		/// <summary>
+		/// Hints the OS about the access pattern of the mapped sections, resident_end is the byte offset where the sections used in place end
+		/// </summary>
+		void advise_sections(size_t resident_end);
+		/// <summary>
+		/// Lets the OS drop the pages of the raw function table and code once they're decoded
+		/// </summary>
+		void advise_decoded(size_t resident_end);
+		/// <summary>
+		/// Unmaps m_AssemblyBuffer, which leaves the assembly invalid
+		/// </summary>
+		void release_buffer();
+
+		/// <summary>
+		/// Decodes the raw code of every function into m_Code, resolving string literals, callees and IMPL functions
+		/// </summary>
+		/// <returns> Returns true if every function was decoded, false if the assembly is invalid </returns>
+		bool decode_functions();
+		/// <summary>
+		/// Rewrites the code of a verified assembly for static frames: stack layout instructions are dropped
+		/// and CALL/IMPL take the offset of the callee's frame inside the caller's as their operand
+		/// </summary>
+		/// <param name="call_offsets"> Offsets found by CryoVerifier, one vector per function </param>
+		void compact_functions(const std::vector<std::vector<uint32_t>>& call_offsets);
+		/// <summary>
+		/// Replaces the opcode of the first instruction of every sequence in the superinstruction table with its fused opcode
+		/// </summary>
+		void fuse_superinstructions();
+
 		std::filesystem::path m_AssemblyPath;
-		uint32_t* m_AssemblyBuffer;
+		/// Read only mapping of the assembly file, string literals point into it
+		uint32_t* m_AssemblyBuffer = nullptr;
+		size_t m_MappingSize = 0;
+
+		// v2 images, m_Image is nullptr for v1 ones
+		const CryoImageHeader* m_Image = nullptr;
+		const CryoImageString* m_StringTable = nullptr;
+		const char* m_StringData = nullptr;
+		const uint32_t* m_SignatureIndex = nullptr;
 
+		// v1 images
 		std::vector<std::string_view> m_StringLiterals;
+		std::unordered_map<std::string_view, uint32_t> m_FunctionFromSignature; // Keys point into the mapped image
+
+		struct ExternalCall
+		{
+			/// Index of the decoded CALL in m_Code
+			uint32_t Instruction = 0;
+			std::string_view Signature;
+		};
 
 		std::vector<CryoFunction> m_Functions;
-		std::unordered_map<std::string, uint32_t> m_FunctionFromSignature;
-		std::unordered_map<uint32_t, uint32_t> m_FunctionFromLocation;
+		std::vector<CryoInstruction> m_Code;
+		/// Filled before decoding and never resized afterwards, OP_CALL_IMPORT points into it
+		std::vector<CryoImport> m_Imports;
+		std::unordered_map<std::string_view, uint32_t> m_ImportFromSignature;
+		/// Calls left unresolved by decode_functions with CryoLoadOptions::ExternalCalls, cleared by link
+		std::vector<ExternalCall> m_ExternalCalls;
+		/// Filled by verify for finish_load
+		std::vector<std::vector<uint32_t>> m_CallOffsets;
+		CryoLoadOptions m_Options;
+		bool m_Verified = false;
+		/// v1 images don't record frame sizes, CryoVerifier measures them instead
+		bool m_InferFrameSizes = false;
 	};
 
 }
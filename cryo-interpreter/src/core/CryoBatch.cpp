@@ -0,0 +1,176 @@
+#include "cryopch.h"
+#include "CryoBatch.h"
+#include "CryoIO.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+
+namespace Cryo {
+
+	std::unique_ptr<CryoBatch> CryoBatch::load(const std::filesystem::path& manifest)
+	{
+		std::ifstream file(manifest);
+		if (!file)
+		{
+			std::cout << "Failed to open batch manifest at [" << manifest.string() << "]!" << std::endl;
+			return nullptr;
+		}
+
+		std::unique_ptr<CryoBatch> batch(new CryoBatch());
+		batch->m_Manifest = manifest;
+
+		// Jobs listing the same assemblies share one program
+		std::map<std::vector<std::filesystem::path>, Program*> programs;
+		std::string line;
+		for (uint32_t line_number = 1; std::getline(file, line); line_number++)
+		{
+			std::istringstream words(line);
+			std::string word;
+			if (!(words >> word) || word[0] == '#')
+			{
+				continue;
+			}
+
+			std::vector<std::filesystem::path> assemblies;
+			do
+			{
+				assemblies.emplace_back((manifest.parent_path() / word).lexically_normal());
+			} while (words >> word);
+
+			Program*& program = programs[assemblies];
+			if (!program)
+			{
+				program = batch->m_Programs.emplace_back(std::make_unique<Program>()).get();
+				program->Assemblies = std::move(assemblies);
+			}
+			batch->m_Jobs.emplace_back(Job{ line_number, program });
+		}
+
+		if (batch->m_Jobs.empty())
+		{
+			std::cout << "Batch manifest at [" << manifest.string() << "] has no jobs!" << std::endl;
+			return nullptr;
+		}
+		return batch;
+	}
+
+	uint32_t CryoBatch::run(const std::filesystem::path& results, uint32_t workers, const CryoContextOptions& options)
+	{
+		if (workers == 0)
+		{
+			workers = std::max(1u, std::thread::hardware_concurrency());
+		}
+		size_t worker_count = std::min<size_t>(m_Jobs.size(), workers);
+
+		std::atomic<size_t> next_job = 0;
+		auto work = [&]() {
+			// One context per worker, created by its first job and moved between programs after that
+			std::unique_ptr<CryoContext> context;
+			for (size_t i = next_job++; i < m_Jobs.size(); i = next_job++)
+			{
+				run_job(m_Jobs[i], context, options);
+			}
+		};
+		{
+			std::vector<std::jthread> pool;
+			for (size_t i = 1; i < worker_count; i++) { pool.emplace_back(work); }
+			work();
+		}
+
+		uint32_t failed = 0;
+		for (const Job& job : m_Jobs)
+		{
+			failed += job.Status != JobStatus::Ok;
+		}
+
+		if (!write_results(results))
+		{
+			std::cout << "Failed to write batch results to [" << results.string() << "]!" << std::endl;
+		}
+		return failed;
+	}
+
+	void CryoBatch::run_job(Job& job, std::unique_ptr<CryoContext>& context, const CryoContextOptions& options)
+	{
+		Program& program = *job.Source;
+		// Loaded outside the timed part, only the first job of a program pays for it
+		std::call_once(program.LoadOnce, [&]() { program.Instance = CryoProgram::load(program.Assemblies); });
+		if (!program.Instance)
+		{
+			job.Status = JobStatus::LoadFailed;
+			return;
+		}
+		if (!program.Instance->get_entry_point())
+		{
+			CryoIO::flush();
+			std::cout << "Failed to find entry point for the job at line " << job.Line << " of [" << m_Manifest.string() << "]!" << std::endl;
+			job.Status = JobStatus::LoadFailed;
+			return;
+		}
+
+		if (!context)
+		{
+			context = std::make_unique<CryoContext>(program.Instance, options);
+		}
+		else if (&context->get_program() != program.Instance.get())
+		{
+			context->set_program(program.Instance);
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		try
+		{
+			job.Status = context->run_entry_point() ? JobStatus::Ok
+				: context->get_thread().exceeded_budget() ? JobStatus::BudgetExceeded : JobStatus::Failed;
+		}
+		catch (const std::exception& e)
+		{
+			CryoIO::flush();
+			std::cout << "Job at line " << job.Line << " of [" << m_Manifest.string() << "] threw: " << e.what() << std::endl;
+			job.Status = JobStatus::Error;
+		}
+		job.Microseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+		// Keep a job's output together even when fully buffered
+		CryoIO::flush();
+	}
+
+	bool CryoBatch::write_results(const std::filesystem::path& results) const
+	{
+		std::ofstream file(results, std::ios::trunc);
+		if (!file)
+		{
+			return false;
+		}
+
+		file << "# line status microseconds assemblies\n";
+		for (const Job& job : m_Jobs)
+		{
+			file << job.Line << ' ' << get_status_name(job.Status) << ' ' << job.Microseconds;
+			for (const auto& path : job.Source->Assemblies)
+			{
+				file << ' ' << path.string();
+			}
+			file << '\n';
+		}
+		return (bool)file.flush();
+	}
+
+	const char* CryoBatch::get_status_name(JobStatus status)
+	{
+		switch (status)
+		{
+		case JobStatus::Ok:			return "ok";
+		case JobStatus::Failed:		return "failed";
+		case JobStatus::BudgetExceeded:	return "budget-exceeded";
+		case JobStatus::LoadFailed:	return "load-failed";
+		case JobStatus::Error:		return "error";
+		}
+		return "unknown";
+	}
+
+}
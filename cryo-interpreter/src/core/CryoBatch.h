@@ -0,0 +1,81 @@
+#pragma once
+
+#include "CryoContext.h"
+#include "CryoProgram.h"
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Cryo {
+
+	/// <summary>
+	/// Runs every job of a manifest on a fixed pool of worker threads in one process. Each distinct list of assemblies is loaded once, by the
+	/// first job that needs it, and every worker keeps a single CryoContext, so jobs reuse its stack instead of reserving one each
+	/// </summary>
+	/// Manifest: one job per line, the assemblies it runs separated by spaces like on the command line, the first one has the entry point.
+	/// Relative paths are relative to the manifest, empty lines and lines starting with '#' are skipped
+	class CryoBatch
+	{
+	public:
+		/// <summary>
+		/// Reads the manifest, assemblies are only loaded once run reaches a job using them
+		/// </summary>
+		/// <returns> Returns nullptr if the manifest can't be read or has no jobs </returns>
+		static std::unique_ptr<CryoBatch> load(const std::filesystem::path& manifest);
+
+		/// <summary>
+		/// Runs every job and writes their status and run time to the results file, in manifest order
+		/// </summary>
+		/// <param name="workers"> Worker threads, 0 uses one per core </param>
+		/// <returns> Returns the number of jobs that didn't return from their entry point </returns>
+		uint32_t run(const std::filesystem::path& results, uint32_t workers, const CryoContextOptions& options);
+
+		const std::filesystem::path& get_manifest() const { return m_Manifest; }
+
+	private:
+		enum class JobStatus
+		{
+			/// The entry point returned
+			Ok,
+			/// Stopped on a stack overflow or a fatal error
+			Failed,
+			/// Went over the fuel budget, see CryoContextOptions
+			BudgetExceeded,
+			/// An assembly failed to load or the program has no entry point
+			LoadFailed,
+			/// The interpreter threw while running the job
+			Error
+		};
+
+		struct Program
+		{
+			std::vector<std::filesystem::path> Assemblies;
+			std::once_flag LoadOnce;
+			/// Stays nullptr if loading failed
+			std::shared_ptr<const CryoProgram> Instance;
+		};
+
+		struct Job
+		{
+			uint32_t Line = 0;
+			Program* Source = nullptr;
+			JobStatus Status = JobStatus::LoadFailed;
+			uint64_t Microseconds = 0;
+		};
+
+		CryoBatch() = default;
+
+		void run_job(Job& job, std::unique_ptr<CryoContext>& context, const CryoContextOptions& options);
+		bool write_results(const std::filesystem::path& results) const;
+
+		static const char* get_status_name(JobStatus status);
+
+		std::filesystem::path m_Manifest;
+		/// Programs never move, jobs point at them
+		std::vector<std::unique_ptr<Program>> m_Programs;
+		std::vector<Job> m_Jobs;
+	};
+
+}
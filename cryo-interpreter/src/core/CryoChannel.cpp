@@ -0,0 +1,451 @@
+#include "cryopch.h"
+#include "CryoChannel.h"
+#include "CryoScheduler.h"
+
+#include <algorithm>
+#include <bit>
+#include <format>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace Cryo {
+
+	// Handles index a table of chunks that are never moved or freed, so looking a channel up doesn't take a lock.
+	// The low bits of a handle are the index + 1, the high ones the slot's generation, so a destroyed channel's handle stops working
+	// once its slot is reused
+	static constexpr uint32_t s_ChunkSize = 1024;
+	static constexpr uint32_t s_MaxChunks = 1024;
+	static constexpr uint32_t s_IndexBits = 21;
+	static constexpr uint32_t s_IndexMask = (1u << s_IndexBits) - 1;
+
+	struct ChannelSlot
+	{
+		std::atomic<CryoChannel*> Channel = nullptr;
+		/// Bumped when the channel is destroyed, only touched with s_TableMutex held
+		uint32_t Generation = 0;
+	};
+
+	static std::atomic<ChannelSlot*> s_Chunks[s_MaxChunks];
+	static std::mutex s_TableMutex;
+	static uint32_t s_SlotCount = 0;
+	/// Slots of destroyed channels, reused before the table grows
+	static std::vector<uint32_t> s_FreeSlots;
+
+	static ChannelSlot* find_slot(uint32_t handle)
+	{
+		uint32_t index = (handle & s_IndexMask) - 1;
+		if (handle == 0 || index >= s_ChunkSize * s_MaxChunks)
+		{
+			return nullptr;
+		}
+		ChannelSlot* chunk = s_Chunks[index / s_ChunkSize].load(std::memory_order_acquire);
+		return chunk ? &chunk[index % s_ChunkSize] : nullptr;
+	}
+
+	CryoChannel::CryoChannel(uint32_t capacity, ChannelKind kind)
+		: m_Kind(kind), m_Mask(std::bit_ceil(std::max(capacity, 2u)) - 1)
+	{
+		if (m_Kind == ChannelKind::SingleProducer)
+		{
+			m_Values = std::make_unique<uint32_t[]>(m_Mask + 1);
+		}
+		else
+		{
+			m_Slots = std::make_unique<Slot[]>(m_Mask + 1);
+			for (uint64_t i = 0; i <= m_Mask; i++)
+			{
+				m_Slots[i].Sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	uint32_t CryoChannel::create(uint32_t capacity, ChannelKind kind)
+	{
+		if (capacity == 0 || capacity > s_MaxCapacity)
+		{
+			throw std::logic_error(std::format("Fatal Error: channel capacity must be between 1 and {}, got [{}]!", s_MaxCapacity, capacity));
+		}
+
+		auto channel = std::make_unique<CryoChannel>(capacity, kind);
+		std::lock_guard lock(s_TableMutex);
+		uint32_t index = 0;
+		if (!s_FreeSlots.empty())
+		{
+			index = s_FreeSlots.back();
+			s_FreeSlots.pop_back();
+		}
+		else if (s_SlotCount == s_ChunkSize * s_MaxChunks)
+		{
+			throw std::logic_error(std::format("Fatal Error: more than {} channels are alive!", s_ChunkSize * s_MaxChunks));
+		}
+		else
+		{
+			index = s_SlotCount++;
+		}
+
+		ChannelSlot* chunk = s_Chunks[index / s_ChunkSize].load(std::memory_order_relaxed);
+		if (!chunk)
+		{
+			chunk = new ChannelSlot[s_ChunkSize];
+			s_Chunks[index / s_ChunkSize].store(chunk, std::memory_order_release);
+		}
+		ChannelSlot& slot = chunk[index % s_ChunkSize];
+		channel->m_Handle = (slot.Generation << s_IndexBits) | (index + 1);
+		slot.Channel.store(channel.get(), std::memory_order_release);
+		return channel.release()->m_Handle;
+	}
+
+	CryoChannel& CryoChannel::get(uint32_t handle)
+	{
+		ChannelSlot* slot = find_slot(handle);
+		CryoChannel* channel = slot ? slot->Channel.load(std::memory_order_acquire) : nullptr;
+		if (!channel || channel->m_Handle != handle)
+		{
+			throw std::logic_error(std::format("Fatal Error: [{}] isn't a channel handle!", handle));
+		}
+		return *channel;
+	}
+
+	void CryoChannel::destroy(uint32_t handle)
+	{
+		std::unique_ptr<CryoChannel> channel;
+		{
+			std::lock_guard lock(s_TableMutex);
+			ChannelSlot* slot = find_slot(handle);
+			CryoChannel* found = slot ? slot->Channel.load(std::memory_order_relaxed) : nullptr;
+			if (!found || found->m_Handle != handle)
+			{
+				throw std::logic_error(std::format("Fatal Error: [{}] isn't a channel handle!", handle));
+			}
+			// Catches the common misuse, a waiter that's just leaving still reads the channel so the caller has to be its last user
+			uint32_t waiting = found->m_Senders.Count.load() + found->m_Receivers.Count.load();
+			if (waiting != 0)
+			{
+				throw std::logic_error(std::format("Fatal Error: channel [{}] was destroyed while {} threads or fibers wait on it!", handle, waiting));
+			}
+			channel.reset(found);
+			slot->Channel.store(nullptr, std::memory_order_relaxed);
+			slot->Generation = (slot->Generation + 1) & (UINT32_MAX >> s_IndexBits);
+			s_FreeSlots.emplace_back((handle & s_IndexMask) - 1);
+		}
+	}
+
+	size_t CryoChannel::try_send(std::span<const uint32_t> values)
+	{
+		if (values.empty() || m_Closed.load(std::memory_order_relaxed))
+		{
+			return 0;
+		}
+
+		size_t sent = push(values);
+		if (sent != 0)
+		{
+			notify(m_Receivers);
+		}
+		return sent;
+	}
+
+	size_t CryoChannel::try_receive(std::span<uint32_t> values)
+	{
+		if (values.empty())
+		{
+			return 0;
+		}
+
+		size_t received = pop(values);
+		if (received != 0)
+		{
+			notify(m_Senders);
+		}
+		return received;
+	}
+
+	void CryoChannel::send(std::span<const uint32_t> values)
+	{
+		while (!values.empty())
+		{
+			if (m_Closed.load())
+			{
+				throw std::logic_error("Fatal Error: sent to a closed channel!");
+			}
+
+			size_t sent = try_send(values);
+			values = values.subspan(sent);
+			if (sent != 0 || values.empty())
+			{
+				continue;
+			}
+
+			// Counted before checking the channel again, so either this sees the receiver's change or the receiver sees this waiting
+			std::unique_lock lock(m_Senders.Mutex);
+			m_Senders.Count++;
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			m_Senders.Condition.wait(lock, [&]() { return is_ready(true); });
+			m_Senders.Count--;
+		}
+	}
+
+	size_t CryoChannel::receive(std::span<uint32_t> values)
+	{
+		while (!values.empty())
+		{
+			// Read first, a channel seen closed has every value sent before close already in it
+			bool closed = m_Closed.load();
+			size_t received = try_receive(values);
+			if (received != 0 || closed)
+			{
+				return received;
+			}
+
+			std::unique_lock lock(m_Receivers.Mutex);
+			m_Receivers.Count++;
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			m_Receivers.Condition.wait(lock, [&]() { return is_ready(false); });
+			m_Receivers.Count--;
+		}
+		return 0;
+	}
+
+	bool CryoChannel::send(CryoThread& thread, uint32_t value)
+	{
+		if (m_Closed.load())
+		{
+			throw std::logic_error("Fatal Error: sent to a closed channel!");
+		}
+		if (try_send(std::span(&value, 1)) != 0)
+		{
+			return true;
+		}
+
+		CryoFiber* fiber = thread.get_fiber();
+		if (!fiber)
+		{
+			send(std::span(&value, 1));
+			return true;
+		}
+
+		// CryoScheduler parks the fiber once it's suspended, it can't be resumed while it's still running
+		fiber->BlockedChannel = this;
+		fiber->BlockedSending = true;
+		thread.suspend(true);
+		return false;
+	}
+
+	bool CryoChannel::receive(CryoThread& thread, uint32_t& value)
+	{
+		bool closed = m_Closed.load();
+		if (try_receive(std::span(&value, 1)) != 0)
+		{
+			return true;
+		}
+		if (closed)
+		{
+			value = UINT32_MAX;
+			return true;
+		}
+
+		CryoFiber* fiber = thread.get_fiber();
+		if (!fiber)
+		{
+			if (receive(std::span(&value, 1)) == 0)
+			{
+				value = UINT32_MAX;
+			}
+			return true;
+		}
+
+		fiber->BlockedChannel = this;
+		fiber->BlockedSending = false;
+		thread.suspend(true);
+		return false;
+	}
+
+	void CryoChannel::close()
+	{
+		m_Closed.store(true);
+		wake(m_Senders);
+		wake(m_Receivers);
+	}
+
+	void CryoChannel::park(CryoFiber* fiber, bool sending)
+	{
+		Waiters& side = sending ? m_Senders : m_Receivers;
+		{
+			std::lock_guard lock(side.Mutex);
+			side.Count++;
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (!is_ready(sending))
+			{
+				side.Fibers.emplace_back(fiber);
+				return;
+			}
+			side.Count--;
+		}
+		CryoScheduler::get().wake(fiber);
+	}
+
+	size_t CryoChannel::push(std::span<const uint32_t> values)
+	{
+		if (m_Kind == ChannelKind::SingleProducer)
+		{
+			uint64_t tail = m_Tail.load(std::memory_order_relaxed);
+			size_t count = std::min<size_t>(values.size(), m_Mask + 1 - (tail - m_CachedHead));
+			if (count < values.size())
+			{
+				m_CachedHead = m_Head.load(std::memory_order_acquire);
+				count = std::min<size_t>(values.size(), m_Mask + 1 - (tail - m_CachedHead));
+			}
+
+			for (size_t i = 0; i < count; i++)
+			{
+				m_Values[(tail + i) & m_Mask] = values[i];
+			}
+			m_Tail.store(tail + count, std::memory_order_release);
+			return count;
+		}
+
+		// Claims the run of free slots starting at the tail with a single CAS, a slot is free for position pos once its sequence is pos
+		uint64_t tail = m_Tail.load(std::memory_order_relaxed);
+		while (true)
+		{
+			size_t count = 0;
+			int64_t distance = 0;
+			while (count < values.size())
+			{
+				distance = int64_t(m_Slots[(tail + count) & m_Mask].Sequence.load(std::memory_order_acquire) - (tail + count));
+				if (distance != 0)
+				{
+					break;
+				}
+				count++;
+			}
+
+			if (count == 0)
+			{
+				if (distance < 0)
+				{
+					return 0; // Full
+				}
+				tail = m_Tail.load(std::memory_order_relaxed);
+				continue;
+			}
+
+			if (m_Tail.compare_exchange_weak(tail, tail + count, std::memory_order_relaxed))
+			{
+				for (size_t i = 0; i < count; i++)
+				{
+					Slot& slot = m_Slots[(tail + i) & m_Mask];
+					slot.Value = values[i];
+					slot.Sequence.store(tail + i + 1, std::memory_order_release);
+				}
+				return count;
+			}
+		}
+	}
+
+	size_t CryoChannel::pop(std::span<uint32_t> values)
+	{
+		if (m_Kind == ChannelKind::SingleProducer)
+		{
+			uint64_t head = m_Head.load(std::memory_order_relaxed);
+			size_t count = std::min<size_t>(values.size(), m_CachedTail - head);
+			if (count < values.size())
+			{
+				m_CachedTail = m_Tail.load(std::memory_order_acquire);
+				count = std::min<size_t>(values.size(), m_CachedTail - head);
+			}
+
+			for (size_t i = 0; i < count; i++)
+			{
+				values[i] = m_Values[(head + i) & m_Mask];
+			}
+			m_Head.store(head + count, std::memory_order_release);
+			return count;
+		}
+
+		// A slot holds the value of position pos once its sequence is pos + 1, receiving it frees it for the next lap
+		uint64_t head = m_Head.load(std::memory_order_relaxed);
+		while (true)
+		{
+			size_t count = 0;
+			int64_t distance = 0;
+			while (count < values.size())
+			{
+				distance = int64_t(m_Slots[(head + count) & m_Mask].Sequence.load(std::memory_order_acquire) - (head + count + 1));
+				if (distance != 0)
+				{
+					break;
+				}
+				count++;
+			}
+
+			if (count == 0)
+			{
+				if (distance < 0)
+				{
+					return 0; // Empty
+				}
+				head = m_Head.load(std::memory_order_relaxed);
+				continue;
+			}
+
+			if (m_Head.compare_exchange_weak(head, head + count, std::memory_order_relaxed))
+			{
+				for (size_t i = 0; i < count; i++)
+				{
+					Slot& slot = m_Slots[(head + i) & m_Mask];
+					values[i] = slot.Value;
+					slot.Sequence.store(head + i + m_Mask + 1, std::memory_order_release);
+				}
+				return count;
+			}
+		}
+	}
+
+	bool CryoChannel::is_ready(bool sending) const
+	{
+		if (m_Closed.load())
+		{
+			return true;
+		}
+
+		if (m_Kind == ChannelKind::SingleProducer)
+		{
+			uint64_t used = m_Tail.load(std::memory_order_acquire) - m_Head.load(std::memory_order_acquire);
+			return sending ? used <= m_Mask : used != 0;
+		}
+
+		// Also true when another thread already moved the index past the slot, the retry sees the slot after it
+		uint64_t position = sending ? m_Tail.load(std::memory_order_acquire) : m_Head.load(std::memory_order_acquire);
+		uint64_t sequence = m_Slots[position & m_Mask].Sequence.load(std::memory_order_acquire);
+		return int64_t(sequence - (sending ? position : position + 1)) >= 0;
+	}
+
+	void CryoChannel::notify(Waiters& side)
+	{
+		// Pairs with the fence of a thread about to wait, see send
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (side.Count.load(std::memory_order_relaxed) != 0)
+		{
+			wake(side);
+		}
+	}
+
+	void CryoChannel::wake(Waiters& side)
+	{
+		std::vector<CryoFiber*> fibers;
+		{
+			std::lock_guard lock(side.Mutex);
+			fibers.swap(side.Fibers);
+			side.Count -= (uint32_t)fibers.size();
+		}
+		side.Condition.notify_all();
+
+		for (CryoFiber* fiber : fibers)
+		{
+			CryoScheduler::get().wake(fiber);
+		}
+	}
+
+}
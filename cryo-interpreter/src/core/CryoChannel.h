@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace Cryo {
+
+	class CryoThread;
+	struct CryoFiber;
+
+	enum class ChannelKind
+	{
+		/// One thread sends and one receives, a ring of plain values indexed by a head and a tail
+		SingleProducer,
+		/// Any number of threads on both ends, every slot carries a sequence number claimed with a CAS
+		MultiProducer
+	};
+
+	/// <summary>
+	/// Bounded channel of uint32 values between Cryo threads and fibers. Sends and receives never take a lock unless the channel is full or
+	/// empty, blocked fibers are suspended and resumed by CryoScheduler while any other thread waits on a condition variable.
+	/// The batched sends and receives pay for the synchronization once per batch instead of once per value
+	/// </summary>
+	class CryoChannel
+	{
+	public:
+		/// <param name="capacity"> Rounded up to a power of two </param>
+		CryoChannel(uint32_t capacity, ChannelKind kind);
+
+		CryoChannel(const CryoChannel&) = delete;
+		CryoChannel& operator=(const CryoChannel&) = delete;
+
+		/// <summary>
+		/// Creates a channel every thread can reach through the handle, used by the channel_create IMPLs. Channels live until destroy
+		/// </summary>
+		/// <returns> Returns the channel's handle, throws if capacity is 0 or larger than s_MaxCapacity </returns>
+		static uint32_t create(uint32_t capacity, ChannelKind kind);
+		/// <returns> Returns the channel of a handle create returned, throws if it isn't one or the channel was destroyed </returns>
+		static CryoChannel& get(uint32_t handle);
+		/// <summary>
+		/// Frees a channel, used by the channel_destroy IMPL. Like freeing memory the caller has to be the channel's last user, it throws
+		/// if a thread or fiber still waits on it. The handle stops working and its slot is reused by the next create
+		/// </summary>
+		static void destroy(uint32_t handle);
+
+		/// <returns> Returns how many of values were sent, from the front, without blocking </returns>
+		size_t try_send(std::span<const uint32_t> values);
+		/// <returns> Returns how many values were received into the front of values without blocking </returns>
+		size_t try_receive(std::span<uint32_t> values);
+
+		/// <summary>
+		/// Sends all of values, blocking the calling thread while the channel is full. Throws if the channel is closed
+		/// </summary>
+		void send(std::span<const uint32_t> values);
+		/// <summary>
+		/// Receives at least one value, blocking the calling thread while the channel is empty
+		/// </summary>
+		/// <returns> Returns how many values were received, 0 once the channel is closed and empty </returns>
+		size_t receive(std::span<uint32_t> values);
+
+		/// <summary>
+		/// Sends value for the channel_send IMPL, a fiber finding the channel full is suspended and runs the IMPL again once there's space
+		/// </summary>
+		/// <returns> Returns false if the fiber was suspended </returns>
+		bool send(CryoThread& thread, uint32_t value);
+		/// <summary>
+		/// Receives a value for the channel_receive IMPL, a fiber finding the channel empty is suspended and runs the IMPL again once there's one
+		/// </summary>
+		/// <returns> Returns false if the fiber was suspended, value is UINT32_MAX once the channel is closed and empty </returns>
+		bool receive(CryoThread& thread, uint32_t& value);
+
+		/// <summary>
+		/// Fails the sends that follow and wakes every blocked thread and fiber, receivers still get the values that were sent
+		/// </summary>
+		void close();
+
+		/// <summary>
+		/// Parks a fiber suspended by send or receive until the channel changes, called by CryoScheduler once the fiber is off its worker.
+		/// Queues it again right away if the channel changed in between
+		/// </summary>
+		void park(CryoFiber* fiber, bool sending);
+
+		uint32_t get_capacity() const { return m_Mask + 1; }
+		ChannelKind get_kind() const { return m_Kind; }
+
+		static constexpr uint32_t s_MaxCapacity = 1u << 24;
+
+	private:
+		struct Slot
+		{
+			std::atomic<uint64_t> Sequence;
+			uint32_t Value;
+		};
+
+		/// <summary>
+		/// Threads and fibers blocked on one end of the channel
+		/// </summary>
+		struct Waiters
+		{
+			/// Blocked threads and parked fibers. Every successful operation checks the other end's count, so it's kept off the indices' cache lines
+			alignas(64) std::atomic<uint32_t> Count = 0;
+			std::mutex Mutex;
+			std::condition_variable Condition;
+			std::vector<CryoFiber*> Fibers;
+		};
+
+		size_t push(std::span<const uint32_t> values);
+		size_t pop(std::span<uint32_t> values);
+		bool is_ready(bool sending) const;
+
+		/// <summary>
+		/// Wakes side's waiters if there are any, called after an operation changed the channel for them
+		/// </summary>
+		void notify(Waiters& side);
+		void wake(Waiters& side);
+
+		const ChannelKind m_Kind;
+		const uint32_t m_Mask;
+		/// Set by create, get checks it so the handle of a destroyed channel doesn't reach the next one in its slot
+		uint32_t m_Handle = 0;
+		std::unique_ptr<uint32_t[]> m_Values;
+		std::unique_ptr<Slot[]> m_Slots;
+
+		/// Single producer: the next value received and a copy of m_Tail only the receiver touches.
+		/// Multi producer: the next position a receiver claims
+		alignas(64) std::atomic<uint64_t> m_Head = 0;
+		uint64_t m_CachedTail = 0;
+		/// Single producer: the next value sent and a copy of m_Head only the sender touches.
+		/// Multi producer: the next position a sender claims
+		alignas(64) std::atomic<uint64_t> m_Tail = 0;
+		uint64_t m_CachedHead = 0;
+
+		alignas(64) std::atomic<bool> m_Closed = false;
+		Waiters m_Senders;
+		Waiters m_Receivers;
+	};
+
+}
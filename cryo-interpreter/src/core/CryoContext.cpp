@@ -0,0 +1,36 @@
+#include "cryopch.h"
+#include "CryoContext.h"
+
+namespace Cryo {
+
+	bool CryoContext::run_entry_point()
+	{
+		const CryoFunction* func = m_Program->get_entry_point();
+		if (!func)
+		{
+			std::cout << "Failed to find entry point in assembly [" << m_Program->get_assemblies()[0]->get_path().string() << "]!" << std::endl;
+			return false;
+		}
+		return run(func, {});
+	}
+
+	bool CryoContext::run(const CryoFunction* func, std::span<uint8_t> frame)
+	{
+		if (!func)
+		{
+			return false;
+		}
+
+		try
+		{
+			return m_Thread.execute(func, frame);
+		}
+		catch (...)
+		{
+			// Leave the context usable for the next job, the embedder decides what to do with the error
+			m_Thread.reset();
+			throw;
+		}
+	}
+
+}
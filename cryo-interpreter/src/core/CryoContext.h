@@ -0,0 +1,98 @@
+#pragma once
+
+#include "CryoProgram.h"
+#include "CryoThread.h"
+
+#include <array>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <type_traits>
+
+namespace Cryo {
+
+	struct CryoContextOptions
+	{
+		uint32_t StackSizeMB = 8;
+		/// See CryoThread::set_jit_threshold, 0 disables the JIT
+		uint32_t JitThreshold = 0;
+		/// See CryoThread::set_fuel, 0 for both runs without limits
+		uint64_t FuelSlice = 0;
+		uint64_t FuelBudget = 0;
+	};
+
+	/// <summary>
+	/// Runs functions of a CryoProgram, one call at a time. A context is a CryoThread and a reference to the program, so it's cheap to create:
+	/// the stack is reserved address space the OS only backs once it's touched. Reuse one per worker thread across jobs instead of making one per job
+	/// </summary>
+	class CryoContext
+	{
+	public:
+		CryoContext(std::shared_ptr<const CryoProgram> program, const CryoContextOptions& options = {})
+			: m_Program(std::move(program)), m_Thread(options.StackSizeMB)
+		{
+			m_Thread.set_jit_threshold(options.JitThreshold);
+			m_Thread.set_fuel(options.FuelSlice, options.FuelBudget);
+		}
+
+		/// <summary>
+		/// Calls a bound function with typed arguments, they're written straight into the function's frame
+		/// </summary>
+		/// <returns> Returns the function's return, std::nullopt (false for void functions) if it stopped on a stack overflow or a fatal error </returns>
+		template <typename R, typename... Args>
+		std::conditional_t<std::is_void_v<R>, bool, std::optional<R>> call(const CryoFunctionHandle<R(Args...)>& function, std::type_identity_t<Args>... args)
+		{
+			using Layout = ImplDetail::FrameLayout<R, Args...>;
+
+			std::array<uint8_t, Layout::Size> frame = {};
+			size_t parameter = 0;
+			((std::memcpy(frame.data() + Layout::Offsets[parameter++], &args, sizeof(Args))), ...);
+
+			bool returned = run(function.get(), frame);
+			if constexpr (std::is_void_v<R>)
+			{
+				return returned;
+			}
+			else
+			{
+				if (!returned)
+				{
+					return std::nullopt;
+				}
+				R result;
+				std::memcpy(&result, frame.data(), sizeof(R));
+				return result;
+			}
+		}
+
+		/// <summary>
+		/// Runs the program's $void::main::void
+		/// </summary>
+		/// <returns> Returns false if the program has no entry point or it didn't return </returns>
+		bool run_entry_point();
+
+		/// <summary>
+		/// Drops whatever is left on the stack, calls already do it when a job throws
+		/// </summary>
+		void reset() { m_Thread.reset(); }
+		/// <summary>
+		/// Gives the stack pages jobs touched back to the OS, for contexts that stay idle for a while
+		/// </summary>
+		void trim() { m_Thread.trim(); }
+
+		/// <summary>
+		/// Points the context at another program, it keeps its stack so a worker can run jobs of different programs on one context
+		/// </summary>
+		void set_program(std::shared_ptr<const CryoProgram> program) { m_Thread.reset(); m_Program = std::move(program); }
+
+		const CryoProgram& get_program() const { return *m_Program; }
+		CryoThread& get_thread() { return m_Thread; }
+
+	private:
+		bool run(const CryoFunction* func, std::span<uint8_t> frame);
+
+		std::shared_ptr<const CryoProgram> m_Program;
+		CryoThread m_Thread;
+	};
+
+}
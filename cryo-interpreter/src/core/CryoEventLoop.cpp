@@ -0,0 +1,772 @@
+#include "cryopch.h"
+#include "CryoEventLoop.h"
+#include "CryoIO.h"
+#include "CryoScheduler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if CRYO_ASYNC_IO
+  #include <arpa/inet.h>
+  #include <fcntl.h>
+  #include <linux/io_uring.h>
+  #include <netinet/in.h>
+  #include <limits.h>
+  #include <poll.h>
+  #include <signal.h>
+  #include <sys/epoll.h>
+  #include <sys/eventfd.h>
+  #include <sys/mman.h>
+  #include <sys/socket.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+#endif
+
+namespace Cryo {
+
+  static std::atomic<IoBackend> s_PreferredBackend = IoBackend::IoUring;
+
+  /// <summary>
+  /// Owns the loop thread, requests from other threads are queued and the loop thread is woken through an eventfd to start them
+  /// </summary>
+  class CryoEventLoop::Backend
+  {
+  public:
+    virtual ~Backend() = default;
+
+    void submit(CryoIoRequest* request)
+    {
+      {
+        std::lock_guard lock(m_Mutex);
+        m_Incoming.emplace_back(request);
+      }
+      wake();
+    }
+
+    virtual const char* get_name() const = 0;
+
+  protected:
+    /// <summary>
+    /// Called by the backend once it's set up, its destructor must call stop before destroying anything the loop uses
+    /// </summary>
+    void start()
+    {
+      m_Thread = std::jthread([this](std::stop_token stop)
+      {
+#if CRYO_ASYNC_IO
+        // Writes to a socket or pipe whose reader is gone raise SIGPIPE on the thread that ran them, which is this one for send,
+        // write and the operations io_uring issues inline, its own workers block every signal. Blocked, they fail with EPIPE instead
+        // of killing the process
+        sigset_t pipe;
+        sigemptyset(&pipe);
+        sigaddset(&pipe, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &pipe, nullptr);
+#endif
+        run(stop);
+      });
+    }
+    void stop()
+    {
+      m_Thread.request_stop();
+      wake();
+      m_Thread = std::jthread();
+    }
+
+    virtual void run(std::stop_token stop) = 0;
+
+    std::vector<CryoIoRequest*> take_incoming()
+    {
+      std::vector<CryoIoRequest*> incoming;
+      std::lock_guard lock(m_Mutex);
+      incoming.swap(m_Incoming);
+      return incoming;
+    }
+
+    static void complete(CryoIoRequest* request, int64_t result)
+    {
+      request->Result = result;
+      if (request->Operation == IoOperation::Read && result >= 0)
+      {
+        request->Buffer[result] = '\0';
+      }
+
+      if (CryoFiber* fiber = request->Fiber)
+      {
+        request->State = IoState::Completed;
+        CryoScheduler::get().wake(fiber);
+      }
+      else
+      {
+        // The waiting thread owns the request, it may be gone right after this
+        request->Completed.release();
+      }
+    }
+
+#if CRYO_ASYNC_IO
+    void wake()
+    {
+      uint64_t one = 1;
+      (void)!::write(m_WakeFd, &one, sizeof(one));
+    }
+
+    /// <summary>
+    /// Runs an operation on the loop thread, for fds that are ready or that never block like regular files. Sockets stay blocking
+    /// for io_uring, so this never waits on them: it returns -EAGAIN instead and a write may complete with fewer bytes than asked.
+    /// Pipes have no per call flag and changing the fd's flags would change them for every process sharing it, so a write to a polled
+    /// fd that isn't a socket is cut to PIPE_BUF, which a pipe reported writable always takes without blocking
+    /// </summary>
+    static int64_t perform_now(const CryoIoRequest* request, bool polled)
+    {
+      ssize_t result = -1;
+      switch (request->Operation)
+      {
+      case IoOperation::Read:
+        result = ::recv(request->Fd, request->Buffer, request->Size, MSG_DONTWAIT);
+        if (result < 0 && errno == ENOTSOCK)
+        {
+          result = ::read(request->Fd, request->Buffer, request->Size);
+        }
+        break;
+
+      case IoOperation::Write:
+        result = ::send(request->Fd, request->Buffer, request->Size, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (result < 0 && errno == ENOTSOCK)
+        {
+          result = ::write(request->Fd, request->Buffer, polled ? std::min<uint32_t>(request->Size, PIPE_BUF) : request->Size);
+        }
+        break;
+
+      case IoOperation::Accept:
+        {
+          // accept4 has no per call flag, so check the connection is still there instead
+          pollfd listener = { request->Fd, POLLIN, 0 };
+          if (::poll(&listener, 1, 0) == 0)
+          {
+            return -EAGAIN;
+          }
+          result = ::accept4(request->Fd, nullptr, nullptr, SOCK_CLOEXEC);
+          break;
+        }
+
+      case IoOperation::Sleep:
+        return 0;
+      }
+      return result < 0 ? -errno : result;
+    }
+
+    int m_WakeFd = -1;
+#else
+    void wake() {}
+#endif
+
+  private:
+    std::mutex m_Mutex;
+    std::vector<CryoIoRequest*> m_Incoming;
+    std::jthread m_Thread;
+  };
+
+#if CRYO_ASYNC_IO
+  namespace {
+
+    /// <summary>
+    /// Requests become SQEs tagged with the request's address, the loop thread submits and reaps them with a single io_uring_enter
+    /// that blocks until something completes. A read of the wake eventfd is always in flight, tagged with 0, so submit wakes it up
+    /// </summary>
+    class IoUringBackend final : public CryoEventLoop::Backend
+    {
+    public:
+      /// <returns> Returns nullptr if the kernel doesn't have io_uring, it's disabled or lacks one of the operations </returns>
+      static std::unique_ptr<CryoEventLoop::Backend> create()
+      {
+        auto backend = std::make_unique<IoUringBackend>();
+        if (!backend->setup())
+        {
+          return nullptr;
+        }
+        backend->start();
+        return backend;
+      }
+
+      ~IoUringBackend() override
+      {
+        if (m_RingFd < 0)
+        {
+          return;
+        }
+        stop();
+
+        munmap(m_Sqes, m_SqesSize);
+        if (m_CqRing != m_SqRing)
+        {
+          munmap(m_CqRing, m_CqRingSize);
+        }
+        munmap(m_SqRing, m_SqRingSize);
+        close(m_RingFd);
+        close(m_WakeFd);
+      }
+
+      const char* get_name() const override { return "io_uring"; }
+
+    private:
+      static constexpr uint32_t s_Entries = 1024;
+
+      bool setup()
+      {
+        io_uring_params params = {};
+        m_RingFd = (int)syscall(__NR_io_uring_setup, s_Entries, &params);
+        if (m_RingFd < 0)
+        {
+          return false;
+        }
+        // Reads and writes at the current position of pipes, sockets and files need IORING_FEAT_RW_CUR_POS
+        if (!(params.features & IORING_FEAT_RW_CUR_POS) || !probe_operations())
+        {
+          close(m_RingFd);
+          m_RingFd = -1;
+          return false;
+        }
+
+        m_SqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        m_CqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+          m_SqRingSize = m_CqRingSize = std::max(m_SqRingSize, m_CqRingSize);
+        }
+        m_SqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+        m_SqRing = (uint8_t*)mmap(nullptr, m_SqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_RingFd, IORING_OFF_SQ_RING);
+        m_CqRing = (params.features & IORING_FEAT_SINGLE_MMAP) ? m_SqRing
+            : (uint8_t*)mmap(nullptr, m_CqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_RingFd, IORING_OFF_CQ_RING);
+        m_Sqes = (io_uring_sqe*)mmap(nullptr, m_SqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_RingFd, IORING_OFF_SQES);
+        // Blocking on purpose, io_uring hands EAGAIN of non blocking files back instead of waiting for them
+        m_WakeFd = eventfd(0, EFD_CLOEXEC);
+        if (m_SqRing == MAP_FAILED || m_CqRing == MAP_FAILED || m_Sqes == MAP_FAILED || m_WakeFd < 0)
+        {
+          // Not worth unwinding, the process is out of memory or fds and epoll would fail the same way
+          close(m_RingFd);
+          m_RingFd = -1;
+          return false;
+        }
+
+        m_SqTail = (uint32_t*)(m_SqRing + params.sq_off.tail);
+        m_SqHead = (uint32_t*)(m_SqRing + params.sq_off.head);
+        m_SqMask = *(uint32_t*)(m_SqRing + params.sq_off.ring_mask);
+        m_SqArray = (uint32_t*)(m_SqRing + params.sq_off.array);
+        m_SqEntries = params.sq_entries;
+        m_CqHead = (uint32_t*)(m_CqRing + params.cq_off.head);
+        m_CqTail = (uint32_t*)(m_CqRing + params.cq_off.tail);
+        m_CqMask = *(uint32_t*)(m_CqRing + params.cq_off.ring_mask);
+        m_Cqes = (io_uring_cqe*)(m_CqRing + params.cq_off.cqes);
+        m_CqEntries = params.cq_entries;
+        m_LocalTail = *m_SqTail;
+        return true;
+      }
+
+      bool probe_operations()
+      {
+        std::vector<uint8_t> storage(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op));
+        auto probe = (io_uring_probe*)storage.data();
+        if (syscall(__NR_io_uring_register, m_RingFd, IORING_REGISTER_PROBE, probe, 256) < 0)
+        {
+          return false;
+        }
+        for (uint32_t op : { IORING_OP_READ, IORING_OP_WRITE, IORING_OP_ACCEPT, IORING_OP_TIMEOUT })
+        {
+          if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+          {
+            return false;
+          }
+        }
+        return true;
+      }
+
+      io_uring_sqe* get_sqe()
+      {
+        uint32_t head = std::atomic_ref(*m_SqHead).load(std::memory_order_acquire);
+        if (m_LocalTail - head == m_SqEntries)
+        {
+          return nullptr;
+        }
+        uint32_t index = m_LocalTail & m_SqMask;
+        m_SqArray[index] = index;
+        m_LocalTail++;
+
+        io_uring_sqe* sqe = &m_Sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+      }
+
+      void prepare(io_uring_sqe* sqe, CryoIoRequest* request)
+      {
+        sqe->user_data = (uint64_t)request;
+        sqe->fd = request->Fd;
+        switch (request->Operation)
+        {
+        case IoOperation::Read:
+        case IoOperation::Write:
+          sqe->opcode = request->Operation == IoOperation::Read ? IORING_OP_READ : IORING_OP_WRITE;
+          sqe->addr = (uint64_t)request->Buffer;
+          sqe->len = request->Size;
+          sqe->off = (uint64_t)-1; // Current position
+          break;
+
+        case IoOperation::Accept:
+          sqe->opcode = IORING_OP_ACCEPT;
+          sqe->accept_flags = SOCK_CLOEXEC;
+          break;
+
+        case IoOperation::Sleep:
+          request->Timeout[0] = int64_t(request->Nanoseconds / 1000000000);
+          request->Timeout[1] = int64_t(request->Nanoseconds % 1000000000);
+          sqe->opcode = IORING_OP_TIMEOUT;
+          sqe->fd = -1;
+          sqe->addr = (uint64_t)request->Timeout;
+          sqe->len = 1;
+          break;
+        }
+      }
+
+      void run(std::stop_token stop) override
+      {
+        // Requests that didn't fit, the completion queue must never hold more than its entries
+        std::deque<CryoIoRequest*> backlog;
+        bool wake_armed = false;
+        uint32_t in_flight = 0;
+        uint32_t to_submit = 0;
+        uint64_t wake_value = 0;
+
+        while (!stop.stop_requested())
+        {
+          if (!wake_armed)
+          {
+            if (io_uring_sqe* sqe = get_sqe())
+            {
+              sqe->opcode = IORING_OP_READ;
+              sqe->fd = m_WakeFd;
+              sqe->addr = (uint64_t)&wake_value;
+              sqe->len = sizeof(wake_value);
+              sqe->user_data = 0;
+              wake_armed = true;
+              to_submit++;
+            }
+          }
+
+          for (CryoIoRequest* request : take_incoming())
+          {
+            backlog.emplace_back(request);
+          }
+          while (!backlog.empty() && in_flight + 1 < m_CqEntries)
+          {
+            io_uring_sqe* sqe = get_sqe();
+            if (!sqe)
+            {
+              break;
+            }
+            prepare(sqe, backlog.front());
+            backlog.pop_front();
+            in_flight++;
+            to_submit++;
+          }
+
+          std::atomic_ref(*m_SqTail).store(m_LocalTail, std::memory_order_release);
+          int submitted = (int)syscall(__NR_io_uring_enter, m_RingFd, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+          if (submitted > 0)
+          {
+            to_submit -= submitted;
+          }
+          else if (submitted < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+          {
+            CryoIO::flush();
+            std::cout << "Fatal Error: io_uring_enter failed, async IO stopped: " << std::strerror(errno) << std::endl;
+            return;
+          }
+
+          uint32_t head = *m_CqHead;
+          uint32_t tail = std::atomic_ref(*m_CqTail).load(std::memory_order_acquire);
+          for (; head != tail; head++)
+          {
+            const io_uring_cqe& cqe = m_Cqes[head & m_CqMask];
+            if (cqe.user_data == 0)
+            {
+              wake_armed = false;
+              continue;
+            }
+
+            auto request = (CryoIoRequest*)cqe.user_data;
+            in_flight--;
+            // A timeout that expires completes with -ETIME, that's the sleep ending normally
+            complete(request, request->Operation == IoOperation::Sleep && cqe.res == -ETIME ? 0 : cqe.res);
+          }
+          std::atomic_ref(*m_CqHead).store(head, std::memory_order_release);
+        }
+      }
+
+      int m_RingFd = -1;
+      uint8_t* m_SqRing = nullptr;
+      uint8_t* m_CqRing = nullptr;
+      io_uring_sqe* m_Sqes = nullptr;
+      size_t m_SqRingSize = 0;
+      size_t m_CqRingSize = 0;
+      size_t m_SqesSize = 0;
+
+      uint32_t* m_SqHead = nullptr;
+      uint32_t* m_SqTail = nullptr;
+      uint32_t* m_SqArray = nullptr;
+      uint32_t m_SqMask = 0;
+      uint32_t m_SqEntries = 0;
+      /// SQEs are filled past the shared tail, which is only published right before io_uring_enter
+      uint32_t m_LocalTail = 0;
+      uint32_t* m_CqHead = nullptr;
+      uint32_t* m_CqTail = nullptr;
+      uint32_t m_CqMask = 0;
+      io_uring_cqe* m_Cqes = nullptr;
+      uint32_t m_CqEntries = 0;
+    };
+
+    /// <summary>
+    /// Readiness based fallback. Requests wait on their fd's readiness and run once it's ready, sleeps are a timer queue that
+    /// bounds epoll_wait's timeout. Regular files can't be polled, they're always ready so their requests run right away
+    /// </summary>
+    class EpollBackend final : public CryoEventLoop::Backend
+    {
+    public:
+      static std::unique_ptr<CryoEventLoop::Backend> create()
+      {
+        auto backend = std::make_unique<EpollBackend>();
+        backend->m_EpollFd = epoll_create1(EPOLL_CLOEXEC);
+        backend->m_WakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (backend->m_EpollFd < 0 || backend->m_WakeFd < 0)
+        {
+          return nullptr;
+        }
+
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = backend->m_WakeFd;
+        epoll_ctl(backend->m_EpollFd, EPOLL_CTL_ADD, backend->m_WakeFd, &event);
+
+        backend->start();
+        return backend;
+      }
+
+      ~EpollBackend() override
+      {
+        stop();
+        close(m_EpollFd);
+        close(m_WakeFd);
+      }
+
+      const char* get_name() const override { return "epoll"; }
+
+    private:
+      using Clock = std::chrono::steady_clock;
+
+      static uint32_t get_interest(IoOperation operation) { return operation == IoOperation::Write ? EPOLLOUT : EPOLLIN; }
+
+      void start_request(CryoIoRequest* request)
+      {
+        if (request->Operation == IoOperation::Sleep)
+        {
+          m_Timers.emplace(Clock::now() + std::chrono::nanoseconds(request->Nanoseconds), request);
+          return;
+        }
+
+        auto& waiting = m_Waiting[request->Fd];
+        waiting.emplace_back(request);
+        if (!update_interest(request->Fd, waiting) && errno == EPERM)
+        {
+          // Regular files never block
+          waiting.pop_back();
+          if (waiting.empty())
+          {
+            m_Waiting.erase(request->Fd);
+          }
+          complete(request, perform_now(request, false));
+        }
+      }
+
+      /// <summary>
+      /// Registers fd for what its waiting requests need, removes it once none are left
+      /// </summary>
+      bool update_interest(int fd, const std::deque<CryoIoRequest*>& waiting)
+      {
+        uint32_t interest = 0;
+        for (CryoIoRequest* request : waiting)
+        {
+          interest |= get_interest(request->Operation);
+        }
+
+        auto registered = m_Registered.find(fd);
+        if (interest == 0)
+        {
+          if (registered != m_Registered.end())
+          {
+            epoll_ctl(m_EpollFd, EPOLL_CTL_DEL, fd, nullptr);
+            m_Registered.erase(registered);
+          }
+          return true;
+        }
+        if (registered != m_Registered.end() && registered->second == interest)
+        {
+          return true;
+        }
+
+        epoll_event event = {};
+        event.events = interest;
+        event.data.fd = fd;
+        if (epoll_ctl(m_EpollFd, registered == m_Registered.end() ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &event) < 0)
+        {
+          return false;
+        }
+        m_Registered[fd] = interest;
+        return true;
+      }
+
+      void on_ready(int fd, uint32_t events)
+      {
+        auto ite = m_Waiting.find(fd);
+        if (ite == m_Waiting.end())
+        {
+          return;
+        }
+
+        // One request per direction, the first one may consume everything that was ready and the next would block
+        auto& waiting = ite->second;
+        uint32_t ready = events & (EPOLLERR | EPOLLHUP) ? (EPOLLIN | EPOLLOUT) : events;
+        for (auto request = waiting.begin(); request != waiting.end() && ready != 0;)
+        {
+          uint32_t interest = get_interest((*request)->Operation);
+          if (!(ready & interest))
+          {
+            ++request;
+            continue;
+          }
+          ready &= ~interest;
+
+          int64_t result = perform_now(*request, true);
+          if (result == -EAGAIN || result == -EWOULDBLOCK)
+          {
+            ++request;
+            continue;
+          }
+          CryoIoRequest* done = *request;
+          request = waiting.erase(request);
+          complete(done, result);
+        }
+
+        update_interest(fd, waiting);
+        if (waiting.empty())
+        {
+          m_Waiting.erase(ite);
+        }
+      }
+
+      void run(std::stop_token stop) override
+      {
+        epoll_event events[64];
+        while (!stop.stop_requested())
+        {
+          for (CryoIoRequest* request : take_incoming())
+          {
+            start_request(request);
+          }
+
+          int timeout = -1;
+          if (!m_Timers.empty())
+          {
+            auto remaining = std::chrono::ceil<std::chrono::milliseconds>(m_Timers.begin()->first - Clock::now());
+            timeout = (int)std::max<int64_t>(0, remaining.count());
+          }
+
+          int count = epoll_wait(m_EpollFd, events, (int)std::size(events), timeout);
+          for (int i = 0; i < count; i++)
+          {
+            if (events[i].data.fd == m_WakeFd)
+            {
+              uint64_t value;
+              (void)!::read(m_WakeFd, &value, sizeof(value));
+              continue;
+            }
+            on_ready(events[i].data.fd, events[i].events);
+          }
+
+          auto now = Clock::now();
+          while (!m_Timers.empty() && m_Timers.begin()->first <= now)
+          {
+            CryoIoRequest* request = m_Timers.begin()->second;
+            m_Timers.erase(m_Timers.begin());
+            complete(request, 0);
+          }
+        }
+      }
+
+      int m_EpollFd = -1;
+      std::unordered_map<int, std::deque<CryoIoRequest*>> m_Waiting;
+      /// Events every registered fd is registered for
+      std::unordered_map<int, uint32_t> m_Registered;
+      std::multimap<Clock::time_point, CryoIoRequest*> m_Timers;
+    };
+
+  }
+#endif
+
+  CryoEventLoop& CryoEventLoop::get()
+  {
+    static CryoEventLoop s_EventLoop;
+    return s_EventLoop;
+  }
+
+  CryoEventLoop::CryoEventLoop()
+  {
+#if CRYO_ASYNC_IO
+    if (s_PreferredBackend == IoBackend::IoUring)
+    {
+      m_Backend = IoUringBackend::create();
+    }
+    if (!m_Backend)
+    {
+      m_Backend = EpollBackend::create();
+    }
+#endif
+  }
+
+  CryoEventLoop::~CryoEventLoop() = default;
+
+  void CryoEventLoop::set_preferred_backend(IoBackend backend)
+  {
+    s_PreferredBackend = backend;
+  }
+
+  const char* CryoEventLoop::get_backend_name() const
+  {
+    return m_Backend ? m_Backend->get_name() : "none";
+  }
+
+  IoCall CryoEventLoop::perform(CryoThread& thread, IoOperation operation, int fd, char* buffer, uint32_t size, uint64_t nanoseconds)
+  {
+    CryoFiber* fiber = thread.get_fiber();
+    if (fiber && fiber->Io.State == IoState::Completed)
+    {
+      fiber->Io.State = IoState::Idle;
+      return IoCall{ false, fiber->Io.Result, fiber->Io.Buffer };
+    }
+    if (!m_Backend)
+    {
+      return IoCall{ false, -ENOSYS, nullptr };
+    }
+
+    CryoIoRequest local;
+    CryoIoRequest& request = fiber ? fiber->Io : local;
+    request.Operation = operation;
+    request.Fd = fd;
+    if (operation == IoOperation::Read)
+    {
+      size = std::min(size, s_MaxReadSize);
+      buffer = new char[size_t(size) + 1];
+    }
+    request.Buffer = buffer;
+    request.Size = size;
+    request.Nanoseconds = nanoseconds;
+    request.Result = 0;
+    request.Fiber = fiber;
+
+    if (fiber)
+    {
+      // CryoScheduler submits it once the fiber is off its worker, so the completion can't resume a fiber that's still running
+      request.State = IoState::Starting;
+      thread.suspend(true);
+      return IoCall{ true };
+    }
+
+    m_Backend->submit(&request);
+    request.Completed.acquire();
+    return IoCall{ false, request.Result, request.Buffer };
+  }
+
+  void CryoEventLoop::submit(CryoIoRequest* request)
+  {
+    m_Backend->submit(request);
+  }
+
+  int CryoEventLoop::open_file(const char* path, uint32_t mode)
+  {
+#if CRYO_ASYNC_IO
+    int flags = mode == 0 ? O_RDONLY : O_WRONLY | O_CREAT | (mode == 2 ? O_APPEND : O_TRUNC);
+    int fd = ::open(path, flags | O_CLOEXEC, 0644);
+    return fd < 0 ? -errno : fd;
+#else
+    return -ENOSYS;
+#endif
+  }
+
+  int CryoEventLoop::close_fd(int fd)
+  {
+#if CRYO_ASYNC_IO
+    return ::close(fd) < 0 ? -errno : 0;
+#else
+    return -ENOSYS;
+#endif
+  }
+
+  int CryoEventLoop::listen_loopback(uint16_t port)
+  {
+#if CRYO_ASYNC_IO
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+      return -errno;
+    }
+
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::bind(fd, (sockaddr*)&address, sizeof(address)) < 0 || ::listen(fd, SOMAXCONN) < 0)
+    {
+      int error = errno;
+      ::close(fd);
+      return -error;
+    }
+    return fd;
+#else
+    return -ENOSYS;
+#endif
+  }
+
+  int CryoEventLoop::connect_loopback(uint16_t port)
+  {
+#if CRYO_ASYNC_IO
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+      return -errno;
+    }
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, (sockaddr*)&address, sizeof(address)) < 0)
+    {
+      int error = errno;
+      ::close(fd);
+      return -error;
+    }
+    return fd;
+#else
+    return -ENOSYS;
+#endif
+  }
+
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <semaphore>
+
+// io_uring and epoll are Linux only, everywhere else the IO IMPLs fail
+#if defined(__linux__) && !defined(CRYO_DISABLE_ASYNC_IO)
+  #define CRYO_ASYNC_IO 1
+#else
+  #define CRYO_ASYNC_IO 0
+#endif
+
+namespace Cryo {
+
+  class CryoThread;
+  struct CryoFiber;
+
+  enum class IoOperation
+  {
+    Read,
+    Write,
+    Accept,
+    Sleep
+  };
+
+  enum class IoBackend
+  {
+    IoUring,
+    Epoll
+  };
+
+  enum class IoState
+  {
+    Idle,
+    /// Requested by an IMPL, CryoScheduler submits it once the fiber is suspended
+    Starting,
+    Submitted,
+    /// The fiber runs the IMPL again and it picks the result up
+    Completed
+  };
+
+  /// <summary>
+  /// Operation in flight on the event loop, owned by the fiber or the thread waiting for it
+  /// </summary>
+  struct CryoIoRequest
+  {
+    IoOperation Operation = IoOperation::Read;
+    int Fd = -1;
+    /// Reads allocate it (Size + 1 bytes, the result is null terminated), writes point it at the data
+    char* Buffer = nullptr;
+    uint32_t Size = 0;
+    uint64_t Nanoseconds = 0;
+
+    /// Bytes transferred, the accepted fd or -errno
+    int64_t Result = 0;
+    IoState State = IoState::Idle;
+
+    /// Fiber resumed once the request completes, threads that aren't fibers wait on Completed instead
+    CryoFiber* Fiber = nullptr;
+    std::binary_semaphore Completed{ 0 };
+
+    /// The io_uring backend's __kernel_timespec of a sleep, the kernel reads it when it starts the timeout
+    int64_t Timeout[2] = {};
+  };
+
+  /// <summary>
+  /// Result of an IO IMPL's call to CryoEventLoop::perform
+  /// </summary>
+  struct IoCall
+  {
+    /// The calling fiber is suspended, the IMPL's return is ignored since the fiber runs it again once the request completed
+    bool Suspended = false;
+    int64_t Result = 0;
+    char* Buffer = nullptr;
+  };
+
+  /// <summary>
+  /// Event loop thread completing the operations of the IO IMPLs, on io_uring when the kernel has it and on epoll otherwise.
+  /// A fiber's operation suspends it until the operation completes, so a single worker keeps any number of them in flight
+  /// </summary>
+  class CryoEventLoop
+  {
+  public:
+    /// Reads return at most this many bytes, the buffer is allocated up front for the size asked
+    static constexpr uint32_t s_MaxReadSize = 16 * 1024 * 1024;
+
+    static CryoEventLoop& get();
+
+    ~CryoEventLoop();
+
+    /// <summary>
+    /// Runs an operation for the calling IMPL. On a fiber the first call starts it and suspends the fiber, the IMPL runs again once
+    /// it completed and gets the result. Threads that aren't fibers block until it completes. Reads are cut to s_MaxReadSize
+    /// </summary>
+    IoCall perform(CryoThread& thread, IoOperation operation, int fd, char* buffer, uint32_t size, uint64_t nanoseconds = 0);
+
+    /// <summary>
+    /// Hands a request to the loop thread, it completes it from there. Safe to call from any thread
+    /// </summary>
+    void submit(CryoIoRequest* request);
+
+    /// <summary>
+    /// Name of the backend in use, "io_uring", "epoll" or "none"
+    /// </summary>
+    const char* get_backend_name() const;
+
+    /// <summary>
+    /// Backend the loop tries first, only has an effect before the loop's first use. io_uring falls back to epoll if the kernel lacks it
+    /// </summary>
+    static void set_preferred_backend(IoBackend backend);
+
+    /// <summary>
+    /// Synchronous helpers of the IO IMPLs, these never block for long so they don't go through the loop
+    /// </summary>
+    /// <param name="mode"> 0 reads, 1 writes creating or truncating the file, 2 appends creating it if needed </param>
+    /// <returns> Returns the fd or -errno </returns>
+    static int open_file(const char* path, uint32_t mode);
+    static int close_fd(int fd);
+    /// <returns> Returns a listening TCP socket on 127.0.0.1:port or -errno </returns>
+    static int listen_loopback(uint16_t port);
+    /// <returns> Returns a TCP socket connected to 127.0.0.1:port or -errno </returns>
+    static int connect_loopback(uint16_t port);
+
+    class Backend;
+
+  private:
+    CryoEventLoop();
+
+    std::unique_ptr<Backend> m_Backend;
+  };
+
+}
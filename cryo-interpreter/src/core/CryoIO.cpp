@@ -0,0 +1,265 @@
+#include "cryopch.h"
+#include "CryoIO.h"
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+#ifdef _WIN32
+  #include <io.h>
+#else
+  #include <signal.h>
+  #include <sys/uio.h>
+  #include <unistd.h>
+#endif
+
+namespace Cryo {
+
+  // Blocks are kept between flushes, so a thread that prints a lot allocates them once
+  static constexpr size_t s_BlockSize = 16 * 1024;
+  // A full set of blocks is flushed even in Full mode, it also keeps a flush under IOV_MAX iovecs
+  static constexpr size_t s_MaxBlocks = 64;
+
+  static std::atomic<BufferMode> s_BufferMode = BufferMode::Line;
+
+  namespace {
+
+    class StreamBuffer
+    {
+    public:
+      StreamBuffer(int fd)
+        : m_Fd(fd)
+      {
+      }
+
+      void append(std::string_view data)
+      {
+        while (!data.empty())
+        {
+          if (m_UsedBlocks == 0 || m_Blocks[m_UsedBlocks - 1].Size == s_BlockSize)
+          {
+            if (m_UsedBlocks == s_MaxBlocks)
+            {
+              flush();
+            }
+            if (m_UsedBlocks == m_Blocks.size())
+            {
+              m_Blocks.emplace_back();
+              m_Blocks.back().Data = std::make_unique<char[]>(s_BlockSize);
+            }
+            m_UsedBlocks++;
+          }
+
+          Block& block = m_Blocks[m_UsedBlocks - 1];
+          size_t count = std::min(data.size(), s_BlockSize - block.Size);
+          std::memcpy(block.Data.get() + block.Size, data.data(), count);
+          block.Size += count;
+          data.remove_prefix(count);
+        }
+      }
+
+      /// <summary>
+      /// Only does async signal safe calls, so the crash handler can use it
+      /// </summary>
+      void flush()
+      {
+#ifdef _WIN32
+        for (size_t i = 0; i < m_UsedBlocks; i++)
+        {
+          _write(m_Fd, m_Blocks[i].Data.get(), (unsigned int)m_Blocks[i].Size);
+          m_Blocks[i].Size = 0;
+        }
+#else
+        iovec batch[s_MaxBlocks];
+        size_t count = 0;
+        for (size_t i = 0; i < m_UsedBlocks; i++)
+        {
+          batch[count++] = { m_Blocks[i].Data.get(), m_Blocks[i].Size };
+          m_Blocks[i].Size = 0;
+        }
+
+        // writev may write only part of the batch, resume from where it stopped
+        iovec* next = batch;
+        while (count != 0)
+        {
+          ssize_t written = writev(m_Fd, next, (int)count);
+          if (written < 0 && errno == EINTR)
+          {
+            continue; // Interrupted before anything was written, a signal handler ran
+          }
+          if (written < 0)
+          {
+            break; // Nothing sensible to report a failed write to, drop the output
+          }
+          while (count != 0 && (size_t)written >= next->iov_len)
+          {
+            written -= next->iov_len;
+            next++;
+            count--;
+          }
+          if (count != 0)
+          {
+            next->iov_base = (char*)next->iov_base + written;
+            next->iov_len -= written;
+          }
+        }
+#endif
+        m_UsedBlocks = 0;
+      }
+
+    private:
+      struct Block
+      {
+        std::unique_ptr<char[]> Data;
+        size_t Size = 0;
+      };
+
+      int m_Fd;
+      std::vector<Block> m_Blocks;
+      size_t m_UsedBlocks = 0;
+    };
+
+    struct ThreadWriter
+    {
+      ThreadWriter();
+      ~ThreadWriter();
+
+      StreamBuffer& get(OutputStream stream) { return stream == OutputStream::Out ? Out : Err; }
+
+      StreamBuffer Out = StreamBuffer(1);
+      StreamBuffer Err = StreamBuffer(2);
+      ThreadWriter* Next = nullptr;
+    };
+
+    // Every live ThreadWriter, so exit and crash handlers can reach the other threads' buffers
+    std::mutex s_WritersMutex;
+    ThreadWriter* s_Writers = nullptr;
+
+    ThreadWriter::ThreadWriter()
+    {
+      std::lock_guard lock(s_WritersMutex);
+      Next = s_Writers;
+      s_Writers = this;
+    }
+
+    ThreadWriter::~ThreadWriter()
+    {
+      Out.flush();
+      Err.flush();
+
+      std::lock_guard lock(s_WritersMutex);
+      for (ThreadWriter** writer = &s_Writers; *writer; writer = &(*writer)->Next)
+      {
+        if (*writer == this)
+        {
+          *writer = Next;
+          break;
+        }
+      }
+    }
+
+    ThreadWriter& get_thread_writer()
+    {
+      static thread_local ThreadWriter s_Writer;
+      return s_Writer;
+    }
+
+    void flush_writers()
+    {
+      for (ThreadWriter* writer = s_Writers; writer; writer = writer->Next)
+      {
+        writer->Out.flush();
+        writer->Err.flush();
+      }
+    }
+
+#ifndef _WIN32
+    constexpr int s_CrashSignals[] = { SIGSEGV, SIGBUS, SIGABRT, SIGFPE, SIGILL };
+    struct sigaction s_PreviousActions[std::size(s_CrashSignals)];
+
+    void on_crash(int signal)
+    {
+      // Best effort, the crashing thread may hold the writers mutex or be in the middle of an append
+      flush_writers();
+
+      // Put the previous handler back, the faulting instruction runs again (or abort raises again) and reaches it
+      for (size_t i = 0; i < std::size(s_CrashSignals); i++)
+      {
+        if (s_CrashSignals[i] == signal)
+        {
+          sigaction(signal, &s_PreviousActions[i], nullptr);
+        }
+      }
+    }
+#endif
+
+  }
+
+  void CryoIO::initialize()
+  {
+    static std::once_flag s_Initialized;
+    std::call_once(s_Initialized, []() {
+      std::atexit(&CryoIO::flush_all);
+
+#ifndef _WIN32
+      for (size_t i = 0; i < std::size(s_CrashSignals); i++)
+      {
+        struct sigaction action = {};
+        action.sa_handler = &on_crash;
+        action.sa_flags = SA_NODEFER;
+        sigemptyset(&action.sa_mask);
+        sigaction(s_CrashSignals[i], &action, &s_PreviousActions[i]);
+      }
+#endif
+    });
+  }
+
+  void CryoIO::set_buffer_mode(BufferMode mode)
+  {
+    s_BufferMode.store(mode, std::memory_order_relaxed);
+  }
+
+  BufferMode CryoIO::get_buffer_mode()
+  {
+    return s_BufferMode.load(std::memory_order_relaxed);
+  }
+
+  void CryoIO::write(OutputStream stream, std::string_view data)
+  {
+    StreamBuffer& buffer = get_thread_writer().get(stream);
+    buffer.append(data);
+    if (get_buffer_mode() == BufferMode::Line && data.find('\n') != std::string_view::npos)
+    {
+      buffer.flush();
+    }
+  }
+
+  void CryoIO::write_line(OutputStream stream, std::string_view data)
+  {
+    StreamBuffer& buffer = get_thread_writer().get(stream);
+    buffer.append(data);
+    buffer.append("\n");
+    if (get_buffer_mode() == BufferMode::Line)
+    {
+      buffer.flush();
+    }
+  }
+
+  void CryoIO::flush()
+  {
+    ThreadWriter& writer = get_thread_writer();
+    writer.Out.flush();
+    writer.Err.flush();
+  }
+
+  void CryoIO::flush_all()
+  {
+    std::lock_guard lock(s_WritersMutex);
+    flush_writers();
+  }
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace Cryo {
+
+  /// <summary>
+  /// When CryoIO writes buffered output out
+  /// </summary>
+  enum class BufferMode
+  {
+    /// Every write that ends a line flushes the thread's buffer, output shows up as soon as it's printed
+    Line,
+    /// Output is only written when a thread's buffer fills up, at flush points, when a fiber suspends or ends, at thread exit, at exit
+    /// and on a crash
+    Full
+  };
+
+  enum class OutputStream
+  {
+    Out,
+    Err
+  };
+
+  /// <summary>
+  /// Output layer of the IMPL functions. Every thread appends to its own buffers without locking and a flush hands every
+  /// pending block of a stream to the OS with a single writev
+  /// </summary>
+  class CryoIO
+  {
+  public:
+    /// <summary>
+    /// Installs the exit and crash handlers that flush every thread's buffers, CryoState and CryoProgram::load call it before any
+    /// thread runs and later calls do nothing. Without it buffers are still flushed when their thread exits
+    /// </summary>
+    static void initialize();
+
+    static void set_buffer_mode(BufferMode mode);
+    static BufferMode get_buffer_mode();
+
+    static void write(OutputStream stream, std::string_view data);
+    /// <summary>
+    /// Writes data and a line break as a single write
+    /// </summary>
+    static void write_line(OutputStream stream, std::string_view data);
+
+    /// <summary>
+    /// Flushes the calling thread's buffers, used before the interpreter writes through std::cout so the output keeps its order
+    /// </summary>
+    static void flush();
+    /// <summary>
+    /// Flushes the buffers of every thread, only safe when no other thread is writing, like at exit
+    /// </summary>
+    static void flush_all();
+  };
+
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// Layout of .crye v2 images, written by the linker (cryo-compiler/src/linker/CryoImage.h mirrors it).
+// Everything is little endian uint32_t words, section offsets are in bytes from the start of the file and every section starts 4 byte aligned.
+//
+// v1 images start with "CRYOEXE\0" followed by the string literals, the function table and the code, each ended by CRYO_BLOCK_END sentinels.
+// Their function records are { signature, code start, instruction count, return size, parameter sizes... }, ended by a CRYO_BLOCK_END each.
+// The layout is frozen, the linker only writes v2 and the interpreter reads v1 as the original linker wrote it.
+// v2 images start with "CRYOEXE\2" and a fixed header that points at every section, so nothing has to be scanned to find them.
+// Version 3 of the header added SECTION_IMPORTS
+
+namespace Cryo {
+
+	constexpr char CRYO_IMAGE_MAGIC_V1[8] = { 'C', 'R', 'Y', 'O', 'E', 'X', 'E', '\0' };
+	constexpr char CRYO_IMAGE_MAGIC_V2[8] = { 'C', 'R', 'Y', 'O', 'E', 'X', 'E', '\2' };
+	constexpr uint32_t CRYO_IMAGE_VERSION = 3;
+
+	enum CryoImageSectionId : uint32_t
+	{
+		/// CryoImageString per string literal, Count: string count
+		SECTION_STRING_TABLE = 0,
+		/// Bytes of every string literal, each one followed by a '\0' so SETSTR can point into it
+		SECTION_STRING_DATA,
+		/// Minimal perfect hash of the function signatures, Count: bucket count. Holds a seed per bucket followed by a function index
+		/// per function, see hash_signature_bucket and hash_signature_slot
+		SECTION_SIGNATURE_INDEX,
+		/// CryoImageFunction per function, Count: function count. Calls by index refer to this order
+		SECTION_FUNCTIONS,
+		/// Parameter sizes of every function and import, CryoImageFunction::ParameterStart and CryoImageImport::ParameterStart index into it
+		SECTION_PARAMETERS,
+		/// CryoImageImport per function called from another image, Count: import count. Calls to them stay calls by signature
+		SECTION_IMPORTS,
+		/// Code of every function, each one followed by a CRYO_BLOCK_END
+		SECTION_CODE,
+
+		SECTION_COUNT
+	};
+
+	struct CryoImageSection
+	{
+		uint32_t Offset = 0;
+		uint32_t Size = 0;
+		uint32_t Count = 0;
+	};
+
+	struct CryoImageHeader
+	{
+		char Magic[8];
+		uint32_t Version = CRYO_IMAGE_VERSION;
+		uint32_t SectionCount = SECTION_COUNT;
+		CryoImageSection Sections[SECTION_COUNT];
+	};
+
+	struct CryoImageString
+	{
+		/// Byte offset into SECTION_STRING_DATA
+		uint32_t Offset = 0;
+		/// Length without the '\0'
+		uint32_t Length = 0;
+	};
+
+	struct CryoImageFunction
+	{
+		/// String literal index
+		uint32_t Signature = 0;
+		/// Word index of the function's code from the start of the file, like in v1
+		uint32_t CodeStart = 0;
+		uint32_t InstructionCount = 0;
+		uint32_t ReturnSize = 0;
+		uint32_t FrameSize = 0;
+		/// CryoFunctionFlags
+		uint32_t Flags = 0;
+		uint32_t ParameterStart = 0;
+		uint32_t ParameterCount = 0;
+	};
+
+	struct CryoImageImport
+	{
+		/// String literal index of the imported function's signature
+		uint32_t Signature = 0;
+		/// String literal index of the path of the image that defines it, relative to the importing image's folder
+		uint32_t Library = 0;
+		/// Return and parameter sizes the importing image was linked against, the interpreter checks the library still matches when it binds the import
+		uint32_t ReturnSize = 0;
+		uint32_t ParameterStart = 0;
+		uint32_t ParameterCount = 0;
+	};
+
+	// SECTION_SIGNATURE_INDEX is a hash and displace minimal perfect hash, the linker must produce the same values.
+	// A signature hashes once, the high half of the hash picks a bucket and the bucket's seed scrambles the whole hash into a slot.
+	// The linker picks every bucket's seed so no two signatures share a slot, a lookup is two hashes, two loads and one compare
+
+	/// <summary>
+	/// 64 bit FNV-1a
+	/// </summary>
+	constexpr uint64_t hash_signature(std::string_view signature)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (char c : signature)
+		{
+			hash = (hash ^ (uint8_t)c) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+	constexpr uint32_t hash_signature_bucket(uint64_t hash, uint32_t bucket_count)
+	{
+		return uint32_t(hash >> 32) % bucket_count;
+	}
+
+	constexpr uint32_t hash_signature_slot(uint64_t hash, uint32_t seed, uint32_t slot_count)
+	{
+		// MurmurHash3's 64 bit finalizer
+		uint64_t x = hash ^ (seed * 0x9E3779B97F4A7C15ull);
+		x ^= x >> 33;
+		x *= 0xFF51AFD7ED558CCDull;
+		x ^= x >> 33;
+		x *= 0xC4CEB9FE1A85EC53ull;
+		x ^= x >> 33;
+		return uint32_t(x % slot_count);
+	}
+
+}
@@ -21,13 +21,186 @@ namespace Cryo {
     SETU32   = 0x0000005,
     SETSTR   = 0x0000006,
 
+		/// Copy: 4 bytes opcode, 4 bytes uint for the destination and source variable indices
+    MOVU32 = 0x00000007,
+		/// Three address arithmetic: 4 bytes opcode, 4 bytes uint for the destination and both source variable indices
+    ADDU32 = 0x00000008,
+    SUBU32 = 0x00000009,
+    MULU32 = 0x0000000A,
+
+		/// Atomics on a @uint32 variable, or on the @uint32 a @void* variable points to. Their last 4 bytes uint is a CryoMemoryOrder,
+		/// with ATOMIC_HEAP set when the slot variable is a @void*
+		/// Load: 4 bytes opcode, 4 bytes uint for the destination and slot variable indices, 4 bytes order
+    ATOMIC_LOAD  = 0x0000000B,
+		/// Store: 4 bytes opcode, 4 bytes uint for the slot and source variable indices, 4 bytes order
+    ATOMIC_STORE = 0x0000000C,
+		/// Fetch add: 4 bytes opcode, 4 bytes uint for the destination, which gets the slot's previous value, slot and source variable indices, 4 bytes order
+    ATOMIC_ADD   = 0x0000000D,
+		/// Compare exchange: 4 bytes opcode, 4 bytes uint for the slot, expected and desired variable indices, 4 bytes order.
+		/// Expected gets the value the slot held, so it's unchanged only if the exchange happened
+    ATOMIC_CAS   = 0x0000000E,
+		/// Fence: 4 bytes opcode, 4 bytes order
+    FENCE        = 0x0000000F,
+
 		/// Return: 4 bytes opcode
 		RETURN = 0x01000000,
-		/// Call function in the same assembly as the caller function, 4 bytes opcode, 4 bytes uint for function index
+		/// Call function in the same assembly as the caller function, 4 bytes opcode, 4 bytes uint for the callee's index in the function table, emitted by the linker
 		CALL_from_assembly_index = 0x02000000,
 		/// Call function in the same assembly as the caller function, 4 bytes opcode, 4 bytes uint for string literal index for the signature
 		CALL_from_assembly_signature = 0x03000000,
-    IMPL = 0x04000000
+    IMPL = 0x04000000,
+
+		/// Register format CALL and IMPL, same operands as the stack format ones plus 4 bytes uint for the offset of the callee's frame in the caller's
+    CALLR_from_assembly_index = 0x05000000,
+    CALLR_from_assembly_signature = 0x06000000,
+    IMPLR = 0x07000000
+	};
+
+	/// <summary>
+	/// Flags stored in a function's declaration
+	/// </summary>
+	enum CryoFunctionFlags : uint32_t
+	{
+		/// Code has no stack layout instructions, variables are fixed frame slots and calls carry the callee's frame offset
+		FUNCTION_REGISTER_FORMAT = 0x00000001
+	};
+
+	/// <summary>
+	/// Memory order operand of the atomic instructions, the C++ orders without consume
+	/// </summary>
+	enum CryoMemoryOrder : uint32_t
+	{
+		MEMORY_ORDER_RELAXED = 0,
+		MEMORY_ORDER_ACQUIRE = 1,
+		MEMORY_ORDER_RELEASE = 2,
+		MEMORY_ORDER_ACQ_REL = 3,
+		MEMORY_ORDER_SEQ_CST = 4
 	};
 
+	/// <summary>
+	/// Set in an atomic instruction's order operand when its slot is a @void* pointing at the @uint32
+	/// </summary>
+	constexpr uint32_t ATOMIC_HEAP = 0x00000010;
+
+	/// <summary>
+	/// Loads can't release and stores can't acquire, like std::atomic
+	/// </summary>
+	constexpr bool is_valid_memory_order(uint32_t opcode, uint32_t order)
+	{
+		switch (opcode)
+		{
+		case ATOMIC_LOAD:  return order == MEMORY_ORDER_RELAXED || order == MEMORY_ORDER_ACQUIRE || order == MEMORY_ORDER_SEQ_CST;
+		case ATOMIC_STORE: return order == MEMORY_ORDER_RELAXED || order == MEMORY_ORDER_RELEASE || order == MEMORY_ORDER_SEQ_CST;
+		default:           return order <= MEMORY_ORDER_SEQ_CST;
+		}
+	}
+
+	/// <summary>
+	/// Marks the end of a block in a CryoAssembly, every function's code is followed by one
+	/// </summary>
+	constexpr uint32_t CRYO_BLOCK_END = 0xFFFFFFFF;
+
+	struct CryoFunction;
+	struct CryoImport;
+	struct ImplFunction;
+
+	/// <summary>
+	/// Opcodes of the pre-decoded instruction stream CryoThread executes, dense so they index the dispatch table directly
+	/// </summary>
+	enum CryoDecodedOpcode : uint32_t
+	{
+		/// Block end after a function's code, reached only if the function lacks a RETURN
+		OP_END = 0,
+		OP_STLS,
+		OP_STLE,
+		/// Operand: size
+		OP_PUSH,
+		/// Operand: variable count
+		OP_POP,
+		/// Operand: variable index, Value: value
+		OP_SETU32,
+		/// Operand: variable index, String: string literal
+		OP_SETSTR,
+		/// Operand: destination variable index, Slots[0]: source variable index
+		OP_MOVU32,
+		/// Operand: destination variable index, Slots: source variable indices
+		OP_ADDU32,
+		OP_SUBU32,
+		OP_MULU32,
+		OP_RETURN,
+		/// Function: callee, both CALL forms decode into it, Operand: offset of the callee's frame in verified assemblies
+		OP_CALL,
+		/// Impl: native function, Operand: offset of the callee's frame in verified assemblies
+		OP_IMPL,
+		/// Import: function of a library, Operand: like OP_CALL. Every call loads the import's bound callee, the first one to find none binds it
+		OP_CALL_IMPORT,
+
+		// Atomics, Operand: the slot's offset in the low 24 bits and the order operand, ATOMIC_HEAP included, in the top 8 bits
+
+		/// Slots[0]: destination variable index
+		OP_ATOMIC_LOAD,
+		/// Slots[0]: source variable index
+		OP_ATOMIC_STORE,
+		/// Slots[0]: destination variable index, Slots[1]: source variable index
+		OP_ATOMIC_ADD,
+		/// Slots[0]: expected variable index, Slots[1]: desired variable index
+		OP_ATOMIC_CAS,
+		/// Operand: order operand in the top 8 bits
+		OP_FENCE,
+
+		// Superinstructions, fused by the loader in verified assemblies. They replace the opcode of the first instruction of the sequence
+		// and run the following slots as well, which keep their own opcode and operands
+
+		/// SETU32; SETU32
+		OP_SETU32_SETU32,
+		/// SETU32; CALL
+		OP_SETU32_CALL,
+		/// SETSTR; IMPL
+		OP_SETSTR_IMPL,
+
+		OP_COUNT
+	};
+
+	constexpr const char* s_DecodedOpcodeNames[OP_COUNT] =
+	{
+		"END", "STLS", "STLE", "PUSH", "POP", "SETU32", "SETSTR", "MOVU32", "ADDU32", "SUBU32", "MULU32", "RETURN", "CALL", "IMPL", "CALL_IMPORT",
+		"ATOMIC_LOAD", "ATOMIC_STORE", "ATOMIC_ADD", "ATOMIC_CAS", "FENCE",
+		"SETU32_SETU32", "SETU32_CALL", "SETSTR_IMPL"
+	};
+
+	constexpr const char* get_opcode_name(CryoDecodedOpcode opcode) { return opcode < OP_COUNT ? s_DecodedOpcodeNames[opcode] : "UNKNOWN"; }
+
+	/// <summary>
+	/// Number of instruction slots a single dispatch of opcode runs
+	/// </summary>
+	constexpr uint32_t get_instruction_slots(CryoDecodedOpcode opcode) { return opcode >= OP_SETU32_SETU32 && opcode < OP_COUNT ? 2 : 1; }
+
+	/// <summary>
+	/// Largest slot offset an atomic instruction can pack into its Operand
+	/// </summary>
+	constexpr uint32_t ATOMIC_OFFSET_MASK = 0x00FFFFFF;
+
+	constexpr uint32_t pack_atomic_operand(uint32_t offset, uint32_t order) { return offset | (order << 24); }
+	constexpr uint32_t get_atomic_offset(uint32_t operand) { return operand & ATOMIC_OFFSET_MASK; }
+	constexpr uint32_t get_atomic_order(uint32_t operand) { return operand >> 24; }
+
+	/// <summary>
+	/// Instruction with every operand resolved when the CryoAssembly is loaded, so executing it needs no lookups
+	/// </summary>
+	struct CryoInstruction
+	{
+		CryoDecodedOpcode Opcode = OP_END;
+		uint32_t Operand = 0;
+		union
+		{
+			uint32_t Value = 0;
+			uint32_t Slots[2];
+			const char* String;
+			const CryoFunction* Function;
+			const ImplFunction* Impl;
+			const CryoImport* Import;
+		};
+	};
+
+
 }
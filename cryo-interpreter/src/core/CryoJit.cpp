@@ -0,0 +1,206 @@
+#include "cryopch.h"
+#include "CryoJit.h"
+
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#if CRYO_JIT
+  #include <sys/mman.h>
+  #include <unistd.h>
+#endif
+
+namespace Cryo {
+
+#if CRYO_JIT
+  namespace {
+
+    // Every native function is mapped on its own pages and starts with the size of the mapping, so release needs no bookkeeping
+    struct NativeCodeHeader
+    {
+      size_t MappingSize;
+      size_t Padding; // Keeps the code 16 byte aligned
+    };
+
+    /// <summary>
+    /// Appends x86-64 templates for the frame accesses of the interpreter handlers, the frame base lives in rdi for the whole function
+    /// </summary>
+    class TemplateEmitter
+    {
+    public:
+      // mov dword [rdi + index], value
+      void setu32(uint32_t index, uint32_t value)
+      {
+        bytes({ 0xC7, 0x87 });
+        u32(index);
+        u32(value);
+      }
+
+      // mov rax, value; mov [rdi + index], rax
+      void setptr(uint32_t index, const void* value)
+      {
+        bytes({ 0x48, 0xB8 });
+        u64((uint64_t)value);
+        bytes({ 0x48, 0x89, 0x87 });
+        u32(index);
+      }
+
+      // mov eax, [rdi + index]
+      void load_eax(uint32_t index)
+      {
+        bytes({ 0x8B, 0x87 });
+        u32(index);
+      }
+
+      // mov [rdi + index], eax
+      void store_eax(uint32_t index)
+      {
+        bytes({ 0x89, 0x87 });
+        u32(index);
+      }
+
+      // add eax, [rdi + index]
+      void add_eax(uint32_t index)
+      {
+        bytes({ 0x03, 0x87 });
+        u32(index);
+      }
+
+      // sub eax, [rdi + index]
+      void sub_eax(uint32_t index)
+      {
+        bytes({ 0x2B, 0x87 });
+        u32(index);
+      }
+
+      // imul eax, [rdi + index]
+      void mul_eax(uint32_t index)
+      {
+        bytes({ 0x0F, 0xAF, 0x87 });
+        u32(index);
+      }
+
+      void ret() { bytes({ 0xC3 }); }
+
+      const std::vector<uint8_t>& get_code() const { return m_Code; }
+
+    private:
+      void bytes(std::initializer_list<uint8_t> values) { m_Code.insert(m_Code.end(), values); }
+      void u32(uint32_t value) { m_Code.insert(m_Code.end(), (uint8_t*)&value, (uint8_t*)&value + sizeof(value)); }
+      void u64(uint64_t value) { m_Code.insert(m_Code.end(), (uint8_t*)&value, (uint8_t*)&value + sizeof(value)); }
+
+      std::vector<uint8_t> m_Code;
+    };
+
+    /// <returns> Returns false if func uses an instruction without a template </returns>
+    bool emit_function(const CryoFunction* func, TemplateEmitter& emitter)
+    {
+      // Cryo code has no jumps yet, so the first RETURN ends the function
+      for (const CryoInstruction* pc = func->Code; pc->Opcode != OP_END; pc++)
+      {
+        switch (pc->Opcode)
+        {
+        // Superinstructions are split back into their slots, the first slot keeps the operands of the first instruction
+        case OP_SETU32:
+        case OP_SETU32_SETU32:
+        case OP_SETU32_CALL:
+          emitter.setu32(pc->Operand, pc->Value);
+          break;
+
+        case OP_SETSTR:
+        case OP_SETSTR_IMPL:
+          emitter.setptr(pc->Operand, pc->String);
+          break;
+
+        case OP_MOVU32:
+          emitter.load_eax(pc->Slots[0]);
+          emitter.store_eax(pc->Operand);
+          break;
+
+        case OP_ADDU32:
+          emitter.load_eax(pc->Slots[0]);
+          emitter.add_eax(pc->Slots[1]);
+          emitter.store_eax(pc->Operand);
+          break;
+
+        case OP_SUBU32:
+          emitter.load_eax(pc->Slots[0]);
+          emitter.sub_eax(pc->Slots[1]);
+          emitter.store_eax(pc->Operand);
+          break;
+
+        case OP_MULU32:
+          emitter.load_eax(pc->Slots[0]);
+          emitter.mul_eax(pc->Slots[1]);
+          emitter.store_eax(pc->Operand);
+          break;
+
+        case OP_RETURN:
+          emitter.ret();
+          return true;
+
+        default: // CALL and IMPL need the interpreter's call stack, atomics have no templates yet and stack layout instructions never reach verified code
+          return false;
+        }
+      }
+
+      return false; // No RETURN, leave it to the interpreter to report
+    }
+
+  }
+
+  bool CryoJit::compile(const CryoFunction* func)
+  {
+    if (get_native_code(func))
+    {
+      return true;
+    }
+    if (!func->OwnerAssembly || !func->OwnerAssembly->is_verified() || !func->Code)
+    {
+      return false;
+    }
+
+    TemplateEmitter emitter;
+    if (!emit_function(func, emitter))
+    {
+      std::atomic_ref<uint32_t>(func->CallCount).store(s_Uncompilable, std::memory_order_relaxed);
+      return false;
+    }
+
+    const std::vector<uint8_t>& code = emitter.get_code();
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t mapping_size = ((sizeof(NativeCodeHeader) + code.size() + page_size - 1) / page_size) * page_size;
+
+    // Written while writable, then flipped to executable, the pages are never writable and executable at once
+    void* memory = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+      return false;
+    }
+    ((NativeCodeHeader*)memory)->MappingSize = mapping_size;
+    std::memcpy((uint8_t*)memory + sizeof(NativeCodeHeader), code.data(), code.size());
+    if (mprotect(memory, mapping_size, PROT_READ | PROT_EXEC) != 0)
+    {
+      munmap(memory, mapping_size);
+      return false;
+    }
+
+    std::atomic_ref<NativeFunction>(func->NativeCode).store((NativeFunction)((uint8_t*)memory + sizeof(NativeCodeHeader)), std::memory_order_release);
+    return true;
+  }
+
+  void CryoJit::release(const CryoFunction* func)
+  {
+    NativeFunction native = std::atomic_ref<NativeFunction>(func->NativeCode).exchange(nullptr, std::memory_order_acq_rel);
+    if (native)
+    {
+      NativeCodeHeader* header = (NativeCodeHeader*)((uint8_t*)native - sizeof(NativeCodeHeader));
+      munmap(header, header->MappingSize);
+    }
+  }
+#else
+  bool CryoJit::compile(const CryoFunction* func) { return false; }
+  void CryoJit::release(const CryoFunction* func) {}
+#endif
+
+}
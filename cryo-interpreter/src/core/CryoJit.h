@@ -0,0 +1,65 @@
+#pragma once
+
+#include "CryoAssembly.h"
+
+#include <atomic>
+#include <cstdint>
+
+// The templates are x86-64 machine code and the code buffers are mmap'd, everything else only interprets
+#if defined(__linux__) && defined(__x86_64__) && !defined(CRYO_DISABLE_JIT)
+  #define CRYO_JIT 1
+#else
+  #define CRYO_JIT 0
+#endif
+
+namespace Cryo {
+
+  /// <summary>
+  /// Baseline template JIT for verified assemblies. Every instruction of a function is turned into a fixed machine code template
+  /// with its operands patched in, frame accesses become loads and stores relative to the frame base passed in rdi.
+  /// Only leaf functions made of SET, MOV, arithmetic and RETURN instructions are compiled. CALL and IMPL need the interpreter's
+  /// call stack and atomics have no templates, functions using them stay interpreted and stop being counted
+  /// </summary>
+  class CryoJit
+  {
+  public:
+    /// <summary>
+    /// Compiles func and publishes the result in its NativeCode, threads calling it pick the native code up on their next CALL
+    /// </summary>
+    /// <returns> Returns true if func has native code, false if it uses an instruction without a template, which marks it uncompilable </returns>
+    static bool compile(const CryoFunction* func);
+
+    /// <summary>
+    /// Unmaps the native code of func, the owning assembly calls it when it's destroyed and nothing can be running the code anymore
+    /// </summary>
+    static void release(const CryoFunction* func);
+
+    /// <summary>
+    /// Used by CALL to pick up native code published by another thread
+    /// </summary>
+    static NativeFunction get_native_code(const CryoFunction* func)
+    {
+      // Acquire pairs with the release in compile, a thread that sees the pointer sees the finished code
+      return std::atomic_ref<NativeFunction>(func->NativeCode).load(std::memory_order_acquire);
+    }
+
+    /// <summary>
+    /// Counts a call of func, calls past the threshold and calls of uncompilable functions are only a load
+    /// </summary>
+    /// <returns> Returns true for exactly the call that reaches threshold, that call is the one that compiles func </returns>
+    static bool count_call(const CryoFunction* func, uint32_t threshold)
+    {
+      std::atomic_ref<uint32_t> count(func->CallCount);
+      if (count.load(std::memory_order_relaxed) >= threshold)
+      {
+        return false;
+      }
+      return count.fetch_add(1, std::memory_order_relaxed) + 1 == threshold;
+    }
+
+  private:
+    /// CallCount of functions compile gave up on, above any threshold
+    static constexpr uint32_t s_Uncompilable = UINT32_MAX;
+  };
+
+}
@@ -0,0 +1,73 @@
+#include "cryopch.h"
+#include "CryoLibraries.h"
+
+#include <atomic>
+
+namespace Cryo {
+
+	const CryoFunction* CryoLibraries::bind_import(const CryoImport& imported, const CryoAssembly& importer)
+	{
+		std::lock_guard lock(m_Mutex);
+		return bind(imported, importer);
+	}
+
+	const CryoFunction* CryoLibraries::bind(const CryoImport& imported, const CryoAssembly& importer)
+	{
+		// Another thread may have bound it while this one waited for the lock
+		if (const CryoFunction* bound = std::atomic_ref<const CryoFunction*>(imported.Bound).load(std::memory_order_relaxed))
+		{
+			return bound;
+		}
+
+		std::filesystem::path path = (importer.get_path().parent_path() / imported.Library).lexically_normal();
+		auto& library = m_Libraries[std::pair(path, importer.is_verified())];
+		if (!library)
+		{
+			library = load(path, importer.is_verified());
+			if (!library)
+			{
+				m_Libraries.erase(std::pair(path, importer.is_verified()));
+				return nullptr;
+			}
+		}
+
+		const CryoFunction* callee = library->get_function_by_signature(imported.Declaration.FunctionSignature);
+		if (!callee || callee->ReturnTypeSize != imported.Declaration.ReturnTypeSize || callee->ParameterSizes != imported.Declaration.ParameterSizes)
+		{
+			std::cout << "Library at [" << path.string() << "] doesn't define [" << imported.Declaration.FunctionSignature << "] the way CryoAssembly at ["
+				<< importer.get_path().string() << "] was linked against!" << std::endl;
+			return nullptr;
+		}
+
+		// Threads calling the import without the lock must see the loaded library once they see the callee
+		std::atomic_ref<const CryoFunction*>(imported.Bound).store(callee, std::memory_order_release);
+		return callee;
+	}
+
+	std::unique_ptr<CryoAssembly> CryoLibraries::load(const std::filesystem::path& path, bool verified)
+	{
+		CryoLoadOptions options;
+		options.ExternalCalls = true;
+		options.Libraries = this;
+
+		auto library = std::make_unique<CryoAssembly>(path, options);
+		if (!library->is_valid() || !library->link(m_Symbols))
+		{
+			return nullptr;
+		}
+		if (verified && !library->verify())
+		{
+			std::cout << "Library at [" << path.string() << "] failed verification, it can't be called from verified assemblies!" << std::endl;
+			return nullptr;
+		}
+		if (!library->finish_load(verified))
+		{
+			return nullptr;
+		}
+
+		// Only defined once it can run, so no other library links against one that failed
+		library->define_symbols(m_Symbols);
+		return library;
+	}
+
+}
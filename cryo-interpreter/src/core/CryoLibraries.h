@@ -0,0 +1,52 @@
+#pragma once
+
+#include "CryoAssembly.h"
+#include "CryoSymbolTable.h"
+
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace Cryo {
+
+	/// <summary>
+	/// Libraries loaded on demand by the imports of a CryoState's assemblies. A library is only mapped, decoded and verified the first time
+	/// one of its functions is called, and every import is bound once, so a program only pays for the libraries it actually uses
+	/// </summary>
+	class CryoLibraries
+	{
+	public:
+		/// <summary>
+		/// Binds an import of importer, loading its library if needed. Safe to call from several threads at once, an import some other
+		/// thread already bound returns the same function
+		/// </summary>
+		/// <returns> Returns nullptr if the library failed to load or doesn't define the function the way importer was linked against </returns>
+		const CryoFunction* bind_import(const CryoImport& imported, const CryoAssembly& importer);
+
+		/// <summary>
+		/// Lock free check used by every OP_CALL_IMPORT, the acquire pairs with the release in bind so the callee is fully loaded once seen
+		/// </summary>
+		/// <returns> Returns nullptr until the import is bound </returns>
+		static const CryoFunction* get_bound(const CryoImport& imported)
+		{
+			return std::atomic_ref<const CryoFunction*>(imported.Bound).load(std::memory_order_acquire);
+		}
+
+	private:
+		const CryoFunction* bind(const CryoImport& imported, const CryoAssembly& importer);
+		/// <summary>
+		/// Loads, links and finishes a library so it runs the same way as the assemblies calling into it
+		/// </summary>
+		std::unique_ptr<CryoAssembly> load(const std::filesystem::path& path, bool verified);
+
+		std::mutex m_Mutex;
+		/// Functions of every library loaded so far, a library's calls into another one resolve through it
+		CryoSymbolTable m_Symbols;
+		/// By path and by whether it runs verified, a thread runs every function it reaches the same way
+		std::map<std::pair<std::filesystem::path, bool>, std::unique_ptr<CryoAssembly>> m_Libraries;
+	};
+
+}
@@ -0,0 +1,81 @@
+#include "cryopch.h"
+#include "CryoProgram.h"
+
+#include "CryoIO.h"
+
+#include <atomic>
+#include <thread>
+
+namespace Cryo {
+
+	std::shared_ptr<const CryoProgram> CryoProgram::load(const std::vector<std::filesystem::path>& paths, const CryoLoadOptions& options)
+	{
+		// Embedders may never create a CryoState, the program is the first thing they load
+		CryoIO::initialize();
+
+		std::shared_ptr<CryoProgram> program(new CryoProgram());
+		if (!program->load_assemblies(paths, options))
+		{
+			return nullptr;
+		}
+		return program;
+	}
+
+	bool CryoProgram::load_assemblies(const std::vector<std::filesystem::path>& paths, CryoLoadOptions options)
+	{
+		options.ExternalCalls = true;
+		options.Libraries = &m_Libraries;
+
+		// Mapping, reading and decoding only touch the assembly itself, so independent assemblies load on their own threads
+		m_Assemblies.resize(paths.size());
+		size_t worker_count = std::min<size_t>(paths.size(), std::max(1u, std::thread::hardware_concurrency()));
+		std::atomic<size_t> next_path = 0;
+		auto load = [&]() {
+			for (size_t i = next_path++; i < paths.size(); i = next_path++)
+			{
+				m_Assemblies[i] = std::make_unique<CryoAssembly>(paths[i], options);
+			}
+		};
+		{
+			std::vector<std::jthread> workers;
+			for (size_t i = 1; i < worker_count; i++) { workers.emplace_back(load); }
+			load();
+		}
+
+		for (const auto& assembly : m_Assemblies)
+		{
+			if (!assembly->is_valid())
+			{
+				return false;
+			}
+		}
+
+		// Calls resolve once, here, every CALL into another assembly holds the callee's CryoFunction afterwards
+		for (const auto& assembly : m_Assemblies) { assembly->define_symbols(m_Symbols); }
+		for (const auto& assembly : m_Assemblies)
+		{
+			if (!assembly->link(m_Symbols))
+			{
+				return false;
+			}
+		}
+
+		// A thread runs every function it reaches the same way, so the assemblies only run verified if all of them passed
+		bool verified = true;
+		for (const auto& assembly : m_Assemblies) { verified &= assembly->verify(); }
+		if (!verified && options.Verify && m_Assemblies.size() > 1)
+		{
+			std::cout << "Warning: not every assembly passed verification, running all of them with runtime checks!" << std::endl;
+		}
+		for (const auto& assembly : m_Assemblies)
+		{
+			if (!assembly->finish_load(verified))
+			{
+				return false;
+			}
+		}
+
+		return !m_Assemblies.empty();
+	}
+
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "CryoAssembly.h"
+#include "CryoLibraries.h"
+#include "CryoSymbolTable.h"
+#include "ImplRegistry.h"
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Cryo {
+
+	template <typename F>
+	class CryoFunctionHandle;
+
+	/// <summary>
+	/// Function of a CryoProgram bound to a C++ function type once, calls through it need no signature lookup
+	/// </summary>
+	template <typename R, typename... Args>
+	class CryoFunctionHandle<R(Args...)>
+	{
+	public:
+		CryoFunctionHandle() = default;
+
+		bool is_valid() const { return m_Function != nullptr; }
+		const CryoFunction* get() const { return m_Function; }
+
+	private:
+		explicit CryoFunctionHandle(const CryoFunction* func)
+			: m_Function(func)
+		{
+		}
+
+		const CryoFunction* m_Function = nullptr;
+
+		friend class CryoProgram;
+	};
+
+	/// <summary>
+	/// Assemblies loaded and linked together, immutable once loaded so one program can be shared by every thread and CryoContext running it.
+	/// Libraries bound lazily and CryoJit state are the only things that change afterwards, both synchronize themselves
+	/// </summary>
+	class CryoProgram
+	{
+	public:
+		/// <summary>
+		/// Loads every assembly in parallel, then links them through the program's symbol table and verifies them as a whole
+		/// </summary>
+		/// <param name="paths"> The first assembly has the entry point, the others are libraries it calls into </param>
+		/// <returns> Returns nullptr if any assembly failed to load or link </returns>
+		static std::shared_ptr<const CryoProgram> load(const std::vector<std::filesystem::path>& paths, const CryoLoadOptions& options = {});
+
+		CryoProgram(const CryoProgram&) = delete;
+		CryoProgram& operator=(const CryoProgram&) = delete;
+
+		/// <summary>
+		/// $void::main::void of the first assembly
+		/// </summary>
+		/// <returns> Returns nullptr if it doesn't have one </returns>
+		const CryoFunction* get_entry_point() const { return m_Assemblies[0]->get_function_by_signature("$void::main::void"); }
+
+		/// <summary>
+		/// Used to retrieve a function of any of the program's assemblies by its signature
+		/// </summary>
+		/// <returns> Returns a pointer to the function if it finds it, nullptr if it doesn't </returns>
+		const CryoFunction* get_function_by_signature(std::string_view signature) const { return m_Symbols.find(signature); }
+
+		/// <summary>
+		/// Binds a function to the C++ function type F, its signature is built from name and F like the ones of IMPL functions
+		/// </summary>
+		/// <returns> Returns an invalid handle if the program doesn't define the function or its frame doesn't match F </returns>
+		template <typename F>
+		CryoFunctionHandle<F> get_function(std::string_view name) const { return bind_handle(name, (F*)nullptr); }
+
+		const std::vector<std::unique_ptr<CryoAssembly>>& get_assemblies() const { return m_Assemblies; }
+
+	private:
+		CryoProgram() = default;
+
+		bool load_assemblies(const std::vector<std::filesystem::path>& paths, CryoLoadOptions options);
+
+		template <typename R, typename... Args>
+		CryoFunctionHandle<R(Args...)> bind_handle(std::string_view name, R (*)(Args...)) const
+		{
+			std::string signature = "$" + std::string(CryoType<R>::Name) + "::" + std::string(name);
+			if constexpr (sizeof...(Args) == 0)
+			{
+				signature += "::void";
+			}
+			((signature += "::", signature += CryoType<Args>::Name), ...);
+
+			const CryoFunction* func = get_function_by_signature(signature);
+			if (!func || func->ReturnTypeSize != CryoType<R>::Size || func->ParameterSizes != std::vector<uint32_t>{ CryoType<Args>::Size... })
+			{
+				return CryoFunctionHandle<R(Args...)>();
+			}
+			return CryoFunctionHandle<R(Args...)>(func);
+		}
+
+		/// Libraries loaded by the imports of m_Assemblies, on their first call
+		CryoLibraries m_Libraries;
+		/// Functions hold pointers to their assembly and to each other, so assemblies never move
+		std::vector<std::unique_ptr<CryoAssembly>> m_Assemblies;
+		CryoSymbolTable m_Symbols;
+	};
+
+}
@@ -0,0 +1,399 @@
+#include "cryopch.h"
+#include "CryoScheduler.h"
+#include "CryoChannel.h"
+#include "CryoIO.h"
+
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <utility>
+
+namespace Cryo {
+
+	// Index of the worker the calling thread is, SIZE_MAX on threads that aren't workers
+	static thread_local size_t s_WorkerIndex = SIZE_MAX;
+
+	uint32_t CryoFiberGroup::add(std::unique_ptr<CryoFiber> fiber)
+	{
+		std::lock_guard lock(Mutex);
+		if (LastHandle == UINT32_MAX)
+		{
+			throw std::logic_error("Fatal Error: an execution spawned more than UINT32_MAX fibers!");
+		}
+		Pending++;
+		fiber->Handle = ++LastHandle;
+		Fibers.emplace(LastHandle, std::move(fiber));
+		return LastHandle;
+	}
+
+	void CryoFiberGroup::done()
+	{
+		std::lock_guard lock(Mutex);
+		if (--Pending == 0)
+		{
+			Finished.notify_all();
+		}
+	}
+
+	void CryoFiberGroup::wait()
+	{
+		std::unique_lock lock(Mutex);
+		Finished.wait(lock, [&]() { return Pending == 0; });
+	}
+
+	std::shared_ptr<CryoFiber> CryoFiberGroup::get(uint32_t handle)
+	{
+		std::lock_guard lock(Mutex);
+		auto ite = Fibers.find(handle);
+		return ite != Fibers.end() ? ite->second : nullptr;
+	}
+
+	void CryoFiberGroup::release(uint32_t handle)
+	{
+		std::shared_ptr<CryoFiber> fiber;
+		std::lock_guard lock(Mutex);
+		auto ite = Fibers.find(handle);
+		if (ite != Fibers.end())
+		{
+			// Freed past the lock, so a fiber's destructor never runs with it held
+			fiber = std::move(ite->second);
+			Fibers.erase(ite);
+		}
+	}
+
+	CryoScheduler& CryoScheduler::get()
+	{
+		static CryoScheduler s_Scheduler;
+		return s_Scheduler;
+	}
+
+	CryoScheduler::CryoScheduler()
+	{
+		size_t worker_count = std::max(1u, std::thread::hardware_concurrency());
+		for (size_t i = 0; i < worker_count; i++)
+		{
+			m_Workers.emplace_back(std::make_unique<Worker>());
+		}
+		for (size_t i = 0; i < worker_count; i++)
+		{
+			m_Threads.emplace_back([this, i](std::stop_token stop) { work(stop, i); });
+		}
+	}
+
+	CryoScheduler::~CryoScheduler()
+	{
+		// Stops and joins the workers, every execution already waited for the fibers it spawned
+		m_Threads.clear();
+	}
+
+	uint32_t CryoScheduler::spawn(CryoThread& thread, std::string_view signature, uint32_t argument)
+	{
+		const CryoFunction* func = thread.m_CurrentFunction->OwnerAssembly->get_function_by_signature(signature);
+		if (!func || func->ReturnTypeSize != 4 || func->ParameterSizes != std::vector<uint32_t>{ 4 })
+		{
+			throw std::logic_error(std::format("Fatal Error: fiber_spawn expects a $uint32::{{name}}::uint32 function of the running assembly, [{}] isn't one!", signature));
+		}
+
+		if (!thread.m_FiberGroup)
+		{
+			thread.m_FiberGroup = std::make_shared<CryoFiberGroup>();
+		}
+
+		auto fiber = std::make_unique<CryoFiber>();
+		fiber->Entry = func;
+		fiber->Argument = argument;
+		fiber->Dispatch = thread.get_dispatch_mode();
+		fiber->JitThreshold = thread.get_jit_threshold();
+		fiber->FuelSlice = thread.get_fuel_slice();
+		fiber->FuelBudget = thread.get_fuel_budget();
+		fiber->Group = thread.m_FiberGroup;
+
+		CryoFiber* spawned = fiber.get();
+		uint32_t handle = thread.m_FiberGroup->add(std::move(fiber));
+		push(spawned);
+		return handle;
+	}
+
+	uint32_t CryoScheduler::await(CryoThread& thread, uint32_t handle)
+	{
+		std::shared_ptr<CryoFiber> target = thread.m_FiberGroup ? thread.m_FiberGroup->get(handle) : nullptr;
+		if (!target)
+		{
+			throw std::logic_error(std::format("Fatal Error: fiber_await got [{}], which isn't a fiber handle of this execution or was already awaited!", handle));
+		}
+		CryoFiber* current = thread.m_Fiber;
+		if (target.get() == current)
+		{
+			throw std::logic_error(std::format("Fatal Error: fiber [{}] awaited itself!", handle));
+		}
+
+		std::unique_lock lock(target->Mutex);
+		if (!target->Done)
+		{
+			if (current)
+			{
+				// run parks the fiber on target once it's suspended, it can't be resumed while it's still running
+				current->AwaitTarget = target.get();
+				thread.suspend(true);
+				return 0;
+			}
+			target->DoneCondition.wait(lock, [&]() { return target->Done; });
+		}
+
+		// Several fibers may have waited on it, only the first one to run again gets the return
+		if (target->Claimed)
+		{
+			throw std::logic_error(std::format("Fatal Error: fiber [{}] was already awaited or detached!", handle));
+		}
+		target->Claimed = true;
+		bool returned = target->Returned;
+		uint32_t value = target->Return;
+		lock.unlock();
+
+		thread.m_FiberGroup->release(handle);
+		if (!returned)
+		{
+			throw std::logic_error(std::format("Fatal Error: awaited fiber [{}] didn't return!", handle));
+		}
+		return value;
+	}
+
+	void CryoScheduler::detach(CryoThread& thread, uint32_t handle)
+	{
+		std::shared_ptr<CryoFiber> target = thread.m_FiberGroup ? thread.m_FiberGroup->get(handle) : nullptr;
+		if (!target)
+		{
+			throw std::logic_error(std::format("Fatal Error: fiber_detach got [{}], which isn't a fiber handle of this execution or was already awaited!", handle));
+		}
+
+		std::unique_lock lock(target->Mutex);
+		if (target->Claimed)
+		{
+			throw std::logic_error(std::format("Fatal Error: fiber [{}] was already awaited or detached!", handle));
+		}
+		target->Claimed = true;
+		// Not done yet, finish releases it
+		if (target->Done)
+		{
+			lock.unlock();
+			thread.m_FiberGroup->release(handle);
+		}
+	}
+
+	void CryoScheduler::yield(CryoThread& thread)
+	{
+		if (thread.m_Fiber)
+		{
+			thread.suspend(false);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	void CryoScheduler::wake(CryoFiber* fiber)
+	{
+		push(fiber);
+	}
+
+	void CryoScheduler::work(std::stop_token stop, size_t index)
+	{
+		s_WorkerIndex = index;
+		while (!stop.stop_requested())
+		{
+			CryoFiber* fiber = pop(index);
+			if (!fiber)
+			{
+				std::unique_lock lock(m_SleepMutex);
+				m_Sleeping++;
+				m_Wake.wait(lock, stop, [&]() { return m_Queued.load() != 0; });
+				m_Sleeping--;
+				continue;
+			}
+			run(fiber);
+		}
+	}
+
+	void CryoScheduler::run(CryoFiber* fiber)
+	{
+		// The fiber's return followed by its argument
+		uint8_t frame[8] = {};
+		bool returned = false;
+		try
+		{
+			if (!fiber->Thread)
+			{
+				auto& idle = m_Workers[s_WorkerIndex]->IdleThreads;
+				if (idle.empty())
+				{
+					fiber->Thread = std::make_unique<CryoThread>(s_FiberStackSize);
+				}
+				else
+				{
+					fiber->Thread = std::move(idle.back());
+					idle.pop_back();
+				}
+
+				CryoThread& thread = *fiber->Thread;
+				thread.set_dispatch_mode(fiber->Dispatch);
+				thread.set_jit_threshold(fiber->JitThreshold);
+				thread.set_fuel(fiber->FuelSlice, fiber->FuelBudget);
+				thread.m_Fiber = fiber;
+				thread.m_FiberGroup = fiber->Group;
+
+				std::memcpy(frame + 4, &fiber->Argument, sizeof(fiber->Argument));
+				returned = thread.execute(fiber->Entry, frame);
+			}
+			else
+			{
+				returned = fiber->Thread->resume(std::span(frame, 4));
+			}
+		}
+		catch (const std::exception& e)
+		{
+			// Nothing to hand the exception to, fibers awaiting this one fail instead
+			CryoIO::flush();
+			std::cout << e.what() << std::endl;
+			if (fiber->Thread)
+			{
+				fiber->Thread->reset();
+			}
+		}
+
+		// CryoIO buffers per native thread and the fiber may go on on another worker, so what it wrote here goes out before it can
+		// run again or its awaiters see it done. Cheap when it wrote nothing
+		CryoIO::flush();
+
+		if (fiber->Thread && fiber->Thread->is_suspended())
+		{
+			if (fiber->Io.State == IoState::Starting)
+			{
+				// Once submitted the event loop may wake the fiber right away, fiber isn't touched past this
+				fiber->Io.State = IoState::Submitted;
+				CryoEventLoop::get().submit(&fiber->Io);
+				return;
+			}
+
+			if (CryoChannel* channel = std::exchange(fiber->BlockedChannel, nullptr))
+			{
+				channel->park(fiber, fiber->BlockedSending);
+				return;
+			}
+
+			CryoFiber* target = std::exchange(fiber->AwaitTarget, nullptr);
+			if (target)
+			{
+				std::lock_guard lock(target->Mutex);
+				if (!target->Done)
+				{
+					target->Waiters.emplace_back(fiber);
+					return;
+				}
+			}
+			// Yields and fibers out of fuel go behind the fibers already queued on the worker
+			push(fiber, target == nullptr);
+			return;
+		}
+
+		uint32_t value = 0;
+		std::memcpy(&value, frame, sizeof(value));
+		finish(fiber, returned, value);
+	}
+
+	void CryoScheduler::finish(CryoFiber* fiber, bool returned, uint32_t value)
+	{
+		// Only live fibers hold a stack, the next fiber this worker starts reuses it
+		std::unique_ptr<CryoThread> thread = std::move(fiber->Thread);
+		if (thread)
+		{
+			thread->reset();
+			thread->m_Fiber = nullptr;
+			thread->m_FiberGroup.reset();
+
+			auto& idle = m_Workers[s_WorkerIndex]->IdleThreads;
+			if (idle.size() < s_MaxIdleThreads)
+			{
+				idle.emplace_back(std::move(thread));
+			}
+		}
+
+		// Once it's marked done an awaiter may release the fiber right away, so it isn't touched past the lock
+		std::shared_ptr<CryoFiberGroup> group = std::move(fiber->Group);
+		uint32_t handle = fiber->Handle;
+		std::vector<CryoFiber*> waiters;
+		bool detached = false;
+		{
+			std::lock_guard lock(fiber->Mutex);
+			fiber->Done = true;
+			fiber->Returned = returned;
+			fiber->Return = value;
+			waiters.swap(fiber->Waiters);
+			detached = fiber->Claimed;
+			fiber->DoneCondition.notify_all();
+		}
+
+		for (CryoFiber* waiter : waiters)
+		{
+			push(waiter);
+		}
+		if (detached)
+		{
+			group->release(handle);
+		}
+
+		// Last, once the group is done the execution that spawned it may unload the fiber's assembly and free the fibers left in it
+		group->done();
+	}
+
+	void CryoScheduler::push(CryoFiber* fiber, bool yielded)
+	{
+		size_t index = s_WorkerIndex != SIZE_MAX ? s_WorkerIndex : m_NextWorker++ % m_Workers.size();
+		{
+			Worker& worker = *m_Workers[index];
+			std::lock_guard lock(worker.Mutex);
+			yielded ? worker.Queue.emplace_front(fiber) : worker.Queue.emplace_back(fiber);
+		}
+
+		// A worker counts itself as sleeping before it checks m_Queued, so either it sees this fiber or this sees it sleeping
+		m_Queued++;
+		if (m_Sleeping.load() != 0)
+		{
+			{
+				// Taken so a worker can't miss the wake up between checking m_Queued and going to sleep
+				std::lock_guard lock(m_SleepMutex);
+			}
+			m_Wake.notify_one();
+		}
+	}
+
+	CryoFiber* CryoScheduler::pop(size_t index)
+	{
+		for (size_t i = 0; i < m_Workers.size(); i++)
+		{
+			Worker& worker = *m_Workers[(index + i) % m_Workers.size()];
+			std::lock_guard lock(worker.Mutex);
+			if (worker.Queue.empty())
+			{
+				continue;
+			}
+
+			// The worker's own deque is LIFO, the fiber it queued last is the most likely to still be in cache. Stealing takes the oldest
+			CryoFiber* fiber = nullptr;
+			if (i == 0)
+			{
+				fiber = worker.Queue.back();
+				worker.Queue.pop_back();
+			}
+			else
+			{
+				fiber = worker.Queue.front();
+				worker.Queue.pop_front();
+			}
+			m_Queued--;
+			return fiber;
+		}
+		return nullptr;
+	}
+
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "CryoEventLoop.h"
+#include "CryoThread.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Cryo {
+
+	class CryoChannel;
+	struct CryoFiberGroup;
+
+	/// <summary>
+	/// Cryo function running on its own CryoThread, scheduled by CryoScheduler and suspended by its IMPLs instead of blocking a native thread
+	/// </summary>
+	struct CryoFiber
+	{
+		const CryoFunction* Entry = nullptr;
+		uint32_t Argument = 0;
+		/// Inherited from the thread that spawned the fiber
+		DispatchMode Dispatch = DispatchMode::Switch;
+		uint32_t JitThreshold = 0;
+		uint64_t FuelSlice = 0;
+		uint64_t FuelBudget = 0;
+		std::shared_ptr<CryoFiberGroup> Group;
+		/// Handle within Group, set before the fiber first runs
+		uint32_t Handle = 0;
+
+		/// Taken from the idle threads of the first worker running the fiber and handed back once it finishes, only live fibers hold a stack
+		std::unique_ptr<CryoThread> Thread;
+		/// Fiber whose end the fiber is waiting for, set by fiber_await before it suspends
+		CryoFiber* AwaitTarget = nullptr;
+
+		std::mutex Mutex;
+		std::condition_variable DoneCondition;
+		bool Done = false;
+		bool Returned = false;
+		uint32_t Return = 0;
+		/// Set by the fiber_await that got the return or by fiber_detach, the group releases the fiber once it's both claimed and done
+		bool Claimed = false;
+		/// Fibers suspended in fiber_await until this one is done
+		std::vector<CryoFiber*> Waiters;
+
+		/// IO IMPL the fiber is suspended in, see CryoEventLoop::perform
+		CryoIoRequest Io;
+		/// Channel the fiber is blocked on, set by channel_send and channel_receive before they suspend it
+		CryoChannel* BlockedChannel = nullptr;
+		bool BlockedSending = false;
+	};
+
+	/// <summary>
+	/// Fibers spawned by one execution and by its fibers, the execution only ends once all of them did. The group owns them and fiber
+	/// handles are only valid within it. A fiber is released once it's done and was awaited or detached, the ones that weren't are
+	/// freed along with the group when the execution ends
+	/// </summary>
+	struct CryoFiberGroup
+	{
+		/// <returns> Returns the fiber's handle </returns>
+		uint32_t add(std::unique_ptr<CryoFiber> fiber);
+		void done();
+		void wait();
+		/// <returns> Returns nullptr if handle isn't a fiber of the group or was released </returns>
+		std::shared_ptr<CryoFiber> get(uint32_t handle);
+		/// <summary>
+		/// Drops the group's reference, the fiber is freed once nothing awaiting it holds one either. Handles are never reused
+		/// </summary>
+		void release(uint32_t handle);
+
+		std::mutex Mutex;
+		std::condition_variable Finished;
+		uint32_t Pending = 0;
+		uint32_t LastHandle = 0;
+		/// Shared with the threads in fiber_await, a released fiber stays alive until they're done looking at it
+		std::unordered_map<uint32_t, std::shared_ptr<CryoFiber>> Fibers;
+	};
+
+	/// <summary>
+	/// Runs fibers M:N on one worker per core, each worker pops the fibers it spawned or resumed from the back of its own deque and steals
+	/// from the front of the others once it runs out. The process has a single scheduler, started by the first fiber_spawn
+	/// </summary>
+	class CryoScheduler
+	{
+	public:
+		static CryoScheduler& get();
+
+		~CryoScheduler();
+
+		/// <summary>
+		/// Starts a $uint32::name::uint32 function of the assembly thread is running as a fiber, used by the fiber_spawn IMPL
+		/// </summary>
+		/// <returns> Returns the handle fiber_await takes, valid on every thread and fiber of the execution's group </returns>
+		uint32_t spawn(CryoThread& thread, std::string_view signature, uint32_t argument);
+		/// <summary>
+		/// Gets the return of a fiber, used by the fiber_await IMPL. A fiber awaiting one that isn't done is suspended and runs the IMPL again
+		/// once it is, any other thread blocks
+		/// </summary>
+		/// <returns> Returns the fiber's return and releases the fiber, throws if the handle is invalid, the fiber didn't return or
+		/// it was already awaited or detached </returns>
+		uint32_t await(CryoThread& thread, uint32_t handle);
+		/// <summary>
+		/// Lets a fiber nobody awaits be released as soon as it ends, used by the fiber_detach IMPL. The execution still waits for it
+		/// </summary>
+		void detach(CryoThread& thread, uint32_t handle);
+		/// <summary>
+		/// Lets the worker run other fibers first, used by the fiber_yield IMPL. Threads that aren't fibers yield their native thread
+		/// </summary>
+		void yield(CryoThread& thread);
+		/// <summary>
+		/// Queues a fiber whose IO request completed or whose channel changed, safe to call from any thread
+		/// </summary>
+		void wake(CryoFiber* fiber);
+
+	private:
+		/// Reserved per fiber and committed lazily, the OS only backs the pages a fiber touches. A fiber going past it overflows like any
+		/// other CryoThread. Past 128 KB the call stack sized from it is mapped on its own too, which costs every live fiber another page
+		static constexpr StackSize s_FiberStackSize = { 128 * 1024 };
+
+		/// Idle threads a worker keeps for its next fibers, past it finished fibers give their stack back to the OS
+		static constexpr size_t s_MaxIdleThreads = 64;
+
+		struct Worker
+		{
+			std::mutex Mutex;
+			std::deque<CryoFiber*> Queue;
+			/// Threads of finished fibers, only touched by the worker itself
+			std::vector<std::unique_ptr<CryoThread>> IdleThreads;
+		};
+
+		CryoScheduler();
+
+		void work(std::stop_token stop, size_t index);
+		void run(CryoFiber* fiber);
+		void finish(CryoFiber* fiber, bool returned, uint32_t value);
+
+		/// <summary>
+		/// Queues a fiber on the calling worker's deque, or on one picked round robin from other threads.
+		/// Yielded fibers go to the front, so the worker runs the others it has first
+		/// </summary>
+		void push(CryoFiber* fiber, bool yielded = false);
+		CryoFiber* pop(size_t index);
+
+		std::vector<std::unique_ptr<Worker>> m_Workers;
+		std::atomic<size_t> m_NextWorker = 0;
+
+		/// Fibers queued on any deque, workers sleep while it's 0
+		std::atomic<size_t> m_Queued = 0;
+		/// Workers about to sleep or sleeping, pushes only wake one up when there are some
+		std::atomic<size_t> m_Sleeping = 0;
+		std::mutex m_SleepMutex;
+		std::condition_variable_any m_Wake;
+
+		/// Last member, workers stop and join before the rest is destroyed
+		std::vector<std::jthread> m_Threads;
+	};
+
+}
@@ -1,6 +1,9 @@
 #include "cryopch.h"
 #include "CryoState.h"
+#include "CryoEventLoop.h"
+#include "CryoIO.h"
 #include <string.h>
+#include <charconv>
 
 namespace Cryo {
 
@@ -9,9 +12,23 @@ namespace Cryo {
 	/// </summary>
 	/// <param name="argc"> argument count </param>
 	/// <param name="argv"> argument values </param>
+	/// Modifiers:
+	/// -s {size}: stack size in MB for the main thread, 8 by default
+	/// -j {calls}: compile functions of verified assemblies to native code after {calls} calls, off by default
+	/// -f {fuel}: instructions Cryo code runs between yields, to the scheduler on fibers and to the OS on other threads, off by default
+	/// -l {fuel}: instructions an execution may run before it stops with a budget exceeded error, unlimited by default
+	/// -b: fully buffer the program's output instead of flushing it on every line break
+	/// -e: complete the IO IMPLs on epoll even when the kernel has io_uring
+	/// -m {manifest}: batch mode, runs every job of the manifest on a pool of worker threads instead of a single entry point, see CryoBatch
+	/// -w {workers}: worker threads of batch mode, one per core by default
+	/// -r {file}: where batch mode writes the results of its jobs, the manifest's path with a .results extension by default
+	/// Every other argument is a CryoAssembly, the first one has the entry point and the others are libraries it calls into
 	CryoState::CryoState(int argc, const char* argv[])
 		: m_Argc(argc), m_Argv(argv)
 	{
+		CryoIO::initialize();
+
+		std::vector<std::filesystem::path> assembly_paths;
 		for (int i = 0; i < m_Argc; i++)
 		{
 			const char* arg = m_Argv[i];
@@ -19,6 +36,7 @@ namespace Cryo {
 			{
 				size_t arg_lenght = strlen(arg);
 				std::set<char> used_modifiers;
+				int consumed_arguments = 0; // Modifiers that take a value read it from the arguments after the current one
 				// Allow multiple modifiers in one argument like "-abcd" instead of "-a -b -c -d"
 				for (int c = 1; c < arg_lenght; c++) // c starts at 1 to ignore the '-' character
 				{
@@ -30,6 +48,86 @@ namespace Cryo {
 					// Deal with the modifier argument
 					switch (arg[c])
 					{
+					case 's':
+						{
+							const char* value = i + 1 + consumed_arguments < m_Argc ? m_Argv[i + 1 + consumed_arguments] : nullptr;
+							auto result = value ? std::from_chars(value, value + strlen(value), m_StackSizeMB) : std::from_chars_result{ nullptr, std::errc::invalid_argument };
+							if (result.ec != std::errc() || m_StackSizeMB == 0)
+							{
+								std::cout << "modifier s expects the stack size in MB!" << std::endl;
+								return;
+							}
+							consumed_arguments++;
+							break;
+						}
+
+					case 'b':
+						CryoIO::set_buffer_mode(BufferMode::Full);
+						break;
+
+					case 'e':
+						CryoEventLoop::set_preferred_backend(IoBackend::Epoll);
+						break;
+
+					case 'j':
+						{
+							const char* value = i + 1 + consumed_arguments < m_Argc ? m_Argv[i + 1 + consumed_arguments] : nullptr;
+							auto result = value ? std::from_chars(value, value + strlen(value), m_JitThreshold) : std::from_chars_result{ nullptr, std::errc::invalid_argument };
+							if (result.ec != std::errc() || m_JitThreshold == 0)
+							{
+								std::cout << "modifier j expects the call count that triggers compilation!" << std::endl;
+								return;
+							}
+							if (!CryoThread::has_jit())
+							{
+								std::cout << "modifier j ignored, the JIT is not available on this platform" << std::endl;
+							}
+							consumed_arguments++;
+							break;
+						}
+
+					case 'f':
+					case 'l':
+						{
+							uint64_t& fuel = arg[c] == 'f' ? m_FuelSlice : m_FuelBudget;
+							const char* value = i + 1 + consumed_arguments < m_Argc ? m_Argv[i + 1 + consumed_arguments] : nullptr;
+							auto result = value ? std::from_chars(value, value + strlen(value), fuel) : std::from_chars_result{ nullptr, std::errc::invalid_argument };
+							if (result.ec != std::errc() || fuel == 0)
+							{
+								std::cout << "modifier " << arg[c] << (arg[c] == 'f' ? " expects the instructions run between yields!" : " expects the instruction budget of an execution!") << std::endl;
+								return;
+							}
+							consumed_arguments++;
+							break;
+						}
+
+					case 'm':
+					case 'r':
+						{
+							const char* value = i + 1 + consumed_arguments < m_Argc ? m_Argv[i + 1 + consumed_arguments] : nullptr;
+							if (!value)
+							{
+								std::cout << "modifier " << arg[c] << (arg[c] == 'm' ? " expects the batch manifest's path!" : " expects the batch results' path!") << std::endl;
+								return;
+							}
+							(arg[c] == 'm' ? m_BatchManifest : m_BatchResults) = value;
+							consumed_arguments++;
+							break;
+						}
+
+					case 'w':
+						{
+							const char* value = i + 1 + consumed_arguments < m_Argc ? m_Argv[i + 1 + consumed_arguments] : nullptr;
+							auto result = value ? std::from_chars(value, value + strlen(value), m_BatchWorkers) : std::from_chars_result{ nullptr, std::errc::invalid_argument };
+							if (result.ec != std::errc() || m_BatchWorkers == 0)
+							{
+								std::cout << "modifier w expects the number of batch worker threads!" << std::endl;
+								return;
+							}
+							consumed_arguments++;
+							break;
+						}
+
 					default:
 						std::cout << "unknown modifier argument: " << arg[c] << std::endl; // Unknown modifier found, quit
 						return;
@@ -37,27 +135,52 @@ namespace Cryo {
 
 					used_modifiers.insert(arg[c]);
 				}
+				i += consumed_arguments;
 			}
 			else // the first argument thaat doesn't start with '-' and wasn't dealt with by the modifiers is a CryoAssembly filepath
 			{
-				m_Assemblies.emplace_back(std::filesystem::path(argv[i]));
-				if (!m_Assemblies[0].is_valid()) // Failing to load the initial assembly is a critical failure, clear m_Assemblies to indicate that the state is not valid
-				{
-					m_Assemblies.clear();
-				}
+				assembly_paths.emplace_back(argv[i]);
+			}
+		}
+
+		if (!m_BatchManifest.empty())
+		{
+			if (!assembly_paths.empty())
+			{
+				std::cout << "Assemblies of batch mode are listed in its manifest, not on the command line!" << std::endl;
+				return;
+			}
+			if (m_BatchResults.empty())
+			{
+				m_BatchResults = std::filesystem::path(m_BatchManifest).concat(".results");
 			}
+			m_Batch = CryoBatch::load(m_BatchManifest);
+			return;
 		}
+
+		// Failing to load any assembly is a critical failure, m_Program stays empty to indicate that the state is not valid
+		m_Program = CryoProgram::load(assembly_paths);
+	}
+
+	int CryoState::run()
+	{
+		if (m_Batch)
+		{
+			uint32_t failed = m_Batch->run(m_BatchResults, m_BatchWorkers, CryoContextOptions{ m_StackSizeMB, m_JitThreshold, m_FuelSlice, m_FuelBudget });
+			return failed == 0 ? 0 : 1;
+		}
+
+		run_entry_point();
+		return 0;
 	}
 
 	void CryoState::run_entry_point()
 	{
-		auto func = m_Assemblies[0].get_function_by_signature("$void::main::void");
-		if (!func)
+		if (!m_MainContext)
 		{
-			std::cout << "Failed to find entry point in assembly [" << m_Assemblies[0].get_path().string() << "]!" << std::endl;
-			return;
+			m_MainContext = std::make_unique<CryoContext>(m_Program, CryoContextOptions{ m_StackSizeMB, m_JitThreshold, m_FuelSlice, m_FuelBudget });
 		}
-		m_MainThread.execute(func);
+		m_MainContext->run_entry_point();
 	}
 
 }
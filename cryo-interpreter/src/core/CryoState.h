@@ -1,9 +1,11 @@
 #pragma once
 
-#include "CryoAssembly.h"
-#include "CryoThread.h"
+#include "CryoBatch.h"
+#include "CryoContext.h"
+#include "CryoProgram.h"
 
 #include <vector>
+#include <memory>
 
 namespace Cryo {
 
@@ -16,13 +18,28 @@ namespace Cryo {
 		///  Used to check if the state was able to load properly
 		/// </summary>
 		/// <returns> Returns [true] if valid, [false] if not </returns>
-		bool is_valid() { return m_Assemblies.size() != 0; }
+		bool is_valid() { return m_Program != nullptr || m_Batch != nullptr; }
+
+		/// <summary>
+		/// Runs the entry point, or every job of the manifest in batch mode
+		/// </summary>
+		/// <returns> Returns the process' exit code, 1 if any batch job failed </returns>
+		int run();
 
 		void run_entry_point();
 
 	private:
-		CryoThread m_MainThread;
-		std::vector<CryoAssembly> m_Assemblies;
+		std::unique_ptr<CryoContext> m_MainContext;
+		uint32_t m_StackSizeMB = 8;
+		uint32_t m_JitThreshold = 0;
+		uint64_t m_FuelSlice = 0;
+		uint64_t m_FuelBudget = 0;
+		std::shared_ptr<const CryoProgram> m_Program;
+
+		std::unique_ptr<CryoBatch> m_Batch;
+		std::filesystem::path m_BatchManifest;
+		std::filesystem::path m_BatchResults;
+		uint32_t m_BatchWorkers = 0;
 
 		const int m_Argc = 0;
 		const char** m_Argv = nullptr;
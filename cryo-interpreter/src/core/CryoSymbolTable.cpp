@@ -0,0 +1,34 @@
+#include "cryopch.h"
+#include "CryoSymbolTable.h"
+
+namespace Cryo {
+
+	std::string_view CryoSymbolTable::intern(std::string_view signature)
+	{
+		auto ite = m_Interned.find(signature);
+		if (ite != m_Interned.end())
+		{
+			return *ite;
+		}
+
+		std::string_view interned = m_Strings.emplace_back(signature);
+		m_Interned.insert(interned);
+		return interned;
+	}
+
+	bool CryoSymbolTable::define(std::string_view signature, const CryoFunction* func)
+	{
+		return m_Symbols.emplace(signature, func).second;
+	}
+
+	const CryoFunction* CryoSymbolTable::find(std::string_view signature) const
+	{
+		auto ite = m_Symbols.find(signature);
+		if (ite == m_Symbols.end())
+		{
+			return nullptr;
+		}
+		return ite->second;
+	}
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "CryoAssembly.h"
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Cryo {
+
+	/// <summary>
+	/// Functions of every assembly loaded into a CryoState, by signature. Signatures are interned, so every assembly
+	/// naming the same function shares one copy of it and interned signatures can be compared by pointer.
+	/// Only filled while CryoState links its assemblies, which happens on a single thread, lookups are safe from any thread afterwards
+	/// </summary>
+	class CryoSymbolTable
+	{
+	public:
+		/// <summary>
+		/// Used to get the shared copy of a signature, it lives as long as the table
+		/// </summary>
+		std::string_view intern(std::string_view signature);
+
+		/// <summary>
+		/// Defines func under its signature, which must already be interned
+		/// </summary>
+		/// <returns> Returns false and keeps the previous definition if another assembly already defines the signature </returns>
+		bool define(std::string_view signature, const CryoFunction* func);
+
+		/// <summary>
+		/// Used to retrieve a function of any linked assembly by its signature
+		/// </summary>
+		/// <returns> Returns a pointer to the function if it finds it, nullptr if it doesn't </returns>
+		const CryoFunction* find(std::string_view signature) const;
+
+		size_t size() const { return m_Symbols.size(); }
+
+	private:
+		/// A deque never moves its elements, so views of the strings stay valid as it grows
+		std::deque<std::string> m_Strings;
+		std::unordered_set<std::string_view> m_Interned;
+		std::unordered_map<std::string_view, const CryoFunction*> m_Symbols; // Keys are interned
+	};
+
+}
@@ -2,184 +2,335 @@
 #include "CryoThread.h"
 
 #include "CryoInstructions.h"
+#include "CryoIO.h"
+#include "CryoLibraries.h"
+#include "CryoScheduler.h"
+#include <atomic>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <iterator>
 #include <ostream>
 #include <stdexcept>
 #include <format>
 #include <string_view>
+#include <thread>
 
 namespace Cryo {
 
-	CryoThread::CryoThread()
-	  : m_Stack(8)
+  struct CryoThread::SpawnedThread
   {
+    std::thread Native;
+    /// Written by the spawned thread before it exits, read once it's joined
+    uint32_t Return = 0;
+    bool Returned = false;
+    bool Joined = false;
+  };
+
+  // Target of an atomic instruction, a heap slot holds a pointer to it instead
+  static std::atomic_ref<uint32_t> get_atomic_slot(uint8_t* frame, uint32_t operand)
+  {
+    uint32_t* target = (uint32_t*)(frame + get_atomic_offset(operand));
+    if (get_atomic_order(operand) & ATOMIC_HEAP)
+    {
+      std::memcpy(&target, target, sizeof(target));
+    }
+    if (target == nullptr || (uintptr_t)target % std::atomic_ref<uint32_t>::required_alignment != 0)
+    {
+      throw std::logic_error("Fatal Error: atomic instruction on a null or misaligned @uint32!");
+    }
+    return std::atomic_ref<uint32_t>(*target);
+  }
+
+  static std::memory_order get_memory_order(uint32_t operand)
+  {
+    // Indexed by CryoMemoryOrder
+    static constexpr std::memory_order s_MemoryOrders[] =
+    {
+      std::memory_order_relaxed, std::memory_order_acquire, std::memory_order_release, std::memory_order_acq_rel, std::memory_order_seq_cst
+    };
+    return s_MemoryOrders[get_atomic_order(operand) & ~ATOMIC_HEAP];
+  }
+
+	CryoThread::CryoThread(uint32_t stack_size_mb)
+	  : CryoThread(StackSize{ size_t(stack_size_mb) * MB })
+  {
+	}
+
+	CryoThread::CryoThread(StackSize stack_size)
+	  : m_Stack(stack_size)
+  {
+	}
+
+  CryoThread::~CryoThread()
+  {
+    // Waits for the threads and fibers it started, they may still run functions of assemblies about to be unloaded
+    clear();
+  }
+
+	bool CryoThread::execute(const CryoFunction* func, std::span<uint8_t> frame)
+	{
+    m_Returned = false;
+    m_Suspended = false;
+
+    // The budget is per execution, a resumed fiber keeps what it has left. The root's own code is charged here, checked at its first CALL
+    m_FuelUsed = 0;
+    m_BudgetExceeded = false;
+    refill_fuel();
+    m_Fuel -= func->FuelCost;
+
+    // Verified functions find their return and parameters at the start of their static frame, checked ones as variables on the stack
+    bool verified = func->OwnerAssembly->is_verified();
+    if (verified && !m_Stack.enter_root_frame(func))
+    {
+      stack_overflow();
+      return false;
+    }
+    bool pushed = verified || func->ReturnTypeSize == 0 || m_Stack.push_variable(func->ReturnTypeSize);
+    for (uint32_t i = 0; !verified && pushed && i < func->ParameterSizes.size(); i++)
+    {
+      pushed = m_Stack.push_variable(func->ParameterSizes[i]);
+    }
+    if (!pushed)
+    {
+      stack_overflow();
+      return false;
+    }
+    if (!frame.empty())
+    {
+      std::memcpy(m_Stack.get_frame_base(), frame.data(), frame.size());
+    }
+
+    dispatch(func, func->Code);
+
+    // Returning from the root clears the stack, but the root frame's memory still holds the return value
+    if (m_Returned && !frame.empty())
+    {
+      std::memcpy(frame.data(), m_Stack.get_frame_base(), std::min<size_t>(frame.size(), func->ReturnTypeSize));
+    }
+    return m_Returned;
 	}
 
-	void CryoThread::execute(const CryoFunction* func)
+  bool CryoThread::resume(std::span<uint8_t> return_value)
+  {
+    if (!m_Suspended)
+    {
+      return false;
+    }
+    m_Suspended = false;
+
+    dispatch(m_CurrentFunction, m_ProgramCounter);
+
+    if (m_Returned && !return_value.empty())
+    {
+      std::memcpy(return_value.data(), m_Stack.get_frame_base(), return_value.size());
+    }
+    return m_Returned;
+  }
+
+  void CryoThread::dispatch(const CryoFunction* func, const CryoInstruction* pc)
+  {
+    bool verified = func->OwnerAssembly->is_verified();
+#if CRYO_COMPUTED_GOTO
+    if (m_DispatchMode == DispatchMode::Threaded)
+    {
+      verified ? execute_threaded<false>(func, pc) : execute_threaded<true>(func, pc);
+    }
+    else
+#endif
+    {
+      verified ? execute_switch<false>(func, pc) : execute_switch<true>(func, pc);
+    }
+  }
+
+  // Every function's decoded code ends with an OP_END, so neither loop checks the program counter against the instruction count,
+  // running past the last instruction lands on the OP_END handler
+
+  template <bool Checked>
+	void CryoThread::execute_switch(const CryoFunction* func, const CryoInstruction* pc)
 	{
 		m_CurrentFunction = func;
-		for (m_ProgramCounter = m_CurrentFunction->FunctionStart; (m_ProgramCounter - m_CurrentFunction->FunctionStart) < m_CurrentFunction->InstrutionCount; m_ProgramCounter++)
+    const CryoFunction* function = func;
+    uint8_t* frame = m_Stack.get_frame_base();
+    const CryoFunction* callee = nullptr;
+
+#define CRYO_HANDLER(opcode) case opcode:
+#define CRYO_NEXT(count) pc += (count); continue
+#define CRYO_JUMP(opcode) continue // pc already holds an instruction with opcode, the switch dispatches it
+
+		for (;;)
 		{
-			CryoOpcode opcode = (CryoOpcode)*m_ProgramCounter;
-			switch (opcode)
+			switch (pc->Opcode)
 			{
-			case STLS:
-				{
-					m_Stack.start_stack_layer();
-					break;
-				}
-
-			case STLE:
-				{
-          if (!m_Stack.end_stack_layer())
-          {
-            throw std::logic_error(std::format("Fatal Error: Invalid CryoAssembly, atmept by [{}] to end non existent stack layer!", m_CurrentFunction->FunctionSignature));
-          }
-
-					break;
-				}
-
-			case PUSH:
-				{
-					m_ProgramCounter++; // Advance to the push size
-					uint32_t size = *m_ProgramCounter;
-					if (!m_Stack.push_variable(size))
-					{
-						// TODO: CryoExceptions
-						std::cout << "Stack overflow exception!" << std::endl;
-						return;
-					}
-
-					break;
-				}
-
-      case POP:
-        {
-          m_ProgramCounter++;
-
-          uint32_t count = *m_ProgramCounter;
-          if (!m_Stack.pop_variable(count))
-          {
-            throw std::logic_error(std::format("Fatal Error: Invalid CryoAssembly, atempt by [{}] to pop non existent variable!", m_CurrentFunction->FunctionSignature));
-          }
-
-          break;
-        }
-
-      case SETU32:
-        {
-          m_ProgramCounter++;
-          uint32_t index = *m_ProgramCounter;
-          m_ProgramCounter++;
-          uint32_t value = *m_ProgramCounter;
-
-          m_Stack.get_variable<uint32_t>(index) = value;
-
-          break;
-        }
-
-      case SETSTR:
-        {
-          m_ProgramCounter++;
-          uint32_t var_index = *m_ProgramCounter;
-          m_ProgramCounter++;
-          uint32_t str_index = *m_ProgramCounter;
-
-          auto result = m_CurrentFunction->OwnerAssembly->get_string_literal(str_index);
-          if (!result.has_value())
-          {
-            throw std::logic_error("Fatal Error: Invalid String literal!");
-          }
-
-          m_Stack.get_variable<const char*>(var_index) = result.value().data();
-
-          break;
-        }
-
-			case RETURN:
-				{
-          CallStackEntry call_stack_entry = m_Stack.pop_call_stack();
-					if (call_stack_entry.Function == nullptr) // Return from call stack root
-					{
-						clear();
-						return;
-					}
-
-					// TODO: implement dealing with parameters
-          m_CurrentFunction = call_stack_entry.Function;
-          m_ProgramCounter = call_stack_entry.ProgramCounter;
-
-					break;
-				}
-
-			case CALL_from_assembly_signature:
-				{
-					m_ProgramCounter++;
-					uint32_t signature_index = *m_ProgramCounter;
-
-					auto result = m_CurrentFunction->OwnerAssembly->get_string_literal(signature_index);
-					if (!result.has_value())
-					{
-					  throw std::logic_error(std::format("Fatal Error: Invalid CryoAssembly, atempt by [{}] to call non existent function!", 
-                  m_CurrentFunction->FunctionSignature));
-          }
-
-					const CryoFunction* function = m_CurrentFunction->OwnerAssembly->get_function_by_signature(std::string(result.value()));
-				if (!function) // Function not found, invalid assembly
-					{
-					  throw new std::logic_error(std::format("Fatal Error: Invalid CryoAssembly, atempt to call invalid function [{}]!", result.value()));
-          }
-
-					m_Stack.push_call_stack(m_CurrentFunction, function, m_ProgramCounter);
-					m_CurrentFunction = function;
-					m_ProgramCounter = function->FunctionStart - 1; // Account for the m_ProgramCounter++ before the next loop iteration
-
-					break;
-				}
-
-      case IMPL:
-        {
-          m_ProgramCounter++;
-          uint32_t sig_index = *m_ProgramCounter;
-          auto signature = m_CurrentFunction->OwnerAssembly->get_string_literal(sig_index);
-          if (!signature.has_value())
-          {
-            throw std::logic_error(std::format("Fatal Error: Invalid CryoAssembly, atempt by [{}] to call non existent IMPL function!", 
-                  m_CurrentFunction->FunctionSignature));
-          }
-
-          auto ite = s_ImplFunctions.find(std::string(signature.value()));
-          if (ite == s_ImplFunctions.end())
-          {
-            throw std::logic_error(std::format("Fatal Error: IMPL function [{}] does not exist!", signature.value()));
-          }
-          m_Stack.push_call_stack(m_CurrentFunction, &ite->second.FunctionData, m_ProgramCounter);
-          ite->second.Function(this);
-          m_Stack.pop_call_stack();
-
-          break;
-        }
-
-			default:
-				{	
-					std::cout << "Fatal Error: Unknown instruction: [" << std::hex << opcode << "]!" << std::endl;
-					break;
-				}
+#include "CryoThreadHandlers.inl"
+
+      default: // Decoding never produces any other opcode
+        return;
 			}
 		}
 
-		// If this code is reached, the function lacked a return statement, quit invalid assembly
-		std::cout << "Fatal Error: Invalid CryoAssembly, function [" << func->FunctionSignature << "] lacked a RETURN instrcution!" << std::endl;
-		clear();
+#undef CRYO_HANDLER
+#undef CRYO_NEXT
+#undef CRYO_JUMP
+	}
+
+#if CRYO_COMPUTED_GOTO
+  template <bool Checked>
+	void CryoThread::execute_threaded(const CryoFunction* func, const CryoInstruction* pc)
+	{
+		m_CurrentFunction = func;
+    const CryoFunction* function = func;
+    uint8_t* frame = m_Stack.get_frame_base();
+    const CryoFunction* callee = nullptr;
+
+    // Indexed by CryoDecodedOpcode
+    static const void* const s_DispatchTable[OP_COUNT] =
+    {
+      &&handler_OP_END, &&handler_OP_STLS, &&handler_OP_STLE, &&handler_OP_PUSH, &&handler_OP_POP,
+      &&handler_OP_SETU32, &&handler_OP_SETSTR, &&handler_OP_MOVU32, &&handler_OP_ADDU32, &&handler_OP_SUBU32, &&handler_OP_MULU32,
+      &&handler_OP_RETURN, &&handler_OP_CALL, &&handler_OP_IMPL, &&handler_OP_CALL_IMPORT,
+      &&handler_OP_ATOMIC_LOAD, &&handler_OP_ATOMIC_STORE, &&handler_OP_ATOMIC_ADD, &&handler_OP_ATOMIC_CAS, &&handler_OP_FENCE,
+      &&handler_OP_SETU32_SETU32, &&handler_OP_SETU32_CALL, &&handler_OP_SETSTR_IMPL
+    };
+
+#define CRYO_HANDLER(opcode) handler_##opcode:
+#define CRYO_NEXT(count) pc += (count); goto *s_DispatchTable[pc->Opcode]
+#define CRYO_JUMP(opcode) goto handler_##opcode
+
+    goto *s_DispatchTable[pc->Opcode];
+
+#include "CryoThreadHandlers.inl"
+
+#undef CRYO_HANDLER
+#undef CRYO_NEXT
+#undef CRYO_JUMP
 	}
+#endif
+
+  void CryoThread::refill_fuel()
+  {
+    uint64_t fuel = m_FuelSlice != 0 ? m_FuelSlice : INT64_MAX;
+    if (m_FuelBudget != 0)
+    {
+      fuel = std::min(fuel, m_FuelBudget > m_FuelUsed ? m_FuelBudget - m_FuelUsed : 0);
+    }
+    m_FuelRefill = (int64_t)std::min<uint64_t>(fuel, INT64_MAX);
+    m_Fuel = m_FuelRefill;
+  }
+
+  bool CryoThread::out_of_fuel(const CryoFunction* function, const CryoInstruction* pc)
+  {
+    m_FuelUsed += uint64_t(m_FuelRefill - m_Fuel);
+    if (m_FuelBudget != 0 && m_FuelUsed > m_FuelBudget)
+    {
+      m_BudgetExceeded = true;
+      m_FuelRefill = m_Fuel; // get_fuel_used stays at what was charged
+      CryoIO::flush();
+      std::cout << "Fatal Error: function [" << function->FunctionSignature << "] went over the execution's fuel budget of " << m_FuelBudget << " instructions!" << std::endl;
+      clear();
+      return false;
+    }
+    refill_fuel();
+
+    if (m_Fiber)
+    {
+      // CryoScheduler queues a suspended fiber that isn't waiting on anything behind the ones already queued on its worker
+      m_Suspended = true;
+      m_CurrentFunction = function;
+      m_ProgramCounter = pc;
+      return false;
+    }
+    std::this_thread::yield();
+    return true;
+  }
+
+  void CryoThread::stack_overflow()
+  {
+    // TODO: CryoExceptions
+    CryoIO::flush();
+    std::cout << "Stack overflow exception!" << std::endl;
+    clear();
+  }
 
 	void CryoThread::clear()
 	{
 		m_ProgramCounter = nullptr;
 		m_CurrentFunction = nullptr;
 	  m_Stack.clear();
+    m_Suspended = false;
+    join_spawned();
+
+    // Fibers inherit the group of the execution that spawned them, only that execution waits for it
+    if (m_FiberGroup && !m_Fiber)
+    {
+      m_FiberGroup->wait();
+      m_FiberGroup.reset();
+    }
+  }
+
+  uint32_t CryoThread::spawn(std::string_view signature, uint32_t argument)
+  {
+    const CryoFunction* func = m_CurrentFunction->OwnerAssembly->get_function_by_signature(signature);
+    if (!func || func->ReturnTypeSize != 4 || func->ParameterSizes != std::vector<uint32_t>{ 4 })
+    {
+      throw std::logic_error(std::format("Fatal Error: thread_spawn expects a $uint32::{{name}}::uint32 function of the running assembly, [{}] isn't one!", signature));
+    }
+
+    auto spawned = std::make_unique<SpawnedThread>();
+    spawned->Native = std::thread([spawned = spawned.get(), func, argument, stack_size = StackSize{ m_Stack.get_size() },
+        dispatch_mode = m_DispatchMode, jit_threshold = m_JitThreshold, fuel_slice = m_FuelSlice, fuel_budget = m_FuelBudget]() {
+      CryoThread thread(stack_size);
+      thread.set_dispatch_mode(dispatch_mode);
+      thread.set_jit_threshold(jit_threshold);
+      thread.set_fuel(fuel_slice, fuel_budget);
+
+      uint8_t frame[8] = {};
+      std::memcpy(frame + 4, &argument, sizeof(argument));
+      try
+      {
+        spawned->Returned = thread.execute(func, frame);
+      }
+      catch (const std::exception& e)
+      {
+        // Nothing to hand the exception to, the thread joining this one fails instead
+        CryoIO::flush();
+        std::cout << e.what() << std::endl;
+        thread.reset();
+      }
+      std::memcpy(&spawned->Return, frame, sizeof(spawned->Return));
+    });
+
+    m_Spawned.emplace_back(std::move(spawned));
+    return (uint32_t)m_Spawned.size();
+  }
+
+  uint32_t CryoThread::join(uint32_t handle)
+  {
+    if (handle == 0 || handle > m_Spawned.size() || m_Spawned[handle - 1]->Joined)
+    {
+      throw std::logic_error(std::format("Fatal Error: thread_join got [{}], which isn't a thread this one spawned and didn't join yet!", handle));
+    }
+
+    SpawnedThread& spawned = *m_Spawned[handle - 1];
+    spawned.Native.join();
+    spawned.Joined = true;
+    if (!spawned.Returned)
+    {
+      throw std::logic_error(std::format("Fatal Error: joined thread [{}] didn't return!", handle));
+    }
+    return spawned.Return;
+  }
+
+  void CryoThread::join_spawned()
+  {
+    for (auto& spawned : m_Spawned)
+    {
+      if (!spawned->Joined)
+      {
+        spawned->Native.join();
+      }
+    }
+    m_Spawned.clear();
   }
 
 }
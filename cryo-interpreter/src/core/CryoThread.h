@@ -1,41 +1,203 @@
 #pragma once
 
 #include "CryoAssembly.h"
+#include "CryoJit.h"
+#include "ImplRegistry.h"
 #include "Stack.h"
 
 #include <unordered_map>
 #include <functional>
+#include <memory>
+#include <span>
 #include <vector>
 #include <stack>
 
 #define MB 1000000
 
+// Labels as values are a GCC/Clang extension, everything else uses the switch loop
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(CRYO_DISABLE_COMPUTED_GOTO)
+  #define CRYO_COMPUTED_GOTO 1
+#else
+  #define CRYO_COMPUTED_GOTO 0
+#endif
+
 namespace Cryo {
 
+  struct CryoFiber;
+  struct CryoFiberGroup;
+
+  /// <summary>
+  /// How CryoThread::execute decodes instructions
+  /// </summary>
+  enum class DispatchMode
+  {
+    /// Single switch over the opcode, portable
+    Switch,
+    /// Every handler jumps straight into the next one through a label table (threaded code)
+    Threaded
+  };
+
 	class CryoThread
 	{
 	public:
-		CryoThread();
+		CryoThread(uint32_t stack_size_mb = 8);
+    CryoThread(StackSize stack_size);
+    ~CryoThread();
+
+    CryoThread(const CryoThread&) = delete;
+    CryoThread& operator=(const CryoThread&) = delete;
+
+		/// <summary>
+		/// Runs func on this thread's stack, from an empty stack
+		/// </summary>
+		/// <param name="frame"> The return variable followed by the arguments, laid out like the start of func's frame. Receives the return value </param>
+		/// <returns> Returns true if func returned, false if execution stopped on a stack overflow or a fatal error </returns>
+		bool execute(const CryoFunction* func, std::span<uint8_t> frame = {});
+    /// <summary>
+    /// Continues an execution an IMPL suspended, on whichever native thread calls it
+    /// </summary>
+    /// <param name="return_value"> Receives the root function's return value if it returns </param>
+    /// <returns> Returns true if the root function returned, false if it stopped or was suspended again </returns>
+    bool resume(std::span<uint8_t> return_value = {});
+    /// <summary>
+    /// Used by IMPL functions of fibers, the execution stops once the IMPL returns and resume picks it up at the next instruction
+    /// </summary>
+    /// <param name="retry"> Runs the IMPL again on resume instead, for IMPLs waiting on something </param>
+    void suspend(bool retry) { m_SuspendRequested = true; m_RetryImpl = retry; }
+    bool is_suspended() const { return m_Suspended; }
+
+    /// <summary>
+    /// Drops whatever an interrupted execution left on the stack, execute starts from an empty stack anyway
+    /// </summary>
+    void reset() { clear(); }
+    /// <summary>
+    /// Gives the pages the stack touched back to the OS, the next execution faults in the ones it uses again
+    /// </summary>
+    void trim() { clear(); m_Stack.release_pages(); }
+
+    /// <summary>
+    /// Selects the dispatch loop used by execute, Threaded falls back to Switch when computed goto is not available
+    /// </summary>
+    void set_dispatch_mode(DispatchMode mode) { m_DispatchMode = mode; }
+    DispatchMode get_dispatch_mode() const { return m_DispatchMode; }
+
+    static constexpr bool has_threaded_dispatch() { return CRYO_COMPUTED_GOTO; }
+
+    /// <summary>
+    /// Functions of verified assemblies are handed to CryoJit once this thread made threshold calls to them, 0 disables the JIT
+    /// </summary>
+    void set_jit_threshold(uint32_t threshold) { m_JitThreshold = CRYO_JIT ? threshold : 0; }
+    uint32_t get_jit_threshold() const { return m_JitThreshold; }
+
+    static constexpr bool has_jit() { return CRYO_JIT; }
 
-		void execute(const CryoFunction* func);
+    /// <summary>
+    /// Bounds how long Cryo code keeps this thread, fuel is counted in instructions and CALL charges the callee's whole code up front.
+    /// Takes effect on the next execution, 0 for both runs without limits
+    /// </summary>
+    /// <param name="slice"> Fuel between safepoints, a fiber yields to CryoScheduler there and any other thread yields its core. 0 never yields </param>
+    /// <param name="budget"> Fuel an execution may use, it stops with a budget exceeded error past it. 0 is unlimited </param>
+    void set_fuel(uint64_t slice, uint64_t budget) { m_FuelSlice = slice; m_FuelBudget = budget; }
+    uint64_t get_fuel_slice() const { return m_FuelSlice; }
+    uint64_t get_fuel_budget() const { return m_FuelBudget; }
+    /// <summary>
+    /// Fuel the current or last execution used, calls charged but stopped by the budget included
+    /// </summary>
+    uint64_t get_fuel_used() const { return m_FuelUsed + uint64_t(m_FuelRefill - m_Fuel); }
+    /// <summary>
+    /// Set when the last execution stopped because it went over its fuel budget
+    /// </summary>
+    bool exceeded_budget() const { return m_BudgetExceeded; }
+
+    /// <summary>
+    /// Used by CryoAssembly to resolve IMPL instructions when it's loaded
+    /// </summary>
+    /// <returns> Returns a pointer to the IMPL function if it exists, nullptr if it doesn't </returns>
+    static const ImplFunction* find_impl_function(std::string_view signature);
+
+    /// <summary>
+    /// Starts a $uint32::name::uint32 function of the assembly this thread is running on a new native thread with its own CryoThread,
+    /// which inherits this thread's stack size, dispatch mode, JIT threshold and fuel limits. Used by the thread_spawn IMPL
+    /// </summary>
+    /// <returns> Returns the handle thread_join takes, only valid on this thread and until the current execution ends </returns>
+    uint32_t spawn(std::string_view signature, uint32_t argument);
+    /// <summary>
+    /// Waits for a thread spawned by this one, used by the thread_join IMPL
+    /// </summary>
+    /// <returns> Returns the spawned function's return, throws if the handle is invalid or the function didn't return </returns>
+    uint32_t join(uint32_t handle);
+
+    /// <summary>
+    /// Fiber this thread runs, nullptr for threads that aren't run by CryoScheduler
+    /// </summary>
+    CryoFiber* get_fiber() const { return m_Fiber; }
 
 	private:
 		void clear();
+    /// <summary>
+    /// Waits for every spawned thread nobody joined, an execution ends only once every thread it started did
+    /// </summary>
+    void join_spawned();
+    void stack_overflow();
+
+    /// <summary>
+    /// Fills m_Fuel up to the next safepoint, the end of the slice or of the budget, whichever comes first
+    /// </summary>
+    void refill_fuel();
+    /// <summary>
+    /// Safepoint of a CALL that ran out of fuel, pc is where the execution continues: the callee's first instruction, or the caller's
+    /// next one when the callee ran as native code
+    /// </summary>
+    /// <returns> Returns false if the execution stopped on its budget or the fiber was suspended </returns>
+    bool out_of_fuel(const CryoFunction* function, const CryoInstruction* pc);
+
+    /// <summary>
+    /// Runs from pc in func until the root function returns, the execution stops or an IMPL suspends it
+    /// </summary>
+    void dispatch(const CryoFunction* func, const CryoInstruction* pc);
+    // Checked = false is the handler set for verified assemblies, it skips every check CryoVerifier proved at load time
+    template <bool Checked>
+    void execute_switch(const CryoFunction* func, const CryoInstruction* pc);
+#if CRYO_COMPUTED_GOTO
+    template <bool Checked>
+    void execute_threaded(const CryoFunction* func, const CryoInstruction* pc);
+#endif
 
-		const uint32_t* m_ProgramCounter = nullptr;
+		const CryoInstruction* m_ProgramCounter = nullptr;
 		const CryoFunction* m_CurrentFunction = nullptr;
 
     Stack m_Stack;
 
-    struct ImplFunction
-    {
-      CryoFunction FunctionData;
-      std::function<void(CryoThread*)> Function;
-    };
+    DispatchMode m_DispatchMode = CRYO_COMPUTED_GOTO ? DispatchMode::Threaded : DispatchMode::Switch;
+    uint32_t m_JitThreshold = 0;
+
+    /// Fuel left until the next safepoint, the only counter CALL touches. Stays near INT64_MAX without a slice or a budget
+    int64_t m_Fuel = INT64_MAX;
+    /// What the last refill set m_Fuel to, the difference is what the execution used since
+    int64_t m_FuelRefill = INT64_MAX;
+    uint64_t m_FuelUsed = 0;
+    uint64_t m_FuelSlice = 0;
+    uint64_t m_FuelBudget = 0;
+    bool m_BudgetExceeded = false;
+
+    /// Set when the root function returns, tells execute apart from a stop on an error
+    bool m_Returned = false;
+
+    struct SpawnedThread;
+    /// Indexed by handle - 1
+    std::vector<std::unique_ptr<SpawnedThread>> m_Spawned;
+
+    /// Suspension requested by the running IMPL, m_CurrentFunction and m_ProgramCounter hold where a suspended execution resumes
+    bool m_SuspendRequested = false;
+    bool m_RetryImpl = false;
+    bool m_Suspended = false;
 
-    static std::unordered_map<std::string, ImplFunction> s_ImplFunctions;
+    /// Set by CryoScheduler on the threads running its fibers
+    CryoFiber* m_Fiber = nullptr;
+    /// Fibers the current execution spawned, directly or through its fibers, waited for before it ends
+    std::shared_ptr<CryoFiberGroup> m_FiberGroup;
 
-    void void_println_str_void();
+    friend class CryoScheduler;
 	};
 
 }
@@ -0,0 +1,281 @@
+// Instruction handlers shared by every CryoThread dispatch loop.
+// The including function must define:
+//   CRYO_HANDLER(opcode) - entry point of the handler for a CryoDecodedOpcode
+//   CRYO_NEXT(count)     - advance pc by count instructions and dispatch the next one
+//   CRYO_JUMP(opcode)    - run the handler of opcode for the instruction at pc, which has that opcode
+// and have four locals, pc (const CryoInstruction*), function (const CryoFunction*), frame (uint8_t*), the running function's
+// frame base, which only CALL and RETURN change, and callee (const CryoFunction*), only used by the CALLs.
+// Checked is false for verified assemblies, every check under it was already proven by CryoVerifier.
+// Verified code runs on static frames, it has no STLS, STLE, PUSH or POP left and CALL/IMPL carry the callee's frame offset.
+// Register format code is always verified, so it only ever runs with Checked = false.
+// Verified CALLs also count calls for CryoJit and run the callee's native code once it has some.
+// IMPLs may suspend the execution, which leaves the loop with m_CurrentFunction and m_ProgramCounter set to where CryoThread::resume continues.
+
+CRYO_HANDLER(OP_STLS)
+{
+  m_Stack.start_stack_layer();
+  CRYO_NEXT(1);
+}
+
+CRYO_HANDLER(OP_STLE)
+{
+  if (!m_Stack.end_stack_layer<Checked>())
+  {
+    throw std::logic_error(std::format("Fatal Error: Invalid CryoAssembly, atmept by [{}] to end non existent stack layer!", function->FunctionSignature));
+  }
+
+  CRYO_NEXT(1);
+}
+
+CRYO_HANDLER(OP_PUSH)
+{
+  if (!m_Stack.push_variable(pc->Operand))
+  {
+    stack_overflow();
+    return;
+  }
+  CRYO_NEXT(1);
+}
+
+CRYO_HANDLER(OP_POP)
+{
+  if (!m_Stack.pop_variable<Checked>(pc->Operand))
+  {
+    throw std::logic_error(std::format("Fatal Error: Invalid CryoAssembly, atempt by [{}] to pop non existent variable!", function->FunctionSignature));
+  }
+
+  CRYO_NEXT(1);
+}
+
+CRYO_HANDLER(OP_SETU32)
+{
+  *(uint32_t*)(frame + pc->Operand) = pc->Value;
+  CRYO_NEXT(1);
+}
+
+CRYO_HANDLER(OP_SETSTR)
+{
+  *(const char**)(frame + pc->Operand) = pc->String;
+  CRYO_NEXT(1);
+}
+
+CRYO_HANDLER(OP_MOVU32)
+{
+  *(uint32_t*)(frame + pc->Operand) = *(const uint32_t*)(frame + pc->Slots[0]);
+  CRYO_NEXT(1);
+}
+
+CRYO_HANDLER(OP_ADDU32)
+{
+  *(uint32_t*)(frame + pc->Operand) = *(const uint32_t*)(frame + pc->Slots[0]) + *(const uint32_t*)(frame + pc->Slots[1]);
+  CRYO_NEXT(1);
+}
+
+CRYO_HANDLER(OP_SUBU32)
+{
+  *(uint32_t*)(frame + pc->Operand) = *(const uint32_t*)(frame + pc->Slots[0]) - *(const uint32_t*)(frame + pc->Slots[1]);
+  CRYO_NEXT(1);
+}
+
+CRYO_HANDLER(OP_MULU32)
+{
+  *(uint32_t*)(frame + pc->Operand) = *(const uint32_t*)(frame + pc->Slots[0]) * *(const uint32_t*)(frame + pc->Slots[1]);
+  CRYO_NEXT(1);
+}
+
+CRYO_HANDLER(OP_ATOMIC_LOAD)
+{
+  *(uint32_t*)(frame + pc->Slots[0]) = get_atomic_slot(frame, pc->Operand).load(get_memory_order(pc->Operand));
+  CRYO_NEXT(1);
+}
+
+CRYO_HANDLER(OP_ATOMIC_STORE)
+{
+  get_atomic_slot(frame, pc->Operand).store(*(const uint32_t*)(frame + pc->Slots[0]), get_memory_order(pc->Operand));
+  CRYO_NEXT(1);
+}
+
+CRYO_HANDLER(OP_ATOMIC_ADD)
+{
+  *(uint32_t*)(frame + pc->Slots[0]) = get_atomic_slot(frame, pc->Operand).fetch_add(*(const uint32_t*)(frame + pc->Slots[1]), get_memory_order(pc->Operand));
+  CRYO_NEXT(1);
+}
+
+CRYO_HANDLER(OP_ATOMIC_CAS)
+{
+  // A failed exchange writes the value it found into expected
+  get_atomic_slot(frame, pc->Operand).compare_exchange_strong(*(uint32_t*)(frame + pc->Slots[0]), *(const uint32_t*)(frame + pc->Slots[1]),
+      get_memory_order(pc->Operand));
+  CRYO_NEXT(1);
+}
+
+CRYO_HANDLER(OP_FENCE)
+{
+  std::atomic_thread_fence(get_memory_order(pc->Operand));
+  CRYO_NEXT(1);
+}
+
+CRYO_HANDLER(OP_RETURN)
+{
+  CallStackEntry call_stack_entry = Checked ? m_Stack.pop_call_stack() : m_Stack.leave_frame();
+  if (call_stack_entry.Function == nullptr) // Return from call stack root
+  {
+    m_Returned = true;
+    clear();
+    return;
+  }
+
+  // TODO: implement dealing with parameters
+  function = call_stack_entry.Function;
+  pc = call_stack_entry.ProgramCounter;
+  frame = m_Stack.get_frame_base();
+
+  CRYO_NEXT(1); // Skip the caller's CALL
+}
+
+CRYO_HANDLER(OP_CALL)
+{
+  callee = pc->Function;
+  goto call_function;
+}
+
+CRYO_HANDLER(OP_CALL_IMPORT)
+{
+  // The site is never patched, binding publishes the callee in the import, so running code is never written to
+  callee = CryoLibraries::get_bound(*pc->Import);
+  if (!callee)
+  {
+    CryoLibraries* libraries = function->OwnerAssembly->get_libraries();
+    callee = libraries ? libraries->bind_import(*pc->Import, *function->OwnerAssembly) : nullptr;
+    if (!callee)
+    {
+      CryoIO::flush();
+      std::cout << "Fatal Error: failed to bind [" << pc->Import->Declaration.FunctionSignature << "], imported by [" << function->FunctionSignature << "]!" << std::endl;
+      clear();
+      return;
+    }
+  }
+  goto call_function;
+}
+
+// Shared by OP_CALL and OP_CALL_IMPORT once callee is known
+call_function:
+{
+
+#if CRYO_JIT
+  if (!Checked && m_JitThreshold != 0)
+  {
+    NativeFunction native = CryoJit::get_native_code(callee);
+    if (!native && CryoJit::count_call(callee, m_JitThreshold) && CryoJit::compile(callee))
+    {
+      native = CryoJit::get_native_code(callee);
+    }
+
+    if (native)
+    {
+      // Native code only runs leaf functions, so the callee's frame is the only stack it touches
+      uint8_t* callee_frame = frame + pc->Operand;
+      if (!m_Stack.fits_frame(callee_frame, callee->FrameSize))
+      {
+        stack_overflow();
+        return;
+      }
+      native(callee_frame);
+      if ((m_Fuel -= callee->FuelCost) < 0 && !out_of_fuel(function, pc + 1))
+      {
+        return;
+      }
+      CRYO_NEXT(1);
+    }
+  }
+#endif
+
+  if (!(Checked ? m_Stack.push_call_stack(function, callee, pc) : m_Stack.enter_frame(function, callee, pc, pc->Operand)))
+  {
+    stack_overflow();
+    return;
+  }
+  function = callee;
+  pc = callee->Code;
+  frame = m_Stack.get_frame_base();
+
+  // CALL is the only safepoint, Cryo code has no branches so a call is the only way it runs for long. Charged once the callee's
+  // frame is entered, a fiber suspended here resumes at its first instruction without paying again
+  if ((m_Fuel -= callee->FuelCost) < 0 && !out_of_fuel(function, pc))
+  {
+    return;
+  }
+
+  CRYO_NEXT(0);
+}
+
+CRYO_HANDLER(OP_IMPL)
+{
+  const ImplFunction* impl = pc->Impl;
+
+  if (Checked)
+  {
+    if (!m_Stack.push_call_stack(function, &impl->FunctionData, pc))
+    {
+      stack_overflow();
+      return;
+    }
+    impl->Function(*this, m_Stack.get_frame_base());
+    m_Stack.pop_call_stack();
+  }
+  else
+  {
+    // IMPL functions never call back into Cryo code, so verified code skips the call stack entry
+    uint8_t* impl_frame = frame + pc->Operand;
+    if (!m_Stack.fits_frame(impl_frame, impl->FunctionData.FrameSize))
+    {
+      stack_overflow();
+      return;
+    }
+    impl->Function(*this, impl_frame);
+  }
+
+  if (m_SuspendRequested)
+  {
+    // A fiber IMPL parked the execution, resume picks it up after the IMPL or runs the IMPL again
+    m_SuspendRequested = false;
+    m_Suspended = true;
+    m_CurrentFunction = function;
+    m_ProgramCounter = m_RetryImpl ? pc : pc + 1;
+    return;
+  }
+
+  CRYO_NEXT(1);
+}
+
+CRYO_HANDLER(OP_END)
+{
+  // Ran past the function's code, it lacked a RETURN statement, quit invalid assembly
+  CryoIO::flush();
+  std::cout << "Fatal Error: Invalid CryoAssembly, function [" << function->FunctionSignature << "] lacked a RETURN instrcution!" << std::endl;
+  clear();
+  return;
+}
+
+// Superinstructions, only fused in verified assemblies
+
+CRYO_HANDLER(OP_SETU32_SETU32)
+{
+  *(uint32_t*)(frame + pc[0].Operand) = pc[0].Value;
+  *(uint32_t*)(frame + pc[1].Operand) = pc[1].Value;
+  CRYO_NEXT(2);
+}
+
+CRYO_HANDLER(OP_SETU32_CALL)
+{
+  *(uint32_t*)(frame + pc->Operand) = pc->Value;
+  pc++; // The CALL must see its own slot, RETURN continues after it
+  CRYO_JUMP(OP_CALL);
+}
+
+CRYO_HANDLER(OP_SETSTR_IMPL)
+{
+  *(const char**)(frame + pc->Operand) = pc->String;
+  pc++;
+  CRYO_JUMP(OP_IMPL);
+}
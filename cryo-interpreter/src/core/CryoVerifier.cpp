@@ -0,0 +1,359 @@
+#include "cryopch.h"
+#include "CryoVerifier.h"
+
+#include "CryoThread.h"
+
+#include <algorithm>
+#include <format>
+#include <vector>
+
+namespace Cryo {
+
+  namespace {
+
+    // What a call is checked against, an import isn't bound yet so it's checked against the declaration it was linked with
+    const CryoFunction* get_callee(const CryoInstruction& instruction)
+    {
+      switch (instruction.Opcode)
+      {
+      case OP_IMPL:        return &instruction.Impl->FunctionData;
+      case OP_CALL_IMPORT: return &instruction.Import->Declaration;
+      default:             return instruction.Function;
+      }
+    }
+
+    // A heap slot is the @void* pointing at the @uint32, the pointer itself is only checked when the instruction runs
+    uint32_t get_atomic_slot_size(uint32_t operand)
+    {
+      return get_atomic_order(operand) & ATOMIC_HEAP ? sizeof(const char*) : sizeof(uint32_t);
+    }
+
+    struct SimulatedVariable
+    {
+      uint32_t Offset = 0;
+      uint32_t Size = 0;
+    };
+
+    // Mirrors what Stack does at run time for a single function
+    struct SimulatedFrame
+    {
+      std::vector<SimulatedVariable> Variables;
+      std::vector<uint32_t> Layers; // Variables in each layer, Layers[0] is the function layer
+      uint32_t Size = 0;
+      uint32_t MaxSize = 0;
+
+      void push(uint32_t size)
+      {
+        Variables.emplace_back(SimulatedVariable{ Size, size });
+        Size += size;
+        MaxSize = std::max(MaxSize, Size);
+        Layers.back() += 1;
+      }
+
+      void pop()
+      {
+        Size -= Variables.back().Size;
+        Variables.pop_back();
+        Layers.back() -= 1;
+      }
+
+      bool has_variable(uint32_t offset, uint32_t size) const
+      {
+        for (auto& variable : Variables)
+        {
+          if (variable.Offset == offset)
+          {
+            return variable.Size == size;
+          }
+        }
+        return false;
+      }
+
+      // The callee's return and parameters must be the variables on top of the caller's stack
+      std::optional<std::string> check_call(const CryoFunction& callee) const
+      {
+        size_t needed = callee.ParameterSizes.size() + (callee.ReturnTypeSize != 0 ? 1 : 0);
+        if (Variables.size() < needed)
+        {
+          return std::format("call to [{}] with {} variables on the stack, {} needed", callee.FunctionSignature, Variables.size(), needed);
+        }
+
+        for (size_t i = 0; i < callee.ParameterSizes.size(); i++)
+        {
+          uint32_t expected = callee.ParameterSizes[callee.ParameterSizes.size() - 1 - i];
+          if (Variables[Variables.size() - 1 - i].Size != expected)
+          {
+            return std::format("call to [{}] with a parameter of size {}, {} expected", callee.FunctionSignature,
+                Variables[Variables.size() - 1 - i].Size, expected);
+          }
+        }
+        if (callee.ReturnTypeSize != 0 && Variables[Variables.size() - 1 - callee.ParameterSizes.size()].Size != callee.ReturnTypeSize)
+        {
+          return std::format("call to [{}] without a return variable of size {}", callee.FunctionSignature, callee.ReturnTypeSize);
+        }
+        return std::nullopt;
+      }
+
+      // Where the callee's frame starts, at its return variable or first parameter, check_call must have passed
+      uint32_t call_offset(const CryoFunction& callee) const
+      {
+        size_t needed = callee.ParameterSizes.size() + (callee.ReturnTypeSize != 0 ? 1 : 0);
+        return needed == 0 ? Size : Variables[Variables.size() - needed].Offset;
+      }
+    };
+
+    // Register format code has no stack to simulate, every variable index and call must fit in the function's frame
+    std::optional<std::string> verify_register_function(const CryoFunction& func, std::vector<uint32_t>& call_offsets)
+    {
+      auto fits = [&](uint32_t offset, uint32_t size) { return uint64_t(offset) + size <= func.FrameSize; };
+      auto arguments_size = [](const CryoFunction& function) {
+        uint32_t size = function.ReturnTypeSize;
+        for (uint32_t param_size : function.ParameterSizes) { size += param_size; }
+        return size;
+      };
+
+      if (!fits(0, arguments_size(func)))
+      {
+        return std::format("frame of {} bytes can't hold the return and parameters", func.FrameSize);
+      }
+
+      const CryoInstruction* last = nullptr;
+      for (const CryoInstruction* pc = func.Code; pc->Opcode != OP_END; pc++)
+      {
+        last = pc;
+        uint32_t index = pc - func.Code;
+        switch (pc->Opcode)
+        {
+        case OP_SETU32:
+          if (!fits(pc->Operand, sizeof(uint32_t)))
+          {
+            return std::format("instruction {} sets a @uint32 at offset {}, outside of the frame", index, pc->Operand);
+          }
+          break;
+
+        case OP_SETSTR:
+          if (pc->String == nullptr)
+          {
+            return std::format("instruction {} uses an invalid string literal", index);
+          }
+          if (!fits(pc->Operand, sizeof(const char*)))
+          {
+            return std::format("instruction {} sets a @void* at offset {}, outside of the frame", index, pc->Operand);
+          }
+          break;
+
+        case OP_MOVU32:
+        case OP_ADDU32:
+        case OP_SUBU32:
+        case OP_MULU32:
+          {
+            uint32_t sources = pc->Opcode == OP_MOVU32 ? 1 : 2;
+            bool valid = fits(pc->Operand, sizeof(uint32_t));
+            for (uint32_t i = 0; i < sources; i++) { valid &= fits(pc->Slots[i], sizeof(uint32_t)); }
+            if (!valid)
+            {
+              return std::format("instruction {} uses a @uint32 outside of the frame", index);
+            }
+            break;
+          }
+
+        case OP_ATOMIC_LOAD:
+        case OP_ATOMIC_STORE:
+        case OP_ATOMIC_ADD:
+        case OP_ATOMIC_CAS:
+          {
+            uint32_t variables = pc->Opcode == OP_ATOMIC_LOAD || pc->Opcode == OP_ATOMIC_STORE ? 1 : 2;
+            bool valid = fits(get_atomic_offset(pc->Operand), get_atomic_slot_size(pc->Operand));
+            for (uint32_t i = 0; i < variables; i++) { valid &= fits(pc->Slots[i], sizeof(uint32_t)); }
+            if (!valid)
+            {
+              return std::format("instruction {} uses an atomic slot or @uint32 outside of the frame", index);
+            }
+            break;
+          }
+
+        case OP_FENCE:
+          break;
+
+        case OP_CALL:
+        case OP_IMPL:
+        case OP_CALL_IMPORT:
+          {
+            const CryoFunction* callee = get_callee(*pc);
+            if (!fits(pc->Operand, arguments_size(*callee)))
+            {
+              return std::format("instruction {}: call to [{}] with its return and parameters outside of the frame", index, callee->FunctionSignature);
+            }
+            call_offsets.emplace_back(pc->Operand);
+            break;
+          }
+
+        case OP_RETURN:
+          break;
+
+        default:
+          return std::format("instruction {} has an unknown opcode", index);
+        }
+      }
+
+      if (last == nullptr || last->Opcode != OP_RETURN)
+      {
+        return std::string("function does not end in RETURN");
+      }
+
+      return std::nullopt;
+    }
+
+  }
+
+  std::optional<std::string> CryoVerifier::verify_function(const CryoFunction& func, std::vector<uint32_t>& call_offsets, uint32_t* inferred_frame_size)
+  {
+    call_offsets.clear();
+    if (func.RegisterFormat)
+    {
+      return verify_register_function(func, call_offsets);
+    }
+
+    SimulatedFrame frame;
+    frame.Layers.emplace_back(0);
+
+    // The return and parameters belong to the caller, the function can use but never pop them
+    if (func.ReturnTypeSize != 0)
+    {
+      frame.push(func.ReturnTypeSize);
+    }
+    for (uint32_t size : func.ParameterSizes)
+    {
+      frame.push(size);
+    }
+    frame.Layers[0] = 0;
+
+    const CryoInstruction* last = nullptr;
+    for (const CryoInstruction* pc = func.Code; pc->Opcode != OP_END; pc++)
+    {
+      last = pc;
+      uint32_t index = pc - func.Code;
+      switch (pc->Opcode)
+      {
+      case OP_STLS:
+        frame.Layers.emplace_back(0);
+        break;
+
+      case OP_STLE:
+        if (frame.Layers.size() == 1)
+        {
+          return std::format("instruction {} ends a stack layer that was never started", index);
+        }
+        for (uint32_t count = frame.Layers.back(); count > 0; count--)
+        {
+          frame.pop();
+        }
+        frame.Layers.pop_back();
+        break;
+
+      case OP_PUSH:
+        frame.push(pc->Operand);
+        break;
+
+      case OP_POP:
+        for (uint32_t i = 0; i < pc->Operand; i++)
+        {
+          if (frame.Layers.back() == 0)
+          {
+            return std::format("instruction {} pops a variable outside of the current stack layer", index);
+          }
+          frame.pop();
+        }
+        break;
+
+      case OP_SETU32:
+        if (!frame.has_variable(pc->Operand, sizeof(uint32_t)))
+        {
+          return std::format("instruction {} sets a @uint32 at offset {}, which is not a @uint32 variable", index, pc->Operand);
+        }
+        break;
+
+      case OP_SETSTR:
+        if (pc->String == nullptr)
+        {
+          return std::format("instruction {} uses an invalid string literal", index);
+        }
+        if (!frame.has_variable(pc->Operand, sizeof(const char*)))
+        {
+          return std::format("instruction {} sets a @void* at offset {}, which is not a @void* variable", index, pc->Operand);
+        }
+        break;
+
+      case OP_MOVU32:
+      case OP_ADDU32:
+      case OP_SUBU32:
+      case OP_MULU32:
+        {
+          uint32_t sources = pc->Opcode == OP_MOVU32 ? 1 : 2;
+          bool valid = frame.has_variable(pc->Operand, sizeof(uint32_t));
+          for (uint32_t i = 0; i < sources; i++) { valid &= frame.has_variable(pc->Slots[i], sizeof(uint32_t)); }
+          if (!valid)
+          {
+            return std::format("instruction {} uses an offset that is not a @uint32 variable", index);
+          }
+          break;
+        }
+
+      case OP_ATOMIC_LOAD:
+      case OP_ATOMIC_STORE:
+      case OP_ATOMIC_ADD:
+      case OP_ATOMIC_CAS:
+        {
+          uint32_t variables = pc->Opcode == OP_ATOMIC_LOAD || pc->Opcode == OP_ATOMIC_STORE ? 1 : 2;
+          bool valid = frame.has_variable(get_atomic_offset(pc->Operand), get_atomic_slot_size(pc->Operand));
+          for (uint32_t i = 0; i < variables; i++) { valid &= frame.has_variable(pc->Slots[i], sizeof(uint32_t)); }
+          if (!valid)
+          {
+            return std::format("instruction {} uses an atomic slot or an offset that is not a @uint32 variable", index);
+          }
+          break;
+        }
+
+      case OP_FENCE:
+        break;
+
+      case OP_CALL:
+      case OP_IMPL:
+      case OP_CALL_IMPORT:
+        {
+          const CryoFunction* callee = get_callee(*pc);
+          if (auto error = frame.check_call(*callee))
+          {
+            return std::format("instruction {}: {}", index, error.value());
+          }
+          call_offsets.emplace_back(frame.call_offset(*callee));
+          break;
+        }
+
+      case OP_RETURN:
+        break;
+
+      default:
+        return std::format("instruction {} has an unknown opcode", index);
+      }
+    }
+
+    if (last == nullptr || last->Opcode != OP_RETURN)
+    {
+      return std::string("function does not end in RETURN");
+    }
+
+    // Verified functions get their whole frame reserved on CALL, so it must fit everything the function pushes
+    if (inferred_frame_size)
+    {
+      *inferred_frame_size = frame.MaxSize;
+    }
+    else if (frame.MaxSize > func.FrameSize)
+    {
+      return std::format("function needs a frame of {} bytes, but declares {}", frame.MaxSize, func.FrameSize);
+    }
+
+    return std::nullopt;
+  }
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "CryoAssembly.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace Cryo {
+
+  /// <summary>
+  /// Proves, once when a CryoAssembly is loaded, the invariants CryoThread would otherwise check on every instruction.
+  /// Cryo code has no branches, so each function is verified with a single pass that simulates its stack
+  /// </summary>
+  class CryoVerifier
+  {
+  public:
+    /// <summary>
+    /// Checks stack layer balance, variable indices, call signatures, string literals, the frame size and that the function ends in RETURN.
+    /// Register format functions have no stack layout, their variable indices and calls are checked against the frame size
+    /// </summary>
+    /// <param name="func"> Decoded function, callees must be decoded as well </param>
+    /// <param name="call_offsets"> Filled with the offset in func's frame where the frame of each CALL and IMPL starts, in code order </param>
+    /// <param name="inferred_frame_size"> For stack format functions of images that don't record a frame size, receives the size the function
+    /// needs instead of checking it against func's </param>
+    /// <returns> Returns std::nullopt if the function is valid, a description of the first problem if it isn't </returns>
+    static std::optional<std::string> verify_function(const CryoFunction& func, std::vector<uint32_t>& call_offsets, uint32_t* inferred_frame_size = nullptr);
+  };
+
+}
@@ -1,27 +1,272 @@
 #include "cryopch.h"
+#include "CryoChannel.h"
+#include "CryoEventLoop.h"
+#include "CryoIO.h"
+#include "CryoScheduler.h"
 #include "CryoThread.h"
+#include "ImplRegistry.h"
 
-#include <functional>
+#include <cstring>
+#include <format>
+#include <iterator>
 #include <stdexcept>
+#include <vector>
 
 namespace Cryo {
-  
-  std::unordered_map<std::string, CryoThread::ImplFunction> CryoThread::s_ImplFunctions =
+
+  static void println_str(const char* str)
   {
-    { "$void::println_str::void*", 
-      { CryoFunction{nullptr, 0, "$void::println::void*", 0, { 8 }, nullptr }, std::function<void(CryoThread*)>(&CryoThread::void_println_str_void) } }
-  };
+    if (str == nullptr)
+    {
+      throw std::logic_error("Fatal Error: str(char*) was null!");
+    }
+
+    CryoIO::write_line(OutputStream::Out, str);
+  }
+
+  static void print_str(const char* str)
+  {
+    if (str == nullptr)
+    {
+      throw std::logic_error("Fatal Error: str(char*) was null!");
+    }
+
+    CryoIO::write(OutputStream::Out, str);
+  }
+
+  static void eprintln_str(const char* str)
+  {
+    if (str == nullptr)
+    {
+      throw std::logic_error("Fatal Error: str(char*) was null!");
+    }
+
+    CryoIO::write_line(OutputStream::Err, str);
+  }
+
+  static void flush()
+  {
+    CryoIO::flush();
+  }
+
+  // Starts signature, a $uint32::name::uint32 function, on a new thread
+  static uint32_t thread_spawn(CryoThread& thread, const char* signature, uint32_t argument)
+  {
+    if (signature == nullptr)
+    {
+      throw std::logic_error("Fatal Error: signature(char*) was null!");
+    }
+
+    return thread.spawn(signature, argument);
+  }
+
+  static uint32_t thread_join(CryoThread& thread, uint32_t handle)
+  {
+    return thread.join(handle);
+  }
+
+  // Starts signature, a $uint32::name::uint32 function, as a fiber
+  static uint32_t fiber_spawn(CryoThread& thread, const char* signature, uint32_t argument)
+  {
+    if (signature == nullptr)
+    {
+      throw std::logic_error("Fatal Error: signature(char*) was null!");
+    }
+
+    return CryoScheduler::get().spawn(thread, signature, argument);
+  }
+
+  static uint32_t fiber_await(CryoThread& thread, uint32_t handle)
+  {
+    return CryoScheduler::get().await(thread, handle);
+  }
+
+  // Releases the fiber once it ends instead of keeping it for a fiber_await, for fibers whose return nobody needs
+  static void fiber_detach(CryoThread& thread, uint32_t handle)
+  {
+    CryoScheduler::get().detach(thread, handle);
+  }
+
+  static void fiber_yield(CryoThread& thread)
+  {
+    CryoScheduler::get().yield(thread);
+  }
+
+  // Channels carry uint32 values, a fiber blocked on one is suspended instead of blocking its worker
+  static uint32_t channel_create(uint32_t capacity)
+  {
+    return CryoChannel::create(capacity, ChannelKind::MultiProducer);
+  }
+
+  // Only valid with a single sending and a single receiving thread or fiber, cheaper than channel_create's
+  static uint32_t channel_create_spsc(uint32_t capacity)
+  {
+    return CryoChannel::create(capacity, ChannelKind::SingleProducer);
+  }
+
+  static void channel_send(CryoThread& thread, uint32_t handle, uint32_t value)
+  {
+    CryoChannel::get(handle).send(thread, value);
+  }
+
+  // Returns UINT32_MAX once the channel is closed and empty
+  static uint32_t channel_receive(CryoThread& thread, uint32_t handle)
+  {
+    uint32_t value = 0;
+    CryoChannel::get(handle).receive(thread, value);
+    return value;
+  }
+
+  static void channel_close(uint32_t handle)
+  {
+    CryoChannel::get(handle).close();
+  }
+
+  // Frees the channel, its handle is invalid afterwards. Only call it once no thread or fiber will use the channel again
+  static void channel_destroy(uint32_t handle)
+  {
+    CryoChannel::destroy(handle);
+  }
+
+  // Process wide @uint32 for the heap form of the atomic instructions, every thread gets the same pointer for an index
+  static const char* shared_cell(uint32_t index)
+  {
+    // One cache line each, cells are meant for contended counters and flags
+    struct alignas(64) Cell
+    {
+      uint32_t Value = 0;
+    };
+    static constexpr uint32_t s_CellCount = 4096;
+    static Cell s_Cells[s_CellCount];
+
+    if (index >= s_CellCount)
+    {
+      throw std::logic_error(std::format("Fatal Error: shared_cell index [{}] is past the {} cells!", index, s_CellCount));
+    }
+    return (const char*)&s_Cells[index].Value;
+  }
+
+  // IO fds are uint32, failures return UINT32_MAX. Reads, writes, accepts and sleeps go through the event loop and suspend fibers
+  static uint32_t to_io_result(int64_t result)
+  {
+    return result < 0 ? UINT32_MAX : (uint32_t)result;
+  }
 
-  void CryoThread::void_println_str_void()
+  // mode: 0 reads, 1 writes truncating the file, 2 appends
+  static uint32_t io_open(const char* path, uint32_t mode)
   {
-    const char* str = m_Stack.get_variable<char*>(0);
+    if (path == nullptr)
+    {
+      throw std::logic_error("Fatal Error: path(char*) was null!");
+    }
+
+    return to_io_result(CryoEventLoop::open_file(path, mode));
+  }
+
+  static uint32_t io_close(uint32_t fd)
+  {
+    return to_io_result(CryoEventLoop::close_fd((int)fd));
+  }
+
+  static uint32_t io_listen(uint32_t port)
+  {
+    return to_io_result(CryoEventLoop::listen_loopback((uint16_t)port));
+  }
 
+  static uint32_t io_connect(uint32_t port)
+  {
+    return to_io_result(CryoEventLoop::connect_loopback((uint16_t)port));
+  }
+
+  // Reads up to size bytes, at most CryoEventLoop::s_MaxReadSize. The string is empty at the end of the file and null on failure, io_free releases it
+  static const char* io_read(CryoThread& thread, uint32_t fd, uint32_t size)
+  {
+    IoCall call = CryoEventLoop::get().perform(thread, IoOperation::Read, (int)fd, nullptr, size);
+    if (call.Suspended)
+    {
+      return nullptr;
+    }
+    if (call.Result < 0)
+    {
+      delete[] call.Buffer;
+      return nullptr;
+    }
+    return call.Buffer;
+  }
+
+  // Returns the bytes written, which may be less than the string's length
+  static uint32_t io_write(CryoThread& thread, uint32_t fd, const char* str)
+  {
     if (str == nullptr)
     {
       throw std::logic_error("Fatal Error: str(char*) was null!");
     }
 
-    std::cout << str << std::endl;
+    IoCall call = CryoEventLoop::get().perform(thread, IoOperation::Write, (int)fd, const_cast<char*>(str), (uint32_t)std::strlen(str));
+    return call.Suspended ? 0 : to_io_result(call.Result);
+  }
+
+  static uint32_t io_accept(CryoThread& thread, uint32_t fd)
+  {
+    IoCall call = CryoEventLoop::get().perform(thread, IoOperation::Accept, (int)fd, nullptr, 0);
+    return call.Suspended ? 0 : to_io_result(call.Result);
+  }
+
+  static void io_sleep(CryoThread& thread, uint32_t milliseconds)
+  {
+    CryoEventLoop::get().perform(thread, IoOperation::Sleep, -1, nullptr, 0, uint64_t(milliseconds) * 1000000);
+  }
+
+  static void io_free(const char* str)
+  {
+    delete[] str;
+  }
+
+  // Flat registry of every IMPL function, looked up once per IMPL instruction when an assembly is loaded. Constant initialized, so
+  // programs loaded from other static initializers already see all of it
+  static constexpr ImplDeclaration s_ImplDeclarations[] =
+  {
+    make_impl_function<"println_str", &println_str>(),
+    make_impl_function<"print_str", &print_str>(),
+    make_impl_function<"eprintln_str", &eprintln_str>(),
+    make_impl_function<"flush", &flush>(),
+    make_impl_function<"thread_spawn", &thread_spawn>(),
+    make_impl_function<"thread_join", &thread_join>(),
+    make_impl_function<"fiber_spawn", &fiber_spawn>(),
+    make_impl_function<"fiber_await", &fiber_await>(),
+    make_impl_function<"fiber_detach", &fiber_detach>(),
+    make_impl_function<"fiber_yield", &fiber_yield>(),
+    make_impl_function<"channel_create", &channel_create>(),
+    make_impl_function<"channel_create_spsc", &channel_create_spsc>(),
+    make_impl_function<"channel_send", &channel_send>(),
+    make_impl_function<"channel_receive", &channel_receive>(),
+    make_impl_function<"channel_close", &channel_close>(),
+    make_impl_function<"channel_destroy", &channel_destroy>(),
+    make_impl_function<"shared_cell", &shared_cell>(),
+    make_impl_function<"io_open", &io_open>(),
+    make_impl_function<"io_close", &io_close>(),
+    make_impl_function<"io_listen", &io_listen>(),
+    make_impl_function<"io_connect", &io_connect>(),
+    make_impl_function<"io_read", &io_read>(),
+    make_impl_function<"io_write", &io_write>(),
+    make_impl_function<"io_accept", &io_accept>(),
+    make_impl_function<"io_sleep", &io_sleep>(),
+    make_impl_function<"io_free", &io_free>(),
+  };
+
+  const ImplFunction* CryoThread::find_impl_function(std::string_view signature)
+  {
+    // The entries IMPL instructions point to, built by the first lookup
+    static const std::vector<ImplFunction> s_ImplFunctions(std::begin(s_ImplDeclarations), std::end(s_ImplDeclarations));
+
+    for (const ImplFunction& impl : s_ImplFunctions)
+    {
+      if (impl.FunctionData.FunctionSignature == signature)
+      {
+        return &impl;
+      }
+    }
+    return nullptr;
   }
 
 }
@@ -0,0 +1,230 @@
+#pragma once
+
+#include "CryoAssembly.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// IMPL functions are plain C++ functions with typed parameters, everything the interpreter needs to call them
+// (the Cryo signature, the frame layout and the argument and return marshalling) is generated from the C++ signature at compile time
+
+namespace Cryo {
+
+  class CryoThread;
+
+  /// <summary>
+  /// Registry entry of an IMPL function, a literal type so the registry is constant initialized
+  /// </summary>
+  struct ImplDeclaration
+  {
+    std::string_view Signature;
+    uint32_t ReturnTypeSize = 0;
+    std::span<const uint32_t> ParameterSizes;
+    uint32_t FrameSize = 0;
+    /// Reads the arguments from the IMPL's frame, calls the C++ function and writes its return back to the frame
+    void (*Function)(CryoThread& thread, uint8_t* frame) = nullptr;
+  };
+
+  /// <summary>
+  /// Function implemented by the interpreter, called through the IMPL instruction
+  /// </summary>
+  struct ImplFunction
+  {
+    explicit ImplFunction(const ImplDeclaration& declaration)
+      : Function(declaration.Function)
+    {
+      FunctionData.FunctionSignature = declaration.Signature;
+      FunctionData.ReturnTypeSize = declaration.ReturnTypeSize;
+      FunctionData.ParameterSizes.assign(declaration.ParameterSizes.begin(), declaration.ParameterSizes.end());
+      FunctionData.FrameSize = declaration.FrameSize;
+    }
+
+    /// The IMPL as a function, what the call stack and the verifier see of it
+    CryoFunction FunctionData;
+    void (*Function)(CryoThread& thread, uint8_t* frame) = nullptr;
+  };
+
+  /// <summary>
+  /// Cryo name and size of the C++ types IMPL functions can take and return
+  /// </summary>
+  template <typename T>
+  struct CryoType;
+
+  template <>
+  struct CryoType<void>
+  {
+    static constexpr std::string_view Name = "void";
+    static constexpr uint32_t Size = 0;
+  };
+
+  template <>
+  struct CryoType<uint32_t>
+  {
+    static constexpr std::string_view Name = "uint32";
+    static constexpr uint32_t Size = 4;
+  };
+
+  template <>
+  struct CryoType<const char*>
+  {
+    static constexpr std::string_view Name = "void*";
+    static constexpr uint32_t Size = 8;
+  };
+
+  /// <summary>
+  /// String literal usable as a template argument, the name of an IMPL function
+  /// </summary>
+  template <size_t N>
+  struct ImplName
+  {
+    constexpr ImplName(const char (&str)[N]) { std::copy_n(str, N, Value); }
+    constexpr std::string_view view() const { return std::string_view(Value, N - 1); }
+
+    char Value[N];
+  };
+
+  namespace ImplDetail {
+
+    template <typename F>
+    struct FunctionTraits;
+
+    // A leading CryoThread& is the calling thread, it's not part of the Cryo signature
+    template <typename R, typename... Args>
+    struct FunctionTraits<R (*)(Args...)>
+    {
+      using Return = R;
+      using Parameters = std::tuple<Args...>;
+      static constexpr bool TakesThread = false;
+    };
+
+    template <typename R, typename... Args>
+    struct FunctionTraits<R (*)(CryoThread&, Args...)>
+    {
+      using Return = R;
+      using Parameters = std::tuple<Args...>;
+      static constexpr bool TakesThread = true;
+    };
+
+    template <ImplName Name, typename R, typename Parameters>
+    struct Signature;
+
+    // $ret::name::p1::p2, functions without parameters take void like $void::main::void
+    template <ImplName Name, typename R, typename... Args>
+    struct Signature<Name, R, std::tuple<Args...>>
+    {
+      static constexpr auto build()
+      {
+        constexpr size_t length = 1 + CryoType<R>::Name.size() + 2 + Name.view().size()
+            + (sizeof...(Args) == 0 ? 2 + CryoType<void>::Name.size() : (size_t(0) + ... + (2 + CryoType<Args>::Name.size())));
+
+        std::array<char, length> signature = {};
+        size_t i = 0;
+        auto append = [&](std::string_view str) {
+          for (char c : str)
+          {
+            signature[i++] = c;
+          }
+        };
+
+        append("$");
+        append(CryoType<R>::Name);
+        append("::");
+        append(Name.view());
+        if constexpr (sizeof...(Args) == 0)
+        {
+          append("::");
+          append(CryoType<void>::Name);
+        }
+        ((append("::"), append(CryoType<Args>::Name)), ...);
+        return signature;
+      }
+
+      static constexpr auto Storage = build();
+      static constexpr std::string_view Value = std::string_view(Storage.data(), Storage.size());
+    };
+
+    /// <summary>
+    /// Frame of an IMPL, like every other function the return is at 0 and the parameters follow it in order
+    /// </summary>
+    template <typename R, typename... Args>
+    struct FrameLayout
+    {
+      static constexpr std::array<uint32_t, sizeof...(Args)> ParameterSizes = { CryoType<Args>::Size... };
+
+      static constexpr std::array<uint32_t, sizeof...(Args)> compute_offsets()
+      {
+        std::array<uint32_t, sizeof...(Args)> offsets = {};
+        uint32_t offset = CryoType<R>::Size;
+        for (size_t i = 0; i < sizeof...(Args); i++)
+        {
+          offsets[i] = offset;
+          offset += ParameterSizes[i];
+        }
+        return offsets;
+      }
+
+      static constexpr std::array<uint32_t, sizeof...(Args)> Offsets = compute_offsets();
+      static constexpr uint32_t Size = (CryoType<R>::Size + ... + CryoType<Args>::Size);
+    };
+
+    template <auto Func, typename R, typename... Args, size_t... I>
+    void invoke(CryoThread& thread, uint8_t* frame, std::index_sequence<I...>)
+    {
+      using Layout = FrameLayout<R, Args...>;
+
+      auto call = [&]() -> R {
+        if constexpr (FunctionTraits<decltype(Func)>::TakesThread)
+        {
+          return Func(thread, *(Args*)(frame + Layout::Offsets[I])...);
+        }
+        else
+        {
+          return Func(*(Args*)(frame + Layout::Offsets[I])...);
+        }
+      };
+
+      if constexpr (std::is_void_v<R>)
+      {
+        call();
+      }
+      else
+      {
+        *(R*)frame = call();
+      }
+    }
+
+    template <auto Func, typename R, typename... Args>
+    constexpr ImplDeclaration make(std::string_view signature, std::tuple<Args...>*)
+    {
+      using Layout = FrameLayout<R, Args...>;
+
+      return ImplDeclaration {
+        .Signature = signature,
+        .ReturnTypeSize = CryoType<R>::Size,
+        .ParameterSizes = Layout::ParameterSizes,
+        .FrameSize = Layout::Size,
+        .Function = [](CryoThread& thread, uint8_t* frame) { invoke<Func, R, Args...>(thread, frame, std::index_sequence_for<Args...>()); },
+      };
+    }
+
+  }
+
+  /// <summary>
+  /// Builds the registry entry of an IMPL function, the entry's signature is generated from name and Func's C++ signature
+  /// </summary>
+  template <ImplName Name, auto Func>
+  constexpr ImplDeclaration make_impl_function()
+  {
+    using Traits = ImplDetail::FunctionTraits<decltype(Func)>;
+    using Signature = ImplDetail::Signature<Name, typename Traits::Return, typename Traits::Parameters>;
+
+    return ImplDetail::make<Func, typename Traits::Return>(Signature::Value, (typename Traits::Parameters*)nullptr);
+  }
+
+}
@@ -5,23 +5,86 @@
 #include <cstdint>
 #include <exception>
 #include <stdexcept>
+#include <new>
+
+#ifdef _WIN32
+  #include <Windows.h>
+#else
+  #include <sys/mman.h>
+  #include <unistd.h>
+#endif
 
 #define MB 1000000
 
 namespace Cryo {
 
-  Stack::Stack(uint32_t stack_Size_mb)
-    : m_StackBuffer(stack_Size_mb * MB)
+  // Size of the inaccessible region after every stack, only costs address space. Nothing is expected to reach it, see Stack
+  static constexpr size_t s_GuardSize = 64 * 1024;
+  // Call stack entries reserved per MB of stack, functions with an empty frame only use call stack entries
+  static constexpr size_t s_CallStackEntriesPerMB = 16 * 1024;
+
+  static size_t get_page_size()
   {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return sysconf(_SC_PAGESIZE);
+#endif
+  }
+
+  Stack::Stack(StackSize stack_size)
+  {
+    size_t page_size = get_page_size();
+    m_StackSize = ((stack_size.Bytes + page_size - 1) / page_size) * page_size;
+    m_ReservedSize = m_StackSize + ((s_GuardSize + page_size - 1) / page_size) * page_size;
+
+#ifdef _WIN32
+    // Reserve everything as inaccessible and only commit the usable part, physical pages are assigned on first touch
+    m_StackBuffer = (uint8_t*)VirtualAlloc(nullptr, m_ReservedSize, MEM_RESERVE, PAGE_NOACCESS);
+    if (m_StackBuffer == nullptr || VirtualAlloc(m_StackBuffer, m_StackSize, MEM_COMMIT, PAGE_READWRITE) == nullptr)
+    {
+      throw std::bad_alloc();
+    }
+#else
+    void* memory = mmap(nullptr, m_ReservedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+      throw std::bad_alloc();
+    }
+    m_StackBuffer = (uint8_t*)memory;
+    mprotect(m_StackBuffer + m_StackSize, m_ReservedSize - m_StackSize, PROT_NONE);
+#endif
+
+    m_FrameBase = m_StackBuffer;
+
+    // Raw storage, entries are constructed when pushed. Allocations this big are mapped lazily, so untouched entries cost no memory
+    size_t max_call_depth = std::max<size_t>(1, m_StackSize * s_CallStackEntriesPerMB / MB);
+    m_CallStack = (CallStackEntry*)::operator new(max_call_depth * sizeof(CallStackEntry));
+    m_CallStackTop = m_CallStack;
+    m_CallStackEnd = m_CallStack + max_call_depth;
+  }
+
+  Stack::~Stack()
+  {
+#ifdef _WIN32
+    VirtualFree(m_StackBuffer, 0, MEM_RELEASE);
+#else
+    munmap(m_StackBuffer, m_ReservedSize);
+#endif
+
+    ::operator delete(m_CallStack);
   }
 
   bool Stack::push_variable(uint32_t size)
   {
-    m_StackCounter += size;
-    if (m_StackCounter >= m_StackBuffer.size())
+    // Only unverified code pushes, verified code checks its whole frame when it's entered instead
+    if (m_StackCounter + size > m_StackSize)
     {
       return false;
     }
+    m_StackCounter += size;
 
     m_StackEntries.emplace_back(size);
 
@@ -33,17 +96,21 @@ namespace Cryo {
     return true;
   }
 
+  template <bool Checked>
   bool Stack::pop_variable(uint32_t count)
   {
     for (uint32_t i = 0; i < count; i++)
     {
-      if (m_StackEntries.empty() || (!m_StackLayers.empty() && m_StackLayers.top() == 0)) // Ensure there's a valid variable to be poped
+      if constexpr (Checked)
       {
-        return false;
+        if (m_StackEntries.empty() || (!m_StackLayers.empty() && m_StackLayers.top() == 0)) // Ensure there's a valid variable to be poped
+        {
+          return false;
+        }
       }
       
       m_StackCounter -= m_StackEntries.back();
-      m_StackEntries.erase(std::prev(m_StackEntries.end()));
+      m_StackEntries.pop_back();
       if (!m_StackLayers.empty())
       {
         m_StackLayers.top() -= 1;
@@ -56,37 +123,47 @@ namespace Cryo {
   void Stack::start_stack_layer()
   {
     m_StackLayers.push(0);
-    if (!m_CallStack.empty())
+    if (m_CallStackTop != m_CallStack)
     {
-      m_CallStack.top().StackLayerCount += 1;
+      m_CallStackTop[-1].StackLayerCount += 1;
     }
   }
 
+  template <bool Checked>
   bool Stack::end_stack_layer()
   {
-    if (m_StackLayers.empty() || m_CallStack.top().StackLayerCount == 0)
+    if constexpr (Checked)
     {
-      return false;
+      // The function layer can only be closed by RETURN
+      if (m_StackLayers.empty() || (m_CallStackTop != m_CallStack && m_CallStackTop[-1].StackLayerCount == 0))
+      {
+        return false;
+      }
     }
 
-    pop_variable(m_StackLayers.top());
+    pop_variable<false>(m_StackLayers.top());
     m_StackLayers.pop();
     
-    if (!m_CallStack.empty())
+    if (m_CallStackTop != m_CallStack)
     {
-      m_CallStack.top().StackLayerCount -= 1;
+      m_CallStackTop[-1].StackLayerCount -= 1;
     }
 
     return true;
   }
 
-  void Stack::push_call_stack(const CryoFunction* func, const CryoFunction* calee, const uint32_t* pc)
+  bool Stack::push_call_stack(const CryoFunction* func, const CryoFunction* calee, const CryoInstruction* pc)
   {
+    if (m_CallStackTop == m_CallStackEnd)
+    {
+      return false;
+    }
+
     uint32_t func_stack_offset = 0;
     for (uint32_t i = 0; i < calee->ParameterSizes.size(); i++)
     {
       uint32_t param_size = calee->ParameterSizes[calee->ParameterSizes.size() - 1 - i]; // Reverse iterate
-      if (m_StackEntries[m_StackEntries.size() - 1 - i] != param_size)
+      if (i >= m_StackEntries.size() || m_StackEntries[m_StackEntries.size() - 1 - i] != param_size)
       {
         throw std::logic_error("Parameters used do not match function declaration!");
       }
@@ -94,40 +171,61 @@ namespace Cryo {
     }
     if (calee->ReturnTypeSize != 0)
     {
-      if (m_StackEntries[m_StackEntries.size() - 1 - calee->ParameterSizes.size()] != calee->ReturnTypeSize)
+      if (calee->ParameterSizes.size() >= m_StackEntries.size() || m_StackEntries[m_StackEntries.size() - 1 - calee->ParameterSizes.size()] != calee->ReturnTypeSize)
       {
         throw std::logic_error("Unhandled function return!");
       }
       func_stack_offset += calee->ReturnTypeSize;
     }
 
-    m_CallStack.push(CallStackEntry(func, pc, m_StackCounter - func_stack_offset));
-    start_stack_layer(); // Function Layer
+    new (m_CallStackTop++) CallStackEntry(func, pc, m_FrameBase);
+    m_FrameBase = m_StackBuffer + m_StackCounter - func_stack_offset;
+    m_StackLayers.push(0); // Function Layer, not counted in StackLayerCount
+    return true;
   }
 
   CallStackEntry Stack::pop_call_stack()
   {
-    if (m_CallStack.empty())
+    if (m_CallStackTop == m_CallStack)
     {
       return CallStackEntry();
     }
 
-    CallStackEntry entry = m_CallStack.top();
+    CallStackEntry entry = m_CallStackTop[-1];
     for (uint32_t i = 0; i < entry.StackLayerCount; i++)
     {
-      end_stack_layer(); // Clear all uncleared layers in the function
+      end_stack_layer<false>(); // Clear all uncleared layers in the function
     }
-    end_stack_layer(); // Function layer
 
-    m_CallStack.pop();
+    // Function layer
+    pop_variable<false>(m_StackLayers.top());
+    m_StackLayers.pop();
+
+    m_FrameBase = entry.CallerFrameBase;
+    m_CallStackTop--;
     return entry;
   }
 
+  template bool Stack::pop_variable<true>(uint32_t count);
+  template bool Stack::pop_variable<false>(uint32_t count);
+  template bool Stack::end_stack_layer<true>();
+  template bool Stack::end_stack_layer<false>();
+
+  void Stack::release_pages()
+  {
+#ifdef _WIN32
+    VirtualAlloc(m_StackBuffer, m_StackSize, MEM_RESET, PAGE_READWRITE);
+#else
+    madvise(m_StackBuffer, m_StackSize, MADV_DONTNEED);
+#endif
+  }
+
   void Stack::clear()
   {
     m_StackCounter = 0;
+    m_FrameBase = m_StackBuffer;
     m_StackEntries.clear();
     m_StackLayers = std::stack<uint32_t>();
-    m_CallStack = std::stack<CallStackEntry>();
+    m_CallStackTop = m_CallStack;
   }
 }
@@ -5,62 +5,150 @@
 #include <cstdint>
 #include <vector>
 #include <stack>
+#include <new>
 
 namespace Cryo {
 
   struct CallStackEntry
   {
     CallStackEntry() = default;
-    CallStackEntry(const CryoFunction* func, const uint32_t* pc, uint32_t stack_start)
-      : Function(func), ProgramCounter(pc), StackLayerCount(0), FunctsionStackStart(stack_start)
+    CallStackEntry(const CryoFunction* func, const CryoInstruction* pc, uint8_t* caller_frame_base)
+      : Function(func), ProgramCounter(pc), StackLayerCount(0), CallerFrameBase(caller_frame_base)
     {}
 
     const CryoFunction* Function = nullptr;
-    const uint32_t* ProgramCounter = nullptr;
+    const CryoInstruction* ProgramCounter = nullptr;
   
   private:
     uint32_t StackLayerCount = 0;
-    uint32_t FunctsionStackStart = 0;
+    uint8_t* CallerFrameBase = nullptr;
 
     friend class Stack;
   };
 
+  /// <summary>
+  /// Size of a stack in bytes, for stacks smaller than the whole MBs CryoThread usually takes like the ones of fibers
+  /// </summary>
+  struct StackSize
+  {
+    size_t Bytes = 0;
+  };
+
+  /// <summary>
+  /// Cryo variable stack, the memory is reserved up front and the OS only commits the pages that are touched.
+  /// Overflows are caught by bounds checks: once per PUSH in unverified code and once per frame in verified code, which never checks
+  /// a PUSH. The guard region after the usable memory is only a backstop, a bug that writes past the stack crashes on it instead of
+  /// corrupting whatever is mapped next
+  /// </summary>
   class Stack
   {
   public:
-    Stack(uint32_t stack_size_mb);
+    Stack(StackSize stack_size);
+    ~Stack();
+
+    Stack(const Stack&) = delete;
+    Stack& operator=(const Stack&) = delete;
+
+    size_t get_size() const { return m_StackSize; }
+
+    /// <summary>
+    /// Start of the running function's frame, variable indices are byte offsets from it.
+    /// Only changes on calls and returns, so CryoThread keeps a copy while it runs
+    /// </summary>
+    uint8_t* get_frame_base() const { return m_FrameBase; }
+
+    // The Checked = false variants skip the validation CryoVerifier already did for verified assemblies
 
+    /// <returns> Returns false if the variable doesn't fit in the stack </returns>
     bool push_variable(uint32_t size);
+    template <bool Checked = true>
     bool pop_variable(uint32_t count);
 
     void start_stack_layer();
+    template <bool Checked = true>
     bool end_stack_layer();
 
-    void push_call_stack(const CryoFunction* func, const CryoFunction* calee, const uint32_t* pc);
+    /// <returns> Returns false if the call stack is full </returns>
+    bool push_call_stack(const CryoFunction* func, const CryoFunction* calee, const CryoInstruction* pc);
     CallStackEntry pop_call_stack();
 
-    template <typename T>
-    T& get_variable(uint32_t stack_index)
+    // Static frames, used instead of the variable and layer bookkeeping above for verified assemblies
+
+    /// <summary>
+    /// Reserves the frame of the function execution starts on
+    /// </summary>
+    /// <returns> Returns false if the frame doesn't fit in the stack </returns>
+    bool enter_root_frame(const CryoFunction* func)
+    {
+      m_FrameBase = m_StackBuffer;
+      m_StackCounter = func->FrameSize;
+      return m_StackCounter <= m_StackSize;
+    }
+
+    /// <summary>
+    /// Reserves the callee's whole frame with a single bump, the frame starts frame_offset bytes into the caller's
+    /// where its return and parameters already are
+    /// </summary>
+    /// <returns> Returns false if the frame doesn't fit in the stack or the call stack is full </returns>
+    bool enter_frame(const CryoFunction* func, const CryoFunction* calee, const CryoInstruction* pc, uint32_t frame_offset)
     {
-      if (!m_CallStack.empty())
+      if (m_CallStackTop == m_CallStackEnd)
       {
-        stack_index += m_CallStack.top().FunctsionStackStart;
+        return false;
       }
 
-      T* ptr = (T*)&m_StackBuffer[stack_index];
+      new (m_CallStackTop++) CallStackEntry(func, pc, m_FrameBase);
+      m_FrameBase += frame_offset;
+      m_StackCounter = size_t(m_FrameBase - m_StackBuffer) + calee->FrameSize;
+      return m_StackCounter <= m_StackSize;
+    }
+
+    /// <summary>
+    /// Used before running native code on a frame, which has no call stack entry and no bump of its own
+    /// </summary>
+    bool fits_frame(const uint8_t* frame_base, uint32_t frame_size) const { return frame_base + frame_size <= m_StackBuffer + m_StackSize; }
+
+    CallStackEntry leave_frame()
+    {
+      if (m_CallStackTop == m_CallStack)
+      {
+        return CallStackEntry();
+      }
+
+      CallStackEntry entry = *--m_CallStackTop;
+      m_FrameBase = entry.CallerFrameBase;
+      m_StackCounter = size_t(m_FrameBase - m_StackBuffer) + entry.Function->FrameSize;
+      return entry;
+    }
+
+    template <typename T>
+    T& get_variable(uint32_t stack_index)
+    {
+      T* ptr = (T*)(m_FrameBase + stack_index);
       return *ptr;
     }
 
     void clear();
+    /// <summary>
+    /// Lets the OS take back every page of the stack, they read as zeros once touched again
+    /// </summary>
+    void release_pages();
     
   private:
     // Variables
-    std::vector<uint8_t> m_StackBuffer;
-    uint32_t m_StackCounter = 0;
+    uint8_t* m_StackBuffer = nullptr;
+    size_t m_StackSize = 0;
+    size_t m_ReservedSize = 0;
+    size_t m_StackCounter = 0;
+    uint8_t* m_FrameBase = nullptr;
     std::vector<uint32_t> m_StackEntries;
     std::stack<uint32_t> m_StackLayers;
   
-    std::stack<CallStackEntry> m_CallStack; 
+    // Contiguous array of call frames allocated up front, m_CallStackTop is one past the running function's entry
+    // and reaching m_CallStackEnd is a stack overflow
+    CallStackEntry* m_CallStack = nullptr;
+    CallStackEntry* m_CallStackTop = nullptr;
+    CallStackEntry* m_CallStackEnd = nullptr;
   };
 
 }
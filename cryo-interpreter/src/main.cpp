@@ -8,5 +8,5 @@ int main(int argc, const char* argv[])
 	{
 		return -1;
 	}
-	state.run_entry_point();
+	return state.run();
 }
@@ -0,0 +1,127 @@
+#include "cryopch.h"
+
+#include "core/CryoAssembly.h"
+#include "core/CryoInstructions.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Offline superinstruction mining: counts the opcode sequences found in a corpus of .crye files,
+// the most frequent ones are candidates for the superinstruction table in CryoAssembly.cpp
+//
+// usage: cryo-ngrams [--unfused] [--top N] {file.crye | folder}...
+
+namespace Cryo {
+
+  using Ngram = std::vector<CryoDecodedOpcode>;
+
+  static void count_ngrams(const CryoFunction* func, std::map<Ngram, uint64_t>& ngrams)
+  {
+    std::vector<CryoDecodedOpcode> opcodes;
+    for (const CryoInstruction* pc = func->Code; pc->Opcode != OP_END; pc += get_instruction_slots(pc->Opcode))
+    {
+      opcodes.emplace_back(pc->Opcode);
+    }
+
+    for (size_t length = 2; length <= 3; length++)
+    {
+      for (size_t i = 0; i + length <= opcodes.size(); i++)
+      {
+        ngrams[Ngram(opcodes.begin() + i, opcodes.begin() + i + length)]++;
+      }
+    }
+  }
+
+  static bool mine_assembly(const std::filesystem::path& path, const CryoLoadOptions& options, std::map<Ngram, uint64_t>& ngrams)
+  {
+    CryoAssembly assembly(path, options);
+    if (!assembly.is_valid())
+    {
+      std::cout << "Failed to load " << path.string() << std::endl;
+      return false;
+    }
+
+    for (uint32_t i = 0; const CryoFunction* func = assembly.get_function_by_index(i); i++)
+    {
+      if (func->Code != nullptr)
+      {
+        count_ngrams(func, ngrams);
+      }
+    }
+    return true;
+  }
+
+}
+
+int main(int argc, const char** argv)
+{
+  using namespace Cryo;
+
+  CryoLoadOptions options;
+  size_t top = 20;
+  std::vector<std::filesystem::path> inputs;
+  for (int i = 1; i < argc; i++)
+  {
+    if (std::strcmp(argv[i], "--unfused") == 0)
+    {
+      options.Superinstructions = false;
+    }
+    else if (std::strcmp(argv[i], "--top") == 0 && i + 1 < argc)
+    {
+      top = std::stoul(argv[++i]);
+    }
+    else
+    {
+      inputs.emplace_back(argv[i]);
+    }
+  }
+
+  if (inputs.empty())
+  {
+    std::cout << "usage: cryo-ngrams [--unfused] [--top N] {file.crye | folder}..." << std::endl;
+    return -1;
+  }
+
+  std::map<Ngram, uint64_t> ngrams;
+  uint32_t assemblies = 0;
+  for (const auto& input : inputs)
+  {
+    if (std::filesystem::is_directory(input))
+    {
+      for (const auto& entry : std::filesystem::recursive_directory_iterator(input))
+      {
+        if (!entry.is_directory() && entry.path().extension() == ".crye")
+        {
+          assemblies += mine_assembly(entry.path(), options, ngrams);
+        }
+      }
+    }
+    else
+    {
+      assemblies += mine_assembly(input, options, ngrams);
+    }
+  }
+
+  std::vector<std::pair<Ngram, uint64_t>> sorted(ngrams.begin(), ngrams.end());
+  std::stable_sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+
+  std::printf("%u assemblies, %zu distinct sequences\n", assemblies, sorted.size());
+  for (size_t i = 0; i < sorted.size() && i < top; i++)
+  {
+    std::string sequence;
+    for (CryoDecodedOpcode opcode : sorted[i].first)
+    {
+      sequence += sequence.empty() ? "" : "; ";
+      sequence += get_opcode_name(opcode);
+    }
+    std::printf("%10llu  %s\n", (unsigned long long)sorted[i].second, sequence.c_str());
+  }
+
+  return 0;
+}